@@ -0,0 +1,66 @@
+// -------------------------------------------------------------------------------
+#include <cstring>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <arrow/api.h>
+// -------------------------------------------------------------------------------
+#include "../include/parquet/ColumnChunkWriter.hpp"
+// -------------------------------------------------------------------------------
+namespace {
+// -------------------------------------------------------------------------------
+// Column of n strings of the given lengths, e.g. ids or country codes for short lengths
+std::shared_ptr<arrow::Array> makeStrings(const int64_t n, const int32_t minLength, const int32_t maxLength) {
+    arrow::StringBuilder builder;
+    for (int64_t i = 0; i != n; i++) {
+        const int32_t length = minLength + static_cast<int32_t>(i * 7919 % (maxLength - minLength + 1));
+        if (!builder.Append(std::string(length, 'a' + i % 26)).ok()) std::abort();
+    }
+    std::shared_ptr<arrow::Array> result;
+    if (!builder.Finish(&result).ok()) std::abort();
+    return result;
+}
+
+// The serialization before the vectorized kernel, two memcpy calls per value
+void writeStringValuesLoop(const std::shared_ptr<arrow::Array>& array, char* vec) {
+    const uint8_t* src = array->data()->buffers[2]->data();
+    const auto* offsets = array->data()->GetValues<int32_t>(1);
+    for (int64_t i = 0; i != array->length(); i++) {
+        const int32_t length = offsets[i+1] - offsets[i];
+        memcpy(vec, &length, sizeof(int32_t));
+        vec += 4;
+        memcpy(vec, src + offsets[i], length);
+        vec += length;
+    }
+}
+
+void BM_StringLoop(benchmark::State& state) {
+    const auto array = makeStrings(1 << 20, state.range(0), state.range(1));
+    const uint64_t size = virtualfile::ColumnChunkWriter::getValuesSize(array);
+    std::string out(size, '\0');
+    for (auto _ : state) {
+        writeStringValuesLoop(array, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+void BM_StringKernel(benchmark::State& state) {
+    const auto array = makeStrings(1 << 20, state.range(0), state.range(1));
+    const uint64_t size = virtualfile::ColumnChunkWriter::getValuesSize(array);
+    std::string out(size, '\0');
+    for (auto _ : state) {
+        virtualfile::ColumnChunkWriter::writeColumnChunk({}, array, out.data(), 0, size - 1);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+// -------------------------------------------------------------------------------
+} // namespace
+// -------------------------------------------------------------------------------
+BENCHMARK(BM_StringLoop)->Args({2, 2})->Args({4, 12})->Args({8, 32})->Args({64, 256});
+BENCHMARK(BM_StringKernel)->Args({2, 2})->Args({4, 12})->Args({8, 32})->Args({64, 256});
+// -------------------------------------------------------------------------------
+BENCHMARK_MAIN();
+// -------------------------------------------------------------------------------
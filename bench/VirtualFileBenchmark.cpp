@@ -0,0 +1,458 @@
+// -------------------------------------------------------------------------------
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <arrow/api.h>
+#include <arrow/io/interfaces.h>
+#include <arrow/io/memory.h>
+#include <arrow/util/thread_pool.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/file_reader.h>
+#include <parquet/metadata.h>
+// -------------------------------------------------------------------------------
+#include "../include/ChunkInfoUtils.hpp"
+#include "../include/io/VirtualRandomAccessFile.hpp"
+#include "../include/ipc/VirtualArrowIPCFile.hpp"
+#include "../include/parquet/VirtualParquetFile.hpp"
+#include "../include/parquet/VirtualParquetFileView.hpp"
+// -------------------------------------------------------------------------------
+namespace {
+// -------------------------------------------------------------------------------
+#define CHECK_OK(expr) if (!(expr).ok()) std::abort()
+// -------------------------------------------------------------------------------
+enum ColumnType : int64_t { INT32, DOUBLE, STRING, DICTIONARY };
+const char* columnTypeNames[] = {"int32", "double", "string", "dictionary"};
+constexpr int64_t ROWS_PER_ROWGROUP = 1 << 16;
+constexpr int64_t DICTIONARY_SIZE = 1000;
+// -------------------------------------------------------------------------------
+std::shared_ptr<arrow::DataType> getType(const ColumnType type) {
+    switch (type) {
+        case INT32: return arrow::int32();
+        case DOUBLE: return arrow::float64();
+        case STRING: return arrow::utf8();
+        case DICTIONARY: return arrow::dictionary(arrow::int16(), arrow::utf8());
+    }
+    std::abort();
+}
+
+std::shared_ptr<arrow::Array> makeDictionary() {
+    arrow::StringBuilder builder;
+    for (int64_t i = 0; i != DICTIONARY_SIZE; i++) {
+        CHECK_OK(builder.Append("value" + std::to_string(i)));
+    }
+    std::shared_ptr<arrow::Array> result;
+    CHECK_OK(builder.Finish(&result));
+    return result;
+}
+
+// Chunk of rows values of the type, every rowgroup of a benchmark file serves the same chunk
+std::shared_ptr<arrow::Array> makeChunk(const ColumnType type, const int64_t rows) {
+    std::shared_ptr<arrow::Array> result;
+    switch (type) {
+        case INT32: {
+            arrow::Int32Builder builder;
+            for (int64_t i = 0; i != rows; i++) CHECK_OK(builder.Append(static_cast<int32_t>(i * 7919)));
+            CHECK_OK(builder.Finish(&result));
+            break;
+        }
+        case DOUBLE: {
+            arrow::DoubleBuilder builder;
+            for (int64_t i = 0; i != rows; i++) CHECK_OK(builder.Append(i / 3.0));
+            CHECK_OK(builder.Finish(&result));
+            break;
+        }
+        case STRING: {
+            arrow::StringBuilder builder;
+            for (int64_t i = 0; i != rows; i++) CHECK_OK(builder.Append(std::string(4 + i * 7919 % 29, 'a' + i % 26)));
+            CHECK_OK(builder.Finish(&result));
+            break;
+        }
+        case DICTIONARY: {
+            arrow::Int16Builder builder;
+            for (int64_t i = 0; i != rows; i++) CHECK_OK(builder.Append(static_cast<int16_t>(i * 7919 % DICTIONARY_SIZE)));
+            std::shared_ptr<arrow::Array> indices;
+            CHECK_OK(builder.Finish(&indices));
+            auto dictionaryArray = arrow::DictionaryArray::FromArrays(getType(type), indices, makeDictionary());
+            CHECK_OK(dictionaryArray);
+            result = *dictionaryArray;
+            break;
+        }
+    }
+    return result;
+}
+
+// Serves the same chunk for all rowgroups of a column, s.t. files of any size need little memory
+class RepeatingArrowReader final : public virtualfile::ArrowReader {
+    std::vector<std::shared_ptr<arrow::Array>> chunks;
+public:
+    RepeatingArrowReader(const std::shared_ptr<arrow::Schema>& schema, std::vector<std::shared_ptr<arrow::Array>> chunks) :
+        ArrowReader(schema), chunks(std::move(chunks)) {}
+
+    std::shared_ptr<arrow::Array> readChunk(uint64_t, const uint64_t column) override {
+        return chunks[column];
+    }
+};
+
+struct BenchmarkFile {
+    std::shared_ptr<arrow::Schema> schema;
+    std::shared_ptr<virtualfile::ArrowReader> reader;
+    std::vector<std::vector<virtualfile::ChunkInfo>> chunkInfos;
+    std::unique_ptr<virtualfile::VirtualParquetFile> file;
+    int64_t size = 0;
+    // byte ranges of all column chunks in file order
+    std::vector<virtualfile::ByteRange> chunks;
+};
+
+// File of the given columns, which is kept for all benchmarks using the same layout
+BenchmarkFile& getFile(const std::vector<ColumnType>& columns, const int64_t numRowgroups,
+                       const int64_t rowsPerRowgroup = ROWS_PER_ROWGROUP) {
+    static std::map<std::tuple<std::vector<ColumnType>, int64_t, int64_t>, BenchmarkFile> files;
+    BenchmarkFile& result = files[{columns, numRowgroups, rowsPerRowgroup}];
+    if (result.file) return result;
+
+    arrow::FieldVector fields;
+    std::vector<std::shared_ptr<arrow::Array>> chunks;
+    for (size_t j = 0; j != columns.size(); j++) {
+        fields.push_back(arrow::field(std::string(columnTypeNames[columns[j]]) + std::to_string(j), getType(columns[j])));
+        chunks.push_back(makeChunk(columns[j], rowsPerRowgroup));
+        result.chunkInfos.emplace_back(numRowgroups, virtualfile::ChunkInfoUtils::computeChunkInfo(chunks.back()));
+    }
+    result.schema = arrow::schema(fields);
+    result.reader = std::make_shared<RepeatingArrowReader>(result.schema, std::move(chunks));
+    auto chunkInfos = result.chunkInfos;
+    result.file = std::make_unique<virtualfile::VirtualParquetFile>(result.reader, result.schema, std::move(chunkInfos));
+    result.size = result.file->predictSizeOfFile();
+
+    // the chunk ranges as a reader finds them in the footer
+    const std::string tail = result.file->getRange({result.size - 8, result.size - 1});
+    const int64_t metadataLength = *reinterpret_cast<const int32_t*>(tail.data());
+    const std::string metadata = result.file->getRange({result.size - 8 - metadataLength, result.size - 9});
+    const auto fileMetadata = parquet::FileMetaData::Make(metadata.data(), metadataLength);
+    for (int i = 0; i != fileMetadata->num_row_groups(); i++) {
+        for (int j = 0; j != fileMetadata->num_columns(); j++) {
+            const auto chunk = fileMetadata->RowGroup(i)->ColumnChunk(j);
+            const int64_t begin = chunk->has_dictionary_page() ? chunk->dictionary_page_offset() : chunk->data_page_offset();
+            result.chunks.push_back({begin, begin + chunk->total_compressed_size() - 1});
+        }
+    }
+    return result;
+}
+
+std::vector<ColumnType> mixedColumns() {
+    return {INT32, DOUBLE, STRING, DICTIONARY};
+}
+// -------------------------------------------------------------------------------
+// Construction of a file with args {columns, rowgroups}, i.e. the prediction of all sizes and the footer
+// Wide or long file of the given number of columns and rowgroups, whose chunks are predicted on the given threads
+std::pair<BenchmarkFile&, std::vector<std::vector<virtualfile::ChunkInfo>>> getWideFile(const benchmark::State& state,
+                                                                                         virtualfile::VirtualParquetFileOptions& options) {
+    const int64_t numColumns = state.range(0);
+    const int64_t numRowgroups = state.range(1);
+    std::vector<ColumnType> columns;
+    for (int64_t j = 0; j != numColumns; j++) columns.push_back(static_cast<ColumnType>(j % 4));
+    BenchmarkFile& file = getFile(columns, 1, 1024);
+    std::vector<std::vector<virtualfile::ChunkInfo>> chunkInfos;
+    for (const auto& column : file.chunkInfos) chunkInfos.emplace_back(numRowgroups, column[0]);
+    if (state.range(2) > 0) {
+        options.executor = arrow::internal::ThreadPool::Make(static_cast<int>(state.range(2))).ValueOrDie();
+    }
+    return {file, std::move(chunkInfos)};
+}
+
+void BM_Construction(benchmark::State& state) {
+    virtualfile::VirtualParquetFileOptions options;
+    auto [file, chunkInfos] = getWideFile(state, options);
+    for (auto _ : state) {
+        auto infos = chunkInfos;
+        virtualfile::VirtualParquetFile parquetFile(file.reader, file.schema, std::move(infos), options);
+        benchmark::DoNotOptimize(parquetFile.predictSizeOfFile());
+    }
+    state.counters["chunks"] = state.range(0) * state.range(1);
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+}
+
+// Opens the file of BM_Construction from its layout snapshot
+void BM_ConstructionFromSnapshot(benchmark::State& state) {
+    virtualfile::VirtualParquetFileOptions options;
+    auto [file, chunkInfos] = getWideFile(state, options);
+    const virtualfile::VirtualParquetFile parquetFile(file.reader, file.schema, std::move(chunkInfos), options);
+    const std::shared_ptr<arrow::Buffer> snapshot = parquetFile.getLayoutSnapshot();
+    for (auto _ : state) {
+        virtualfile::VirtualParquetFile snapshotFile(file.reader, file.schema,
+            virtualfile::LayoutSnapshotReader(snapshot), options);
+        benchmark::DoNotOptimize(snapshotFile.predictSizeOfFile());
+    }
+    state.counters["chunks"] = state.range(0) * state.range(1);
+    state.counters["snapshot_bytes"] = static_cast<double>(snapshot->size());
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+}
+
+// View of 10 columns of the file of BM_Construction, as created per request of a client
+void BM_ViewConstruction(benchmark::State& state) {
+    virtualfile::VirtualParquetFileOptions options;
+    auto [file, chunkInfos] = getWideFile(state, options);
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(file.reader, file.schema,
+        std::move(chunkInfos), options);
+    std::vector<uint64_t> columns;
+    for (uint64_t j = 0; j != 10; j++) columns.push_back(j * state.range(0) / 10);
+    for (auto _ : state) {
+        virtualfile::VirtualParquetFileView view(parquetFile, columns);
+        benchmark::DoNotOptimize(view.predictSizeOfFile());
+    }
+    state.counters["chunks"] = 10 * state.range(1);
+}
+
+// Reads of a reader opening the file, the length of the footer followed by the footer
+void BM_FooterProbe(benchmark::State& state) {
+    BenchmarkFile& file = getFile(std::vector<ColumnType>(state.range(0), INT32), state.range(1), 1024);
+    for (auto _ : state) {
+        const std::string tail = file.file->getRange({file.size - 8, file.size - 1});
+        const int64_t metadataLength = *reinterpret_cast<const int32_t*>(tail.data());
+        benchmark::DoNotOptimize(file.file->getRange({file.size - 8 - metadataLength, file.size - 9}));
+    }
+}
+
+// Whole file in sequential ranges of the given size
+void BM_SequentialScan(benchmark::State& state) {
+    const auto type = static_cast<ColumnType>(state.range(0));
+    const int64_t rangeSize = state.range(1);
+    BenchmarkFile& file = getFile({type}, 64);
+    std::vector<char> out(rangeSize);
+    for (auto _ : state) {
+        for (int64_t begin = 0; begin < file.size; begin += rangeSize) {
+            file.file->getRange({begin, std::min(begin + rangeSize, file.size) - 1}, out);
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetLabel(columnTypeNames[type]);
+    state.SetBytesProcessed(state.iterations() * file.size);
+}
+
+// Whole Arrow IPC file of the columns of BM_SequentialScan in sequential ranges, whose buffers are served as is
+void BM_IPCSequentialScan(benchmark::State& state) {
+    const auto type = static_cast<ColumnType>(state.range(0));
+    const int64_t rangeSize = state.range(1);
+    BenchmarkFile& file = getFile({type}, 64);
+    auto chunkInfos = file.chunkInfos;
+    virtualfile::VirtualArrowIPCFile ipcFile(file.reader, file.schema, std::move(chunkInfos));
+    const int64_t size = ipcFile.predictSizeOfFile();
+    std::vector<char> out(rangeSize);
+    for (auto _ : state) {
+        for (int64_t begin = 0; begin < size; begin += rangeSize) {
+            ipcFile.getRange({begin, std::min(begin + rangeSize, size) - 1}, out);
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetLabel(columnTypeNames[type]);
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+// parquet::arrow::FileReader reading the file of BM_SequentialScan with pre-buffering, with arg 0 from a copy of the
+// whole file, with arg 1 in-process through the VirtualRandomAccessFile
+void BM_ReadTable(benchmark::State& state) {
+    const auto type = static_cast<ColumnType>(state.range(0));
+    BenchmarkFile& file = getFile({type}, 64);
+    auto chunkInfos = file.chunkInfos;
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(file.reader, file.schema, std::move(chunkInfos));
+    auto properties = parquet::ArrowReaderProperties();
+    properties.set_pre_buffer(true);
+    for (auto _ : state) {
+        std::shared_ptr<arrow::io::RandomAccessFile> input;
+        if (state.range(1) == 0) {
+            input = std::make_shared<arrow::io::BufferReader>(arrow::Buffer::FromString(parquetFile->getRange({0, file.size - 1})));
+        } else {
+            input = std::make_shared<virtualfile::VirtualRandomAccessFile>(parquetFile);
+        }
+        parquet::arrow::FileReaderBuilder builder;
+        PARQUET_THROW_NOT_OK(builder.Open(input));
+        std::unique_ptr<parquet::arrow::FileReader> reader;
+        PARQUET_THROW_NOT_OK(builder.properties(properties)->Build(&reader));
+        benchmark::DoNotOptimize(reader->ReadTable().ValueOrDie());
+    }
+    state.SetLabel(std::string(columnTypeNames[type]) + (state.range(1) == 0 ? " copy" : " adapter"));
+    state.SetBytesProcessed(state.iterations() * file.size);
+}
+
+// Construction of a file of one column with args {type, encoding policy, compressed}, which selects the encodings of
+// its chunks with the smallest policy. The counter bytes is the size of the file
+void BM_EncodingSelection(benchmark::State& state) {
+    const auto type = static_cast<ColumnType>(state.range(0));
+    BenchmarkFile& file = getFile({type}, 8);
+    const virtualfile::VirtualParquetFileOptions options{
+        .compression = state.range(2) ? arrow::Compression::ZSTD : arrow::Compression::UNCOMPRESSED,
+        .encodingPolicy = static_cast<virtualfile::EncodingPolicy>(state.range(1))};
+    uint64_t size = 0;
+    for (auto _ : state) {
+        auto chunkInfos = file.chunkInfos;
+        virtualfile::VirtualParquetFile parquetFile(file.reader, file.schema, std::move(chunkInfos), options);
+        size = parquetFile.predictSizeOfFile();
+    }
+    state.SetLabel(std::string(columnTypeNames[type]) + (state.range(1) ? " smallest" : " plain")
+        + (state.range(2) ? " zstd" : ""));
+    state.counters["bytes"] = static_cast<double>(size);
+    state.SetItemsProcessed(state.iterations() * 8 * ROWS_PER_ROWGROUP);
+}
+
+// Whole column chunks in random order
+void BM_RandomChunkReads(benchmark::State& state) {
+    const auto type = static_cast<ColumnType>(state.range(0));
+    BenchmarkFile& file = getFile({type}, 64);
+    std::mt19937_64 random(42);
+    std::vector<char> out(std::ranges::max(file.chunks, {}, &virtualfile::ByteRange::size).size());
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        const virtualfile::ByteRange range = file.chunks[random() % file.chunks.size()];
+        file.file->getRange(range, out);
+        bytes += range.size();
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetLabel(columnTypeNames[type]);
+    state.SetBytesProcessed(bytes);
+}
+
+// Ranges of 4 to 64 KiB at random offsets, which start and end within chunks
+void BM_RandomUnalignedReads(benchmark::State& state) {
+    const auto type = static_cast<ColumnType>(state.range(0));
+    BenchmarkFile& file = getFile({type}, 64);
+    std::mt19937_64 random(42);
+    std::vector<char> out(64 << 10);
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        const int64_t length = (4 << 10) + random() % (60 << 10);
+        const int64_t begin = random() % (file.size - length);
+        file.file->getRange({begin, begin + length - 1}, out);
+        bytes += length;
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetLabel(columnTypeNames[type]);
+    state.SetBytesProcessed(bytes);
+}
+// -------------------------------------------------------------------------------
+// Records the reads of the parquet reader of arrow, which is the reader of pyarrow
+class TracingFile final : public arrow::io::RandomAccessFile {
+    std::shared_ptr<arrow::Buffer> buffer;
+    int64_t position = 0;
+    bool isClosed = false;
+public:
+    std::vector<virtualfile::ByteRange> trace;
+
+    explicit TracingFile(std::shared_ptr<arrow::Buffer> buffer) : buffer(std::move(buffer)) {}
+
+    arrow::Status Close() override { isClosed = true; return arrow::Status::OK(); }
+    bool closed() const override { return isClosed; }
+    arrow::Result<int64_t> Tell() const override { return position; }
+    arrow::Status Seek(const int64_t target) override { position = target; return arrow::Status::OK(); }
+    arrow::Result<int64_t> GetSize() override { return buffer->size(); }
+
+    arrow::Result<int64_t> Read(const int64_t nbytes, void* out) override {
+        ARROW_ASSIGN_OR_RAISE(const int64_t read, ReadAt(position, nbytes, out));
+        position += read;
+        return read;
+    }
+    arrow::Result<std::shared_ptr<arrow::Buffer>> Read(const int64_t nbytes) override {
+        ARROW_ASSIGN_OR_RAISE(auto read, ReadAt(position, nbytes));
+        position += read->size();
+        return read;
+    }
+    arrow::Result<int64_t> ReadAt(const int64_t offset, const int64_t nbytes, void* out) override {
+        const int64_t length = std::min(nbytes, buffer->size() - offset);
+        trace.push_back({offset, offset + length - 1});
+        memcpy(out, buffer->data() + offset, length);
+        return length;
+    }
+    arrow::Result<std::shared_ptr<arrow::Buffer>> ReadAt(const int64_t offset, const int64_t nbytes) override {
+        const int64_t length = std::min(nbytes, buffer->size() - offset);
+        trace.push_back({offset, offset + length - 1});
+        return arrow::SliceBuffer(buffer, offset, length);
+    }
+};
+
+// Reads of pyarrow.parquet.read_table, which prebuffers the coalesced chunks of every rowgroup
+std::vector<virtualfile::ByteRange> recordArrowTrace(BenchmarkFile& file) {
+    const auto tracingFile = std::make_shared<TracingFile>(
+        arrow::Buffer::FromString(file.file->getRange({0, file.size - 1})));
+    parquet::ArrowReaderProperties properties;
+    properties.set_pre_buffer(true);
+    parquet::arrow::FileReaderBuilder builder;
+    CHECK_OK(builder.Open(tracingFile));
+    builder.properties(properties);
+    auto reader = builder.Build();
+    CHECK_OK(reader);
+    CHECK_OK((*reader)->ReadTable());
+    return tracingFile->trace;
+}
+
+// Reads of DuckDB, which reads the footer length and the footer before it reads every chunk of a rowgroup
+std::vector<virtualfile::ByteRange> makeDuckDBTrace(const BenchmarkFile& file) {
+    const std::string tail = file.file->getRange({file.size - 8, file.size - 1});
+    const int64_t metadataLength = *reinterpret_cast<const int32_t*>(tail.data());
+    std::vector<virtualfile::ByteRange> result{{file.size - 8, file.size - 1}, {file.size - 8 - metadataLength, file.size - 9}};
+    result.insert(result.end(), file.chunks.begin(), file.chunks.end());
+    return result;
+}
+
+// Replays the reads of a reader scanning the whole file
+void BM_ReplayTrace(benchmark::State& state) {
+    BenchmarkFile& file = getFile(mixedColumns(), 16);
+    static const std::vector<virtualfile::ByteRange> traces[] = {recordArrowTrace(file), makeDuckDBTrace(file)};
+    const std::vector<virtualfile::ByteRange>& trace = traces[state.range(0)];
+    std::vector<char> out(std::ranges::max(trace, {}, &virtualfile::ByteRange::size).size());
+    uint64_t bytes = 0;
+    for (const auto& range : trace) bytes += range.size();
+    for (auto _ : state) {
+        for (const auto& range : trace) {
+            file.file->getRange(range, out);
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetLabel(state.range(0) == 0 ? "pyarrow" : "duckdb");
+    state.counters["reads"] = trace.size();
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+// Replays the reads of BM_ReplayTrace as one batch, whose coalesced ranges are served at once
+void BM_ReplayTraceBatched(benchmark::State& state) {
+    BenchmarkFile& file = getFile(mixedColumns(), 16);
+    static const std::vector<virtualfile::ByteRange> traces[] = {recordArrowTrace(file), makeDuckDBTrace(file)};
+    const std::vector<virtualfile::ByteRange>& trace = traces[state.range(0)];
+    uint64_t bytes = 0;
+    for (const auto& range : trace) bytes += range.size();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(file.file->getRanges(trace));
+    }
+    state.SetLabel(state.range(0) == 0 ? "pyarrow" : "duckdb");
+    state.counters["reads"] = trace.size();
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+// -------------------------------------------------------------------------------
+void columnTypes(benchmark::internal::Benchmark* benchmark) {
+    for (int64_t type = INT32; type <= DICTIONARY; type++) benchmark->Arg(type);
+}
+// -------------------------------------------------------------------------------
+} // namespace
+// -------------------------------------------------------------------------------
+// wide and long tables
+BENCHMARK(BM_Construction)->ArgsProduct({{1000}, {10}, {0, 8}})->ArgsProduct({{4}, {10000}, {0, 8}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ConstructionFromSnapshot)->Args({1000, 10, 0})->Args({4, 10000, 0})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ViewConstruction)->Args({1000, 10, 0})->Args({20, 1000, 0})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FooterProbe)->Args({64, 100})->Args({1000, 10});
+BENCHMARK(BM_SequentialScan)->ArgsProduct({{INT32, DOUBLE, STRING, DICTIONARY}, {1 << 20, 8 << 20}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IPCSequentialScan)->ArgsProduct({{INT32, DOUBLE, STRING}, {1 << 20, 8 << 20}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ReadTable)->ArgsProduct({{INT32, DOUBLE, STRING}, {0, 1}})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EncodingSelection)->ArgsProduct({{INT32, DOUBLE, STRING}, {0, 1}, {0, 1}})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RandomChunkReads)->Apply(columnTypes);
+BENCHMARK(BM_RandomUnalignedReads)->Apply(columnTypes);
+BENCHMARK(BM_ReplayTrace)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ReplayTraceBatched)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+// -------------------------------------------------------------------------------
+BENCHMARK_MAIN();
+// -------------------------------------------------------------------------------
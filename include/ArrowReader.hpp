@@ -1,6 +1,8 @@
 #pragma once
 // -------------------------------------------------------------------------------------
 #include <arrow/api.h>
+#include <arrow/util/future.h>
+#include <arrow/util/thread_pool.h>
 // -------------------------------------------------------------------------------------
 namespace virtualfile {
 // -------------------------------------------------------------------------------------
@@ -10,7 +12,17 @@ protected:
 public:
     explicit ArrowReader(const std::shared_ptr<arrow::Schema>& schema) : schema(schema){}
     virtual ~ArrowReader() = default;
+    const std::shared_ptr<arrow::Schema>& getSchema() const { return schema; }
+    // may be called concurrently by virtual files serving several ranges at once
     virtual std::shared_ptr<arrow::Array> readChunk(uint64_t rowgroup, uint64_t column) = 0;
+    // Reads the chunk in the background, by default by calling readChunk on the executor.
+    // Readers of asynchronous sources should override this instead of blocking a thread of the executor.
+    virtual arrow::Future<std::shared_ptr<arrow::Array>> readChunkAsync(
+            const uint64_t rowgroup, const uint64_t column, arrow::internal::Executor* executor) {
+        return arrow::DeferNotOk(executor->Submit([this, rowgroup, column] {
+            return readChunk(rowgroup, column);
+        }));
+    }
 };
 // -------------------------------------------------------------------------------------
 // debugging utility
@@ -24,6 +36,11 @@ public:
             const uint64_t rowgroup, const uint64_t column) override {
         return table->column(column)->chunk(rowgroup);
     }
+
+    arrow::Future<std::shared_ptr<arrow::Array>> readChunkAsync(
+            const uint64_t rowgroup, const uint64_t column, arrow::internal::Executor*) override {
+        return arrow::Future<std::shared_ptr<arrow::Array>>::MakeFinished(readChunk(rowgroup, column));
+    }
 };
 // -------------------------------------------------------------------------------------
 } // namespace virtualfile
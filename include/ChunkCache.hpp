@@ -0,0 +1,106 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+// -------------------------------------------------------------------------------------
+#include <arrow/api.h>
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+// LRU cache of serialized column chunks bounded by the total size of the cached chunks.
+// Can be shared between multiple virtual files, each of them registers itself to obtain a unique file id.
+class ChunkCache {
+public:
+    struct Key {
+        uint64_t file;
+        uint64_t rowgroup;
+        uint64_t column;
+
+        bool operator==(const Key& other) const = default;
+    };
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<uint64_t>{}(key.file * 0x9E3779B97F4A7C15ull ^ key.rowgroup << 32 ^ key.column);
+        }
+    };
+    using Entry = std::pair<Key, std::shared_ptr<arrow::Buffer>>;
+
+    const uint64_t capacity;
+    uint64_t size = 0;
+    // most recently used entries first
+    std::list<Entry> entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    mutable std::mutex mutex;
+    std::atomic<uint64_t> hits = 0;
+    std::atomic<uint64_t> misses = 0;
+    std::atomic<uint64_t> nextFile = 0;
+
+    void evict(const std::list<Entry>::iterator entry) {
+        size -= entry->second->size();
+        index.erase(entry->first);
+        entries.erase(entry);
+    }
+
+public:
+    explicit ChunkCache(const uint64_t capacity) : capacity(capacity) {}
+
+    uint64_t registerFile() { return nextFile++; }
+
+    // Returns the cached chunk or nullptr
+    std::shared_ptr<arrow::Buffer> get(const Key& key) {
+        std::lock_guard lock(mutex);
+        const auto it = index.find(key);
+        if (it == index.end()) {
+            misses++;
+            return nullptr;
+        }
+        hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->second;
+    }
+
+    // Whether the chunk is cached, without counting a hit or a miss or marking it as used
+    bool contains(const Key& key) const {
+        std::lock_guard lock(mutex);
+        return index.contains(key);
+    }
+
+    // Inserts the chunk and evicts the least recently used chunks until the cache fits into its capacity again.
+    // Chunks larger than the whole cache are not cached.
+    void put(const Key& key, const std::shared_ptr<arrow::Buffer>& chunk) {
+        if (static_cast<uint64_t>(chunk->size()) > capacity) return;
+        std::lock_guard lock(mutex);
+        if (const auto it = index.find(key); it != index.end()) {
+            evict(it->second);
+        }
+        entries.emplace_front(key, chunk);
+        index[key] = entries.begin();
+        size += chunk->size();
+        while (size > capacity) {
+            evict(std::prev(entries.end()));
+        }
+    }
+
+    void clear() {
+        std::lock_guard lock(mutex);
+        entries.clear();
+        index.clear();
+        size = 0;
+    }
+
+    uint64_t getHits() const { return hits; }
+    uint64_t getMisses() const { return misses; }
+    uint64_t getCapacity() const { return capacity; }
+    uint64_t getSize() const {
+        std::lock_guard lock(mutex);
+        return size;
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
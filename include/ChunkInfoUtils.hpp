@@ -0,0 +1,134 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+// -------------------------------------------------------------------------------------
+#include <arrow/api.h>
+#include <arrow/util/bit_run_reader.h>
+#include <arrow/util/parallel.h>
+#include <arrow/util/thread_pool.h>
+// -------------------------------------------------------------------------------------
+#include "ArrowReader.hpp"
+#include "Statistics.hpp"
+#include "parquet/ColumnChunkWriter.hpp"
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+// Derives the chunk infos of virtual files from the chunks themselves instead of building them by hand
+class ChunkInfoUtils {
+    template <typename T>
+    static ZoneMap makeZoneMap(const T min, const T max) {
+        ZoneMap result{};
+        memcpy(result.min_value.data(), &min, sizeof(T));
+        memcpy(result.max_value.data(), &max, sizeof(T));
+        return result;
+    }
+
+    // Minimum and maximum of the valid values, NaNs are ignored like by parquet
+    template <typename T>
+    static std::optional<ZoneMap> getMinMax(const arrow::ArraySpan& data) {
+        const T* values = data.GetValues<T>(1);
+        std::optional<T> min;
+        std::optional<T> max;
+        const auto visit = [&](const int64_t position, const int64_t length) {
+            for (int64_t k = position; k != position + length; k++) {
+                const T value = values[k];
+                if constexpr (std::is_floating_point_v<T>) {
+                    if (std::isnan(value)) continue;
+                }
+                if (!min || value < *min) min = value;
+                if (!max || value > *max) max = value;
+            }
+        };
+        if (data.GetNullCount() == 0) {
+            visit(0, data.length);
+        } else {
+            arrow::internal::VisitSetBitRunsVoid(data.buffers[0].data, data.offset, data.length, visit);
+        }
+        if (!min) return std::nullopt;
+        return makeZoneMap(*min, *max);
+    }
+
+    static std::optional<ZoneMap> getBooleanMinMax(const arrow::ArraySpan& data) {
+        const uint8_t* values = data.buffers[1].data;
+        bool anyFalse = false;
+        bool anyTrue = false;
+        const auto visit = [&](const int64_t position, const int64_t length) {
+            const int64_t set = arrow::internal::CountSetBits(values, data.offset + position, length);
+            anyTrue |= set != 0;
+            anyFalse |= set != length;
+        };
+        if (data.GetNullCount() == 0) {
+            visit(0, data.length);
+        } else {
+            arrow::internal::VisitSetBitRunsVoid(data.buffers[0].data, data.offset, data.length, visit);
+        }
+        if (!anyFalse && !anyTrue) return std::nullopt;
+        return makeZoneMap<uint8_t>(!anyFalse, anyTrue);
+    }
+
+public:
+    // Zone map of the types whose statistics are written by virtual parquet files, i.e. of booleans, 32 and 64 bit
+    // integers, floating point numbers, dates and timestamps. nullopt for other types and chunks without values
+    static std::optional<ZoneMap> computeZoneMap(const arrow::Array& array) {
+        const arrow::ArraySpan data(*array.data());
+        switch (array.type_id()) {
+            case arrow::Type::BOOL: return getBooleanMinMax(data);
+            case arrow::Type::INT32:
+            case arrow::Type::DATE32: return getMinMax<int32_t>(data);
+            case arrow::Type::INT64:
+            case arrow::Type::TIMESTAMP: return getMinMax<int64_t>(data);
+            case arrow::Type::FLOAT: return getMinMax<float>(data);
+            case arrow::Type::DOUBLE: return getMinMax<double>(data);
+            default: return std::nullopt;
+        }
+    }
+
+    // Chunk info of the chunk including its zone map. Dictionary arrays get a dictionary chunk info, their
+    // uncompressed size is unused and 0
+    static ChunkInfo computeChunkInfo(const std::shared_ptr<arrow::Array>& chunk) {
+        ChunkInfo result{.uncompressed_size = 0, .tuple_count = static_cast<uint64_t>(chunk->length()),
+            .null_count = static_cast<uint64_t>(chunk->null_count())};
+        if (arrow::is_dictionary(chunk->type_id())) {
+            const std::shared_ptr<arrow::Array>& dictionary = static_cast<const arrow::DictionaryArray&>(*chunk).dictionary();
+            const uint64_t count = dictionary->length();
+            // the unique values of strings are prefixed by their 4 byte lengths
+            uint64_t length = ColumnChunkWriter::getValuesSize(dictionary);
+            if (!arrow::is_fixed_width(dictionary->type_id())) length -= count * sizeof(int32_t);
+            result.dictionary_chunk_info = DictionaryChunkInfo{count, length};
+            return result;
+        }
+        result.uncompressed_size = ColumnChunkWriter::getValuesSize(chunk);
+        result.zone_map = computeZoneMap(*chunk);
+        return result;
+    }
+
+    // Chunk infos of all chunks of the reader indexed by column and rowgroup. The chunks are read and
+    // inspected in parallel on the executor if one is given
+    static std::vector<std::vector<ChunkInfo>> computeChunkInfos(ArrowReader& reader, const uint64_t numRowgroups,
+                                                                 arrow::internal::Executor* executor = nullptr) {
+        const uint64_t numColumns = reader.getSchema()->num_fields();
+        std::vector<std::vector<ChunkInfo>> result(numColumns, std::vector<ChunkInfo>(numRowgroups));
+        const arrow::Status status = arrow::internal::OptionalParallelFor(executor != nullptr,
+            static_cast<int>(numRowgroups * numColumns), [&](const int k) {
+                try {
+                    result[k % numColumns][k / numColumns] = computeChunkInfo(reader.readChunk(k / numColumns, k % numColumns));
+                } catch (const std::exception& e) {
+                    return arrow::Status::IOError(e.what());
+                }
+                return arrow::Status::OK();
+            }, executor ? executor : arrow::internal::GetCpuThreadPool());
+        if (!status.ok()) {
+            throw std::runtime_error{status.ToString()};
+        }
+        return result;
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
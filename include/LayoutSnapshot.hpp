@@ -0,0 +1,235 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+// -------------------------------------------------------------------------------------
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+// -------------------------------------------------------------------------------------
+#include "Statistics.hpp"
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+// Binary snapshot of the layout of a virtual file, i.e. everything computed at construction, s.t. a file with the
+// same data is opened without predicting and serializing its layout again. A snapshot is a sequence of sections of
+// trivially copyable values, each prefixed by its number of values and padded to 8 bytes.
+class LayoutSnapshotWriter {
+    std::vector<uint8_t> data;
+
+    // Chunk info without its pages, whose optional statistics are flagged. Records have no padding,
+    // s.t. the snapshot of the same layout has the same bytes
+    struct ChunkRecord {
+        uint64_t uncompressed_size;
+        uint64_t tuple_count;
+        uint64_t null_count;
+        uint64_t unique_values_count;
+        uint64_t unique_values_length;
+        std::array<std::byte, 8> min_value;
+        std::array<std::byte, 8> max_value;
+        uint64_t compressed_size;
+        uint64_t num_pages;
+        uint64_t has_dictionary;
+        uint64_t has_zone_map;
+        uint64_t has_compressed_size;
+        uint64_t encoding;
+        uint64_t has_encoding;
+        uint64_t compression;
+        uint64_t has_compression;
+    };
+    struct PageRecord {
+        uint64_t uncompressed_size;
+        uint64_t tuple_count;
+        uint64_t null_count;
+        uint64_t compressed_size;
+        uint64_t has_compressed_size;
+        uint64_t encoded_size;
+        uint64_t has_encoded_size;
+    };
+    friend class LayoutSnapshotReader;
+
+public:
+    static constexpr uint64_t MAGIC = 0x33544f4e53594c56ull; // "VLYSNOT3"
+
+    LayoutSnapshotWriter() { append(MAGIC); }
+
+    template <typename T>
+    void append(std::span<const T> values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const uint64_t count = values.size();
+        const uint8_t* countBytes = reinterpret_cast<const uint8_t*>(&count);
+        data.insert(data.end(), countBytes, countBytes + sizeof(count));
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values.data());
+        data.insert(data.end(), bytes, bytes + values.size_bytes());
+        data.resize((data.size() + 7) / 8 * 8);
+    }
+
+    template <typename T>
+    void append(const std::vector<T>& values) { append(std::span<const T>(values)); }
+
+    template <typename T>
+    void append(const T& value) { append(std::span<const T>(&value, 1)); }
+
+    void append(const std::string& value) { append(std::span<const char>(value)); }
+
+    void append(const arrow::Buffer& buffer) { append(buffer.span_as<uint8_t>()); }
+
+    // Chunk infos column by column, including their pages
+    void append(const std::vector<std::vector<ChunkInfo>>& chunkInfos) {
+        std::vector<uint64_t> numRowgroups;
+        std::vector<ChunkRecord> chunks;
+        std::vector<PageRecord> pages;
+        for (const auto& column : chunkInfos) {
+            numRowgroups.push_back(column.size());
+            for (const ChunkInfo& info : column) {
+                ChunkRecord& chunk = chunks.emplace_back();
+                chunk.uncompressed_size = info.uncompressed_size;
+                chunk.tuple_count = info.tuple_count;
+                chunk.null_count = info.null_count;
+                chunk.has_dictionary = info.dictionary_chunk_info.has_value();
+                if (info.dictionary_chunk_info) {
+                    chunk.unique_values_count = info.dictionary_chunk_info->unique_values_count;
+                    chunk.unique_values_length = info.dictionary_chunk_info->unique_values_length;
+                }
+                chunk.has_zone_map = info.zone_map.has_value();
+                if (info.zone_map) {
+                    chunk.min_value = info.zone_map->min_value;
+                    chunk.max_value = info.zone_map->max_value;
+                }
+                chunk.has_compressed_size = info.compressed_size.has_value();
+                chunk.compressed_size = info.compressed_size.value_or(0);
+                chunk.has_compression = info.compression.has_value();
+                chunk.compression = static_cast<uint64_t>(info.compression.value_or(0));
+                chunk.has_encoding = info.encoding.has_value();
+                chunk.encoding = static_cast<uint64_t>(info.encoding.value_or(ValueEncoding::PLAIN));
+                chunk.num_pages = info.pages.size();
+                for (const PageInfo& pageInfo : info.pages) {
+                    PageRecord& page = pages.emplace_back();
+                    page.uncompressed_size = pageInfo.uncompressed_size;
+                    page.tuple_count = pageInfo.tuple_count;
+                    page.null_count = pageInfo.null_count;
+                    page.has_compressed_size = pageInfo.compressed_size.has_value();
+                    page.compressed_size = pageInfo.compressed_size.value_or(0);
+                    page.has_encoded_size = pageInfo.encoded_size.has_value();
+                    page.encoded_size = pageInfo.encoded_size.value_or(0);
+                }
+            }
+        }
+        append(numRowgroups);
+        append(chunks);
+        append(pages);
+    }
+
+    std::shared_ptr<arrow::Buffer> finish() { return arrow::Buffer::FromVector(std::move(data)); }
+};
+// -------------------------------------------------------------------------------------
+// Reads the sections of a snapshot in the order they were written. Values are copied out of the snapshot,
+// byte sections are returned as zero-copy slices of it, s.t. they stay in the mapped file
+class LayoutSnapshotReader {
+    std::shared_ptr<arrow::Buffer> snapshot;
+    uint64_t position = 0;
+
+    // Returns the offset and the number of values of the next section
+    template <typename T>
+    std::pair<uint64_t, uint64_t> nextSection() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        uint64_t count;
+        if (position + sizeof(count) > static_cast<uint64_t>(snapshot->size())) {
+            throw std::runtime_error{"truncated layout snapshot"};
+        }
+        memcpy(&count, snapshot->data() + position, sizeof(count));
+        const uint64_t begin = position + sizeof(count);
+        if (count > (snapshot->size() - begin) / sizeof(T)) {
+            throw std::runtime_error{"truncated layout snapshot"};
+        }
+        position = (begin + count * sizeof(T) + 7) / 8 * 8;
+        return {begin, count};
+    }
+
+public:
+    explicit LayoutSnapshotReader(std::shared_ptr<arrow::Buffer> snapshot) : snapshot(std::move(snapshot)) {
+        if (read<uint64_t>() != LayoutSnapshotWriter::MAGIC) {
+            throw std::runtime_error{"not a layout snapshot"};
+        }
+    }
+
+    // Maps the snapshot file into memory instead of reading it
+    static LayoutSnapshotReader map(const std::string& path) {
+        auto file = arrow::io::MemoryMappedFile::Open(path, arrow::io::FileMode::READ);
+        if (!file.ok()) throw std::runtime_error{file.status().ToString()};
+        auto buffer = (*file)->ReadAt(0, (*file)->GetSize().ValueOr(0));
+        if (!buffer.ok()) throw std::runtime_error{buffer.status().ToString()};
+        return LayoutSnapshotReader(std::move(*buffer));
+    }
+
+    template <typename T>
+    std::vector<T> readVector() {
+        const auto [begin, count] = nextSection<T>();
+        std::vector<T> result(count);
+        memcpy(result.data(), snapshot->data() + begin, count * sizeof(T));
+        return result;
+    }
+
+    template <typename T>
+    T read() {
+        const auto [begin, count] = nextSection<T>();
+        if (count != 1) throw std::runtime_error{"unexpected section of layout snapshot"};
+        T result;
+        memcpy(&result, snapshot->data() + begin, sizeof(T));
+        return result;
+    }
+
+    std::string readString() {
+        const auto [begin, count] = nextSection<char>();
+        return {reinterpret_cast<const char*>(snapshot->data() + begin), count};
+    }
+
+    std::shared_ptr<arrow::Buffer> readBuffer() {
+        const auto [begin, count] = nextSection<uint8_t>();
+        return arrow::SliceBuffer(snapshot, begin, count);
+    }
+
+    std::vector<std::vector<ChunkInfo>> readChunkInfos() {
+        const auto numRowgroups = readVector<uint64_t>();
+        const auto chunks = readVector<LayoutSnapshotWriter::ChunkRecord>();
+        const auto pages = readVector<LayoutSnapshotWriter::PageRecord>();
+        std::vector<std::vector<ChunkInfo>> result(numRowgroups.size());
+        uint64_t c = 0;
+        uint64_t p = 0;
+        for (size_t j = 0; j != numRowgroups.size(); j++) {
+            result[j].reserve(numRowgroups[j]);
+            for (uint64_t i = 0; i != numRowgroups[j]; i++, c++) {
+                if (c >= chunks.size() || chunks[c].num_pages > pages.size() - p) {
+                    throw std::runtime_error{"corrupt layout snapshot"};
+                }
+                const auto& chunk = chunks[c];
+                ChunkInfo& info = result[j].emplace_back(ChunkInfo{chunk.uncompressed_size, chunk.tuple_count, chunk.null_count});
+                if (chunk.has_dictionary) info.dictionary_chunk_info = {chunk.unique_values_count, chunk.unique_values_length};
+                if (chunk.has_zone_map) info.zone_map = {chunk.min_value, chunk.max_value};
+                if (chunk.has_compressed_size) info.compressed_size = chunk.compressed_size;
+                if (chunk.has_compression) info.compression = static_cast<int>(chunk.compression);
+                if (chunk.has_encoding) {
+                    if (chunk.encoding > static_cast<uint64_t>(ValueEncoding::BYTE_STREAM_SPLIT)) {
+                        throw std::runtime_error{"corrupt layout snapshot"};
+                    }
+                    info.encoding = static_cast<ValueEncoding>(chunk.encoding);
+                }
+                info.pages.reserve(chunk.num_pages);
+                for (const auto end = p + chunk.num_pages; p != end; p++) {
+                    const auto& page = pages[p];
+                    info.pages.push_back({page.uncompressed_size, page.tuple_count, page.null_count,
+                        page.has_compressed_size ? std::optional(page.compressed_size) : std::nullopt,
+                        page.has_encoded_size ? std::optional(page.encoded_size) : std::nullopt});
+                }
+            }
+        }
+        return result;
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
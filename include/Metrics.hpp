@@ -0,0 +1,287 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+enum class Counter : uint8_t {
+    // getRange and getRangeSegments calls
+    Requests,
+    BytesServed,
+    // chunks overlapping the requests
+    ChunksTouched,
+    // chunks or parts of chunks serialized, borrowed and cached chunks are not serialized
+    ChunksSerialized,
+    // pages of which only a part is requested, which are written byte by byte at their edges
+    PartialPages,
+    // requests including a part of the footer
+    FooterReads,
+    CacheHits,
+    CacheMisses,
+    NumCounters
+};
+
+enum class Latency : uint8_t {
+    // whole getRange and getRangeSegments calls
+    Request,
+    // reads of chunks from the reader, including waiting for chunks read ahead
+    Read,
+    // serialization of chunks or parts of chunks
+    Serialize,
+    NumLatencies
+};
+
+// Latencies in buckets of powers of two nanoseconds, bucket b counts the latencies in [2^b, 2^(b+1))
+struct LatencyHistogram {
+    static constexpr size_t NUM_BUCKETS = 40;
+
+    std::array<uint64_t, NUM_BUCKETS> buckets{};
+    uint64_t count = 0;
+    uint64_t totalNanos = 0;
+
+    static size_t getBucket(const uint64_t nanos) {
+        return std::min<size_t>(std::bit_width(nanos | 1) - 1, NUM_BUCKETS - 1);
+    }
+
+    // Upper bound of the bucket containing the given quantile in nanoseconds, 0 if nothing was recorded
+    uint64_t quantile(const double q) const {
+        uint64_t seen = 0;
+        for (size_t b = 0; b != NUM_BUCKETS; b++) {
+            seen += buckets[b];
+            if (seen > 0 && seen >= q * count) return (uint64_t{2} << b) - 1;
+        }
+        return 0;
+    }
+};
+
+struct MetricsSnapshot {
+    std::array<uint64_t, static_cast<size_t>(Counter::NumCounters)> counters{};
+    std::array<LatencyHistogram, static_cast<size_t>(Latency::NumLatencies)> latencies{};
+
+    uint64_t get(const Counter counter) const { return counters[static_cast<size_t>(counter)]; }
+    const LatencyHistogram& get(const Latency latency) const { return latencies[static_cast<size_t>(latency)]; }
+};
+
+// Span of a single getRange or getRangeSegments call, which is passed to the trace hook of the file
+struct TraceSpan {
+    // first and last byte of the requested range
+    int64_t begin;
+    int64_t end;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::nanoseconds duration;
+    // whether the request returned segments instead of writing into a buffer
+    bool segments;
+};
+using TraceHook = std::function<void(const TraceSpan&)>;
+
+// Counters and latency histograms of a virtual file, which are sharded by thread s.t. recording rarely contends
+// on cache lines. Threads are spread round-robin over a shard per hardware thread and update it with relaxed
+// atomic additions, s.t. threads of any number of pools share the shards evenly. Shards are allocated on the
+// first record of one of their threads and summed up by snapshots. Everything recorded is also recorded in the
+// global metrics of all files.
+class Metrics {
+    static constexpr size_t NUM_COUNTERS = static_cast<size_t>(Counter::NumCounters);
+    static constexpr size_t NUM_LATENCIES = static_cast<size_t>(Latency::NumLatencies);
+
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, NUM_COUNTERS> counters{};
+        // the buckets followed by the total nanoseconds of every latency
+        std::array<std::array<std::atomic<uint64_t>, LatencyHistogram::NUM_BUCKETS + 1>, NUM_LATENCIES> latencies{};
+    };
+
+    // Power of two of at least the number of hardware threads
+    static size_t getNumShards() {
+        static const size_t numShards = std::bit_ceil<size_t>(std::clamp<size_t>(
+            std::thread::hardware_concurrency(), 1, 1024));
+        return numShards;
+    }
+
+    const std::unique_ptr<std::atomic<Shard*>[]> shards = std::make_unique<std::atomic<Shard*>[]>(getNumShards());
+    const bool isGlobal;
+
+    explicit Metrics(const bool isGlobal) : isGlobal(isGlobal) {}
+
+    // Shard of the current thread, consecutive threads are assigned to consecutive shards
+    static size_t getShardIndex() {
+        static std::atomic<size_t> nextThread = 0;
+        static thread_local const size_t shard = nextThread.fetch_add(1, std::memory_order_relaxed) & (getNumShards() - 1);
+        return shard;
+    }
+
+    static void add(std::atomic<uint64_t>& value, const uint64_t delta) {
+        value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    Shard& getShard() {
+        std::atomic<Shard*>& shard = shards[getShardIndex()];
+        Shard* result = shard.load(std::memory_order_acquire);
+        if (!result) {
+            auto allocated = std::make_unique<Shard>();
+            if (shard.compare_exchange_strong(result, allocated.get(), std::memory_order_acq_rel)) {
+                result = allocated.release();
+            }
+        }
+        return *result;
+    }
+
+    // Timestamps of the latencies, the time stamp counter is read much faster than steady_clock
+    static uint64_t readTicks() {
+#if defined(__x86_64__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    // Calibrated against steady_clock once
+    static double getNanosPerTick() {
+#if defined(__x86_64__)
+        static const double nanosPerTick = [] {
+            const auto start = std::chrono::steady_clock::now();
+            const uint64_t startTicks = readTicks();
+            std::chrono::steady_clock::time_point end;
+            while ((end = std::chrono::steady_clock::now()) - start < std::chrono::milliseconds(1)) {}
+            return std::chrono::duration<double, std::nano>(end - start).count() / (readTicks() - startTicks);
+        }();
+        return nanosPerTick;
+#else
+        return 1.0 * std::chrono::steady_clock::period::num / std::chrono::steady_clock::period::den * 1e9;
+#endif
+    }
+
+    static std::atomic<bool>& getTimingFlag() {
+        static std::atomic<bool> enabled = true;
+        return enabled;
+    }
+
+    static std::chrono::nanoseconds getDuration(const uint64_t startTicks) {
+        return std::chrono::nanoseconds(static_cast<int64_t>((readTicks() - startTicks) * getNanosPerTick()));
+    }
+
+    // Nesting depth of the requests of the current thread, e.g. a view requests the file it projects
+    static size_t& getRequestDepth() {
+        static thread_local size_t depth = 0;
+        return depth;
+    }
+
+    void recordOnly(const Counter counter, const uint64_t value) {
+        add(getShard().counters[static_cast<size_t>(counter)], value);
+    }
+
+    void recordOnly(const Latency latency, const uint64_t nanos) {
+        auto& histogram = getShard().latencies[static_cast<size_t>(latency)];
+        add(histogram[LatencyHistogram::getBucket(nanos)], 1);
+        add(histogram[LatencyHistogram::NUM_BUCKETS], nanos);
+    }
+
+public:
+    Metrics() : Metrics(false) {}
+    Metrics(const Metrics&) = delete;
+    ~Metrics() {
+        for (size_t s = 0; s != getNumShards(); s++) delete shards[s].load();
+    }
+
+    // Latencies take two timestamps per request, chunk read and chunk serialization, which is a noticeable part of
+    // small in-memory requests. Without timing, all latencies but the ones of the requests are skipped
+    static void setTimingEnabled(const bool enabled) { getTimingFlag().store(enabled, std::memory_order_relaxed); }
+    static bool isTimingEnabled() { return getTimingFlag().load(std::memory_order_relaxed); }
+
+    // Metrics of all files. Requests nested in requests of other files, e.g. of views, are only counted once
+    static Metrics& global() {
+        static Metrics metrics(true);
+        return metrics;
+    }
+
+    void record(const Counter counter, const uint64_t value = 1) {
+        recordOnly(counter, value);
+        if (!isGlobal) global().recordOnly(counter, value);
+    }
+
+    void record(const Latency latency, const std::chrono::nanoseconds duration) {
+        recordOnly(latency, duration.count());
+        if (!isGlobal) global().recordOnly(latency, duration.count());
+    }
+
+    MetricsSnapshot getSnapshot() const {
+        MetricsSnapshot result;
+        for (size_t s = 0; s != getNumShards(); s++) {
+            const Shard* shard = shards[s].load(std::memory_order_acquire);
+            if (!shard) continue;
+            for (size_t c = 0; c != NUM_COUNTERS; c++) {
+                result.counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+            }
+            for (size_t l = 0; l != NUM_LATENCIES; l++) {
+                LatencyHistogram& histogram = result.latencies[l];
+                for (size_t b = 0; b != LatencyHistogram::NUM_BUCKETS; b++) {
+                    const uint64_t count = shard->latencies[l][b].load(std::memory_order_relaxed);
+                    histogram.buckets[b] += count;
+                    histogram.count += count;
+                }
+                histogram.totalNanos += shard->latencies[l][LatencyHistogram::NUM_BUCKETS].load(std::memory_order_relaxed);
+            }
+        }
+        return result;
+    }
+
+    // Records the duration of its scope if timing is enabled
+    class Timer {
+        Metrics& metrics;
+        const Latency latency;
+        // 0 if timing is disabled
+        const uint64_t start = isTimingEnabled() ? readTicks() : 0;
+
+    public:
+        Timer(Metrics& metrics, const Latency latency) : metrics(metrics), latency(latency) {}
+        ~Timer() {
+            if (start) metrics.record(latency, getDuration(start));
+        }
+    };
+
+    // Records a getRange or getRangeSegments call when it goes out of scope and passes its span to the trace hook
+    class Request {
+        Metrics& metrics;
+        const TraceHook& hook;
+        const int64_t begin;
+        const int64_t end;
+        const bool segments;
+        const bool nested;
+        // the time point of the span is only taken if there is a hook
+        const std::chrono::steady_clock::time_point start = hook ? std::chrono::steady_clock::now()
+                                                                 : std::chrono::steady_clock::time_point();
+        const uint64_t startTicks = readTicks();
+
+    public:
+        Request(Metrics& metrics, const TraceHook& hook, const int64_t begin, const int64_t end, const bool segments)
+            : metrics(metrics), hook(hook), begin(begin), end(end), segments(segments), nested(getRequestDepth()++ > 0) {}
+        Request(const Request&) = delete;
+        ~Request() {
+            getRequestDepth()--;
+            const auto duration = getDuration(startTicks);
+            const uint64_t bytes = end >= begin ? end - begin + 1 : 0;
+            if (nested) {
+                metrics.recordOnly(Counter::Requests, 1);
+                metrics.recordOnly(Counter::BytesServed, bytes);
+                metrics.recordOnly(Latency::Request, duration.count());
+            } else {
+                metrics.record(Counter::Requests);
+                metrics.record(Counter::BytesServed, bytes);
+                metrics.record(Latency::Request, duration);
+            }
+            if (hook) hook({begin, end, start, duration, segments});
+        }
+    };
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
@@ -0,0 +1,67 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+// -------------------------------------------------------------------------------------
+#include <arrow/api.h>
+// -------------------------------------------------------------------------------------
+#include "VirtualFile.hpp"
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+// Pull-based stream of a range of a virtual file, e.g. of a whole file sent to a client. The range is produced in
+// windows of at most window bytes on request. The stream keeps the chunk its last window ended in, s.t. every chunk
+// is read and serialized once however many windows it spans. The memory of a stream is therefore bounded by its
+// window plus one chunk: the values of a chunk read from the reader, or the whole serialized chunk of chunks built
+// as a whole, e.g. compressed ones, which the chunk cache of the file may hold as well. The concatenation of the
+// windows equals getRange(range).
+class RangeStream {
+    std::shared_ptr<VirtualFile> file;
+    // the part of the range not produced yet
+    ByteRange range;
+    uint64_t window;
+    VirtualFile::StreamChunk chunk;
+
+    ByteRange nextWindow(const uint64_t limit) {
+        const ByteRange result{range.begin, std::min<int64_t>(range.end, range.begin + std::min(window, limit) - 1)};
+        range.begin = result.end + 1;
+        return result;
+    }
+
+public:
+    static constexpr uint64_t DEFAULT_WINDOW = 1 << 20;
+
+    RangeStream(std::shared_ptr<VirtualFile> file, const ByteRange range, const uint64_t window = DEFAULT_WINDOW) :
+            file(std::move(file)), range(range), window(window) {
+        if (window == 0) {
+            throw std::logic_error{"the window of a range stream has to hold at least one byte"};
+        }
+        if (range.begin < 0 || range.end >= static_cast<int64_t>(this->file->predictSizeOfFile())) {
+            throw std::out_of_range{"the range exceeds the file"};
+        }
+    }
+
+    bool done() const { return range.begin > range.end; }
+    uint64_t getRemainingSize() const { return done() ? 0 : range.size(); }
+
+    // The next window as segments, which borrow the memory of the chunks where possible. Empty once done
+    std::vector<std::shared_ptr<arrow::Buffer>> nextSegments() {
+        if (done()) return {};
+        return file->getStreamSegments(nextWindow(window), chunk);
+    }
+
+    // Writes the next window, or as much of it as the buffer holds, into the buffer and returns its size.
+    // Returns 0 once done
+    uint64_t next(const std::span<char> out) {
+        if (done() || out.empty()) return 0;
+        const ByteRange next = nextWindow(out.size());
+        file->getStreamRange(next, out.first(next.size()), chunk);
+        return next.size();
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
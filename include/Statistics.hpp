@@ -2,6 +2,7 @@
 #include <array>
 #include <cstdint>
 #include <optional>
+#include <vector>
 
 // -------------------------------------------------------------------------------------
 namespace virtualfile {
@@ -16,14 +17,52 @@ struct ZoneMap {
     std::array<std::byte, 8> max_value;
 };
 // -------------------------------------------------------------------------------------
+// Encoding of the values of the data pages of a chunk, which is not dictionary encoded
+enum class ValueEncoding : uint8_t {
+    PLAIN,
+    // deltas of integers, bit-packed in miniblocks
+    DELTA_BINARY_PACKED,
+    // lengths of strings and binaries encoded as DELTA_BINARY_PACKED followed by their bytes
+    DELTA_LENGTH_BYTE_ARRAY,
+    // bytes of fixed width values split into a stream per byte, which compresses better
+    BYTE_STREAM_SPLIT
+};
+// -------------------------------------------------------------------------------------
+struct PageInfo {
+    // Size of the plain encoded valid values of the page, unused for dictionary encoded chunks
+    uint64_t uncompressed_size;
+    uint64_t tuple_count;
+    uint64_t null_count = 0;
+    // Size of the compressed page body
+    std::optional<uint64_t> compressed_size = std::nullopt;
+    // Size of the values in the encoding of the chunk, only known for encodings other than PLAIN
+    std::optional<uint64_t> encoded_size = std::nullopt;
+};
+// -------------------------------------------------------------------------------------
 struct ChunkInfo {
     // Necessary statistics
+    // Size of the plain encoded valid values
     uint64_t uncompressed_size;
     uint64_t tuple_count;
+    // Number of null values, which are not part of the encoded values
+    uint64_t null_count = 0;
 
     // Optional statistics for better performance
     std::optional<DictionaryChunkInfo> dictionary_chunk_info = std::nullopt;
     std::optional<ZoneMap> zone_map = std::nullopt;
+
+    // Size of the compressed chunk, computed once by virtual files serving compressed chunks
+    // and reused if passed to the next virtual file serving the same data
+    std::optional<uint64_t> compressed_size = std::nullopt;
+    // Codec (the value of arrow::Compression::type) the compressed sizes of the chunk and its pages were computed
+    // with, the sizes are recomputed by virtual files serving the chunk with another codec
+    std::optional<int> compression = std::nullopt;
+    // Data pages of the chunk, computed once by virtual files splitting chunks into several pages
+    // and reused if passed to the next virtual file with the same page size
+    std::vector<PageInfo> pages = {};
+    // Encoding of the values, selected once by virtual files selecting encodings per chunk
+    // and reused if passed to the next virtual file with the same pages
+    std::optional<ValueEncoding> encoding = std::nullopt;
 };
 // -------------------------------------------------------------------------------------
 
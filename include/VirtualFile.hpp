@@ -1,12 +1,20 @@
 #pragma once
 // -------------------------------------------------------------------------------------
 #include <assert.h>
+#include <algorithm>
+#include <limits>
 #include <memory>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <vector>
 // -------------------------------------------------------------------------------------
 #include <arrow/api.h>
+#include <arrow/util/parallel.h>
 // -------------------------------------------------------------------------------------
 #include "ArrowReader.hpp"
+#include "Metrics.hpp"
 #include "Statistics.hpp"
 // -------------------------------------------------------------------------------------
 namespace virtualfile {
@@ -19,6 +27,15 @@ struct ByteRange {
 };
 
 class VirtualFile {
+public:
+    // Chunk a stream over the file keeps between its windows, s.t. a chunk spanning several windows is read from the
+    // reader and serialized once: either its values or the whole serialized chunk
+    struct StreamChunk {
+        uint64_t index = std::numeric_limits<uint64_t>::max();
+        std::shared_ptr<arrow::Array> values;
+        std::shared_ptr<arrow::Buffer> serialized;
+    };
+
 protected:
     std::shared_ptr<ArrowReader> reader;
     std::shared_ptr<arrow::Schema> schema;
@@ -26,18 +43,41 @@ protected:
     uint64_t size = 0; // initialized in child classes
     const size_t numColumns;
     const size_t numRowgroups;
+    mutable Metrics metrics;
+    TraceHook traceHook;
 
     virtual uint64_t predictMetadataOverhead() = 0;
-    virtual ChunkInfo predictChunkInfo(const ChunkInfo& info) = 0;
+    // Has to be thread-safe, the chunks may be predicted in parallel
+    virtual ChunkInfo predictChunkInfo(size_t column, const ChunkInfo& info) const = 0;
     virtual void registerPrecomputedSize(size_t rowgroup, size_t column, ChunkInfo predictedInfo) = 0;
 
-    uint64_t initSize() {
+    // Records the request in the metrics once the returned scope ends, every getRange and getRangeSegments opens one
+    Metrics::Request startRequest(const ByteRange range, const bool segments) const {
+        return {metrics, traceHook, range.begin, range.end, segments};
+    }
+
+    // The chunks are predicted independently of each other, in parallel batches if an executor is given,
+    // and registered in file order
+    uint64_t initSize(arrow::internal::Executor* executor = nullptr) {
+        constexpr size_t batchSize = 1024;
+        std::vector<ChunkInfo> predicted(numRowgroups * numColumns);
+        const arrow::Status status = arrow::internal::OptionalParallelFor(executor != nullptr,
+            static_cast<int>((predicted.size() + batchSize - 1) / batchSize), [&](const int batch) {
+                const size_t end = std::min(predicted.size(), (batch + 1) * batchSize);
+                for (size_t k = batch * batchSize; k != end; k++) {
+                    predicted[k] = predictChunkInfo(k % numColumns, chunkInfos[k % numColumns][k / numColumns]);
+                }
+                return arrow::Status::OK();
+            }, executor);
+        if (!status.ok()) {
+            throw std::runtime_error{status.ToString()};
+        }
         uint64_t result = 0;
         for (size_t i=0; i!=numRowgroups; i++) {
             for (size_t j=0; j!=numColumns; j++) {
-                const ChunkInfo predictedChunkInfo = predictChunkInfo(chunkInfos[j][i]);
-                registerPrecomputedSize(i, j, predictedChunkInfo);
-                result += predictedChunkInfo.uncompressed_size;
+                ChunkInfo& predictedChunkInfo = predicted[i * numColumns + j];
+                result += predictedChunkInfo.compressed_size.value_or(predictedChunkInfo.uncompressed_size);
+                registerPrecomputedSize(i, j, std::move(predictedChunkInfo));
             }
         }
         result += predictMetadataOverhead();
@@ -60,7 +100,68 @@ public:
     virtual ~VirtualFile() = default;
 
     virtual uint64_t predictSizeOfFile(){ return size; }
-    virtual std::string getRange(ByteRange range) = 0;
+    // Chunk infos including the statistics computed by the file, which can be persisted to construct the file faster
+    const std::vector<std::vector<ChunkInfo>>& getChunkInfos() const { return chunkInfos; }
+    // Counters and latencies of the requests served by this file
+    MetricsSnapshot getMetrics() const { return metrics.getSnapshot(); }
+    // Counters and latencies of the requests served by all files
+    static MetricsSnapshot getGlobalMetrics() { return Metrics::global().getSnapshot(); }
+    // Hook called with the span of every request once it is served, by the threads serving the requests concurrently.
+    // Has to be set before requests are served
+    void setTraceHook(TraceHook hook) { traceHook = std::move(hook); }
+    virtual std::string getRange(ByteRange range) {
+        std::string result(range.size(), '\0');
+        getRange(range, std::span<char>(result.data(), result.size()));
+        return result;
+    }
+    // Writes the range into the caller provided buffer, which has to hold at least range.size() bytes
+    virtual void getRange(ByteRange range, std::span<char> out) = 0;
+    // Ranges at most this many bytes apart are coalesced by getRanges, like the hole size limit of arrow's reads
+    static constexpr uint64_t DEFAULT_COALESCE_GAP = 8 << 10;
+
+    // Serves a batch of ranges, e.g. the reads of a reader opening and scanning the file. The ranges are sorted and
+    // overlapping ranges or ranges at most maxGap bytes apart are coalesced. The coalesced ranges are served in order
+    // as the windows of a stream, s.t. chunks touched by several of them are serialized once. Returns the ranges in
+    // the order given as slices of the coalesced ranges
+    virtual std::vector<std::shared_ptr<arrow::Buffer>> getRanges(std::span<const ByteRange> ranges,
+                                                                  const uint64_t maxGap = DEFAULT_COALESCE_GAP) {
+        std::vector<size_t> order(ranges.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::sort(order, {}, [&](const size_t r) { return ranges[r].begin; });
+        std::vector<std::shared_ptr<arrow::Buffer>> result(ranges.size());
+        StreamChunk chunk;
+        for (size_t first = 0, last; first != order.size(); first = last) {
+            ByteRange coalesced = ranges[order[first]];
+            for (last = first + 1; last != order.size()
+                 && ranges[order[last]].begin <= coalesced.end + 1 + static_cast<int64_t>(maxGap); last++) {
+                coalesced.end = std::max(coalesced.end, ranges[order[last]].end);
+            }
+            auto buffer = arrow::AllocateBuffer(std::max<int64_t>(coalesced.end - coalesced.begin + 1, 0));
+            if (!buffer.ok()) throw std::runtime_error{buffer.status().ToString()};
+            if (coalesced.end >= coalesced.begin) {
+                getStreamRange(coalesced, std::span<char>(reinterpret_cast<char*>((*buffer)->mutable_data()),
+                               coalesced.size()), chunk);
+            }
+            const std::shared_ptr<arrow::Buffer> coalescedBuffer = std::move(*buffer);
+            for (size_t r = first; r != last; r++) {
+                const ByteRange& range = ranges[order[r]];
+                result[order[r]] = arrow::SliceBuffer(coalescedBuffer, range.begin - coalesced.begin,
+                    std::max<int64_t>(range.end - range.begin + 1, 0));
+            }
+        }
+        return result;
+    }
+    // Returns the range as list of segments, whose concatenation equals getRange(range).
+    // Segments may borrow the memory of the arrays returned by the reader instead of copying it
+    virtual std::vector<std::shared_ptr<arrow::Buffer>> getRangeSegments(ByteRange range) {
+        return {arrow::Buffer::FromString(getRange(range))};
+    }
+    // getRange and getRangeSegments of the consecutive windows of a stream, which keep the chunk the previous window
+    // ended in. Files without chunks worth keeping serve the windows like any other range
+    virtual void getStreamRange(const ByteRange range, const std::span<char> out, StreamChunk&) { getRange(range, out); }
+    virtual std::vector<std::shared_ptr<arrow::Buffer>> getStreamSegments(const ByteRange range, StreamChunk&) {
+        return getRangeSegments(range);
+    }
 };
 // -------------------------------------------------------------------------------------
 }
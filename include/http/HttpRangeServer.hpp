@@ -0,0 +1,589 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+// -------------------------------------------------------------------------------------
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+// -------------------------------------------------------------------------------------
+#include <arrow/util/future.h>
+#include <arrow/util/thread_pool.h>
+// -------------------------------------------------------------------------------------
+#include "../RangeStream.hpp"
+#include "../VirtualFile.hpp"
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+struct HttpRangeServerOptions {
+    // Address and port the server listens on, port 0 picks a free port
+    std::string host = "127.0.0.1";
+    uint16_t port = 0;
+    // Bytes of a response produced ahead of the socket. Large ranges are produced in parts of this size once the
+    // client received the previous ones, s.t. a slow client holds a window and one chunk rather than the whole range
+    uint64_t window = 1 << 20;
+    // Requests whose header exceeds the limit are rejected, connections buffer at most this much unhandled input
+    uint64_t maxHeaderSize = 64 << 10;
+    // Requests of more ranges are served the whole file, s.t. a small request cannot queue many parts
+    uint64_t maxRanges = 64;
+    // Executor serializing the windows of the responses, arrow's CPU thread pool by default
+    std::shared_ptr<arrow::internal::Executor> executor = nullptr;
+};
+// -------------------------------------------------------------------------------------
+// Embeddable HTTP/1.1 server of virtual files, which clients read like objects of an object store. Supports
+// HEAD, GET of whole files, single ranges and multiple ranges as multipart/byteranges, keep-alive and pipelining.
+// A single thread does the socket I/O of all connections with an epoll event loop, while the windows of the bodies
+// are serialized on an executor. The bodies are sent with scatter/gather I/O from the segments of the files, which
+// borrow the memory of their chunks where possible.
+class HttpRangeServer {
+    // Part of a response body, either literal bytes or a range of a file produced when the socket takes it
+    struct Part {
+        std::shared_ptr<arrow::Buffer> literal;
+        std::optional<RangeStream> stream;
+    };
+
+    struct Connection {
+        int fd;
+        // distinguishes the connections reusing a file descriptor
+        uint64_t id;
+        std::string input;
+        // parts of the queued responses not produced yet
+        std::deque<Part> parts;
+        // produced bytes not sent yet, the first offset bytes of the first buffer are sent
+        std::deque<std::shared_ptr<arrow::Buffer>> output;
+        uint64_t offset = 0;
+        uint64_t outputSize = 0;
+        // the connection is closed once all responses are sent
+        bool closing = false;
+        // the client closed its side of the connection
+        bool eof = false;
+        // the next window of the first part is serialized on the executor
+        bool producing = false;
+        // events the connection is watched for
+        uint32_t events = EPOLLIN;
+    };
+
+    // Window of a stream serialized on the executor for the event loop
+    struct Produced {
+        int fd;
+        uint64_t id;
+        Part part;
+        std::vector<std::shared_ptr<arrow::Buffer>> segments;
+        bool failed = false;
+    };
+
+    struct Request {
+        std::string method;
+        std::string target;
+        bool keepAlive = true;
+        std::optional<std::string> range;
+    };
+
+    static constexpr std::string_view BOUNDARY = "VIRTUALFILE_BYTERANGES";
+    static constexpr int MAX_IOVECS = 64;
+
+    const HttpRangeServerOptions options;
+    std::mutex filesMutex;
+    std::unordered_map<std::string, std::shared_ptr<VirtualFile>> files;
+    int listenFd = -1;
+    int epollFd = -1;
+    // wakes up the event loop to stop it
+    int stopFd = -1;
+    // wakes up the event loop to send produced windows
+    int wakeFd = -1;
+    uint16_t port = 0;
+    std::unordered_map<int, Connection> connections;
+    uint64_t nextConnection = 0;
+    std::thread loop;
+
+    std::mutex producedMutex;
+    std::vector<Produced> produced;
+    // windows submitted to the executor, the finished ones are dropped on the next submission
+    std::vector<arrow::Future<>> windows;
+
+    static void check(const bool ok, const char* what) {
+        if (!ok) throw std::runtime_error{std::string(what) + ": " + strerror(errno)};
+    }
+
+    void watch(const int fd, const uint32_t events, const int op) const {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+        check(epoll_ctl(epollFd, op, fd, &event) == 0, "epoll_ctl");
+    }
+
+    // Waits for the socket to take the pending output, and only reads new requests once all responses are sent,
+    // s.t. clients pipelining requests cannot queue unbounded responses. Without output, a connection whose next
+    // window is serialized waits for the executor
+    void updateEvents(Connection& connection) const {
+        const bool pending = !connection.parts.empty() || connection.producing;
+        const uint32_t events = !connection.output.empty() ? EPOLLOUT
+            : pending || connection.eof ? 0u : static_cast<uint32_t>(EPOLLIN);
+        if (events != connection.events) watch(connection.fd, events, EPOLL_CTL_MOD);
+        connection.events = events;
+    }
+
+    static bool equalsIgnoreCase(const std::string_view a, const std::string_view b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+        });
+    }
+
+    static std::string_view trim(std::string_view value) {
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+        return value;
+    }
+
+    static std::optional<uint64_t> parseNumber(const std::string_view value) {
+        uint64_t result;
+        const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+        if (value.empty() || error != std::errc() || end != value.data() + value.size()) return std::nullopt;
+        return result;
+    }
+
+    // Parses the request line and the headers, returns nullopt if they are malformed
+    static std::optional<Request> parseRequest(const std::string_view header) {
+        Request result;
+        const size_t lineEnd = std::min(header.find("\r\n"), header.size());
+        const std::string_view line = header.substr(0, lineEnd);
+        const size_t methodEnd = line.find(' ');
+        const size_t targetEnd = line.rfind(' ');
+        if (methodEnd == std::string_view::npos || targetEnd == methodEnd) return std::nullopt;
+        result.method = line.substr(0, methodEnd);
+        result.target = line.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+        result.target = result.target.substr(0, result.target.find('?'));
+        const std::string_view version = line.substr(targetEnd + 1);
+        if (version != "HTTP/1.1" && version != "HTTP/1.0") return std::nullopt;
+        result.keepAlive = version == "HTTP/1.1";
+        for (size_t begin = lineEnd + 2; begin < header.size();) {
+            const size_t end = std::min(header.find("\r\n", begin), header.size());
+            const std::string_view field = header.substr(begin, end - begin);
+            begin = end + 2;
+            const size_t colon = field.find(':');
+            if (colon == std::string_view::npos) return std::nullopt;
+            const std::string_view name = field.substr(0, colon);
+            const std::string_view value = trim(field.substr(colon + 1));
+            if (equalsIgnoreCase(name, "Range")) {
+                result.range = value;
+            } else if (equalsIgnoreCase(name, "Connection")) {
+                if (equalsIgnoreCase(value, "close")) result.keepAlive = false;
+                if (equalsIgnoreCase(value, "keep-alive")) result.keepAlive = true;
+            } else if (equalsIgnoreCase(name, "Content-Length") && value != "0") {
+                // requests of ranges have no body
+                return std::nullopt;
+            }
+        }
+        return result;
+    }
+
+    // Ranges of the Range header clipped to the file, unsatisfiable ranges are dropped. Returns nullopt if the header
+    // is malformed or has more than maxRanges ranges, which is ignored like a missing header
+    std::optional<std::vector<ByteRange>> parseRanges(const std::string_view header, const uint64_t size) const {
+        constexpr std::string_view unit = "bytes=";
+        if (header.substr(0, unit.size()) != unit) return std::nullopt;
+        std::vector<ByteRange> result;
+        std::string_view ranges = header.substr(unit.size());
+        for (uint64_t count = 1;; count++) {
+            if (count > options.maxRanges) return std::nullopt;
+            const size_t comma = ranges.find(',');
+            const std::string_view range = trim(ranges.substr(0, comma));
+            const size_t dash = range.find('-');
+            if (dash == std::string_view::npos) return std::nullopt;
+            const auto first = parseNumber(range.substr(0, dash));
+            const auto last = parseNumber(range.substr(dash + 1));
+            if (!first && !last) return std::nullopt;
+            if (!first) {
+                // suffix of the given length
+                if (*last > 0 && size > 0) {
+                    result.push_back({static_cast<int64_t>(size - std::min(*last, size)), static_cast<int64_t>(size) - 1});
+                }
+            } else {
+                if (last && *last < *first) return std::nullopt;
+                if (*first < size) {
+                    result.push_back({static_cast<int64_t>(*first), static_cast<int64_t>(std::min(last.value_or(size - 1), size - 1))});
+                }
+            }
+            if (comma == std::string_view::npos) break;
+            ranges.remove_prefix(comma + 1);
+        }
+        return result;
+    }
+
+    static std::shared_ptr<arrow::Buffer> makeLiteral(std::string value) {
+        return arrow::Buffer::FromString(std::move(value));
+    }
+
+    static std::string getContentRange(const ByteRange range, const uint64_t size) {
+        std::ostringstream result;
+        result << "bytes " << range.begin << "-" << range.end << "/" << size;
+        return result.str();
+    }
+
+    // Queues the response without a body of the status
+    static void respond(Connection& connection, const std::string_view status, const std::string_view headers = "") {
+        std::ostringstream response;
+        response << "HTTP/1.1 " << status << "\r\nContent-Length: 0\r\n" << headers;
+        response << (connection.closing ? "Connection: close\r\n" : "") << "\r\n";
+        connection.parts.push_back({makeLiteral(response.str()), std::nullopt});
+    }
+
+    void respond(Connection& connection, const Request& request) {
+        std::shared_ptr<VirtualFile> file;
+        {
+            std::lock_guard lock(filesMutex);
+            if (const auto it = files.find(request.target); it != files.end()) file = it->second;
+        }
+        if (!file) return respond(connection, "404 Not Found");
+        const bool head = request.method == "HEAD";
+        if (!head && request.method != "GET") return respond(connection, "405 Method Not Allowed", "Allow: GET, HEAD\r\n");
+
+        const uint64_t size = file->predictSizeOfFile();
+        std::optional<std::vector<ByteRange>> ranges;
+        if (request.range && !head) ranges = parseRanges(*request.range, size);
+        if (ranges && ranges->empty()) {
+            return respond(connection, "416 Range Not Satisfiable", "Content-Range: bytes */" + std::to_string(size) + "\r\n");
+        }
+
+        std::ostringstream response;
+        std::vector<Part> body;
+        if (!ranges) {
+            response << "HTTP/1.1 200 OK\r\nContent-Length: " << size << "\r\n";
+            if (size > 0) body.push_back({nullptr, RangeStream(file, {0, static_cast<int64_t>(size) - 1}, options.window)});
+        } else if (ranges->size() == 1) {
+            const ByteRange range = ranges->front();
+            response << "HTTP/1.1 206 Partial Content\r\nContent-Length: " << range.size() << "\r\n";
+            response << "Content-Range: " << getContentRange(range, size) << "\r\n";
+            body.push_back({nullptr, RangeStream(file, range, options.window)});
+        } else {
+            uint64_t length = 0;
+            for (const ByteRange range : *ranges) {
+                std::ostringstream part;
+                part << "\r\n--" << BOUNDARY << "\r\nContent-Type: application/octet-stream\r\n";
+                part << "Content-Range: " << getContentRange(range, size) << "\r\n\r\n";
+                body.push_back({makeLiteral(part.str()), std::nullopt});
+                body.push_back({nullptr, RangeStream(file, range, options.window)});
+                length += body[body.size() - 2].literal->size() + range.size();
+            }
+            std::ostringstream end;
+            end << "\r\n--" << BOUNDARY << "--\r\n";
+            body.push_back({makeLiteral(end.str()), std::nullopt});
+            length += body.back().literal->size();
+            response << "HTTP/1.1 206 Partial Content\r\nContent-Length: " << length << "\r\n";
+            response << "Content-Type: multipart/byteranges; boundary=" << BOUNDARY << "\r\n";
+        }
+        if (!ranges || ranges->size() == 1) response << "Content-Type: application/octet-stream\r\n";
+        response << "Accept-Ranges: bytes\r\n" << (connection.closing ? "Connection: close\r\n" : "") << "\r\n";
+        connection.parts.push_back({makeLiteral(response.str()), std::nullopt});
+        if (!head) connection.parts.insert(connection.parts.end(), body.begin(), body.end());
+    }
+
+    // Queues the responses of all complete requests of the input
+    void handleInput(Connection& connection) {
+        while (!connection.closing) {
+            const size_t end = connection.input.find("\r\n\r\n");
+            if (end == std::string::npos || end > options.maxHeaderSize) {
+                if (connection.input.size() > options.maxHeaderSize) {
+                    connection.closing = true;
+                    respond(connection, "431 Request Header Fields Too Large");
+                }
+                return;
+            }
+            const std::optional<Request> request = parseRequest(std::string_view(connection.input).substr(0, end));
+            connection.input.erase(0, end + 4);
+            if (!request) {
+                connection.closing = true;
+                respond(connection, "400 Bad Request");
+                return;
+            }
+            connection.closing = !request->keepAlive;
+            respond(connection, *request);
+        }
+    }
+
+    // Queues the literal parts until the window is full or the next part is a stream, whose next window is
+    // serialized on the executor
+    void produce(Connection& connection) {
+        while (!connection.producing && connection.outputSize < options.window && !connection.parts.empty()) {
+            Part& part = connection.parts.front();
+            if (part.literal) {
+                connection.outputSize += part.literal->size();
+                connection.output.push_back(std::move(part.literal));
+                connection.parts.pop_front();
+                continue;
+            }
+            submit({connection.fd, connection.id, std::move(part), {}});
+            connection.parts.pop_front();
+            connection.producing = true;
+        }
+    }
+
+    void submit(Produced window) {
+        std::erase_if(windows, [](const arrow::Future<>& future) { return future.is_finished(); });
+        arrow::internal::Executor* executor = options.executor ? options.executor.get() : arrow::internal::GetCpuThreadPool();
+        auto future = executor->Submit([this, window = std::move(window)]() mutable {
+            try {
+                window.segments = window.part.stream->nextSegments();
+            } catch (const std::exception&) {
+                window.failed = true;
+            }
+            std::lock_guard lock(producedMutex);
+            produced.push_back(std::move(window));
+            const uint64_t one = 1;
+            [[maybe_unused]] const ssize_t written = write(wakeFd, &one, sizeof(one));
+        });
+        if (!future.ok()) throw std::runtime_error{future.status().ToString()};
+        windows.push_back(std::move(*future));
+    }
+
+    // Queues the windows serialized since the last wake up and sends them
+    void takeProduced() {
+        uint64_t count;
+        [[maybe_unused]] const ssize_t received = read(wakeFd, &count, sizeof(count));
+        std::vector<Produced> finished;
+        {
+            std::lock_guard lock(producedMutex);
+            finished.swap(produced);
+        }
+        for (Produced& window : finished) {
+            const auto it = connections.find(window.fd);
+            if (it == connections.end() || it->second.id != window.id) continue;
+            Connection& connection = it->second;
+            connection.producing = false;
+            bool open = !window.failed;
+            if (open) {
+                for (auto& segment : window.segments) {
+                    connection.outputSize += segment->size();
+                    connection.output.push_back(std::move(segment));
+                }
+                if (!window.part.stream->done()) connection.parts.push_front(std::move(window.part));
+                try {
+                    open = flush(connection);
+                } catch (const std::exception&) {
+                    open = false;
+                }
+            }
+            // a response cannot be completed once its header is sent
+            if (!open) closeConnection(window.fd);
+        }
+    }
+
+    // Sends as much of the responses as the socket takes, returns false if the connection is to be closed
+    bool flush(Connection& connection) {
+        while (true) {
+            produce(connection);
+            if (connection.output.empty()) break;
+            iovec iov[MAX_IOVECS];
+            int count = 0;
+            for (auto it = connection.output.begin(); it != connection.output.end() && count != MAX_IOVECS; ++it) {
+                const uint64_t skip = count == 0 ? connection.offset : 0;
+                iov[count++] = {const_cast<uint8_t*>((*it)->data()) + skip, static_cast<size_t>((*it)->size() - skip)};
+            }
+            msghdr message{};
+            message.msg_iov = iov;
+            message.msg_iovlen = count;
+            const ssize_t written = sendmsg(connection.fd, &message, MSG_NOSIGNAL);
+            if (written < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    updateEvents(connection);
+                    return true;
+                }
+                if (errno == EINTR) continue;
+                return false;
+            }
+            connection.outputSize -= written;
+            uint64_t remaining = written;
+            while (remaining > 0) {
+                const uint64_t left = connection.output.front()->size() - connection.offset;
+                if (remaining < left) {
+                    connection.offset += remaining;
+                    break;
+                }
+                remaining -= left;
+                connection.offset = 0;
+                connection.output.pop_front();
+            }
+        }
+        updateEvents(connection);
+        return !connection.closing || connection.producing;
+    }
+
+    // Reads the available input until more than a header is buffered, returns false if the client closed the connection
+    bool receive(Connection& connection) const {
+        char buffer[16 << 10];
+        while (connection.input.size() <= options.maxHeaderSize) {
+            const ssize_t received = read(connection.fd, buffer, sizeof(buffer));
+            if (received > 0) {
+                connection.input.append(buffer, received);
+                continue;
+            }
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            if (received < 0 && errno == EINTR) continue;
+            return false;
+        }
+        return true;
+    }
+
+    void acceptConnections() {
+        while (true) {
+            const int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            const int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            Connection connection;
+            connection.fd = fd;
+            connection.id = nextConnection++;
+            try {
+                connections.emplace(fd, std::move(connection));
+                watch(fd, EPOLLIN, EPOLL_CTL_ADD);
+            } catch (const std::exception&) {
+                // e.g. epoll_ctl fails with ENOMEM or ENOSPC, the other connections are still served
+                connections.erase(fd);
+                ::close(fd);
+            }
+        }
+    }
+
+    void closeConnection(const int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(fd);
+    }
+
+    // Wakes up the event loop to return and joins it, returns false with errno set if the stopFd cannot be written or
+    // drained. The stopFd is drained s.t. the server may be started again
+    bool stopLoop() {
+        const uint64_t one = 1;
+        ssize_t written;
+        do {
+            written = write(stopFd, &one, sizeof(one));
+        } while (written < 0 && errno == EINTR);
+        if (written != static_cast<ssize_t>(sizeof(one))) return false;
+        loop.join();
+        uint64_t count;
+        return read(stopFd, &count, sizeof(count)) == static_cast<ssize_t>(sizeof(count));
+    }
+
+    void run() {
+        epoll_event events[64];
+        while (true) {
+            const int count = epoll_wait(epollFd, events, 64, -1);
+            for (int e = 0; e < count; e++) {
+                const int fd = events[e].data.fd;
+                if (fd == stopFd) return;
+                if (fd == listenFd) {
+                    acceptConnections();
+                    continue;
+                }
+                if (fd == wakeFd) {
+                    takeProduced();
+                    continue;
+                }
+                // the connection may have been closed by an earlier event of the same batch
+                const auto it = connections.find(fd);
+                if (it == connections.end()) continue;
+                Connection& connection = it->second;
+                bool open = true;
+                try {
+                    if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR) && !connection.eof) {
+                        connection.eof = !receive(connection);
+                        handleInput(connection);
+                        // the responses of the received requests are still sent
+                        if (connection.eof) connection.closing = true;
+                    }
+                    // a hung up connection cannot take the window being serialized
+                    open = flush(connection) && !(connection.producing && events[e].events & (EPOLLHUP | EPOLLERR));
+                } catch (const std::exception&) {
+                    // a response cannot be completed once its header is sent
+                    open = false;
+                }
+                if (!open) closeConnection(fd);
+            }
+        }
+    }
+
+public:
+    explicit HttpRangeServer(HttpRangeServerOptions options = {}) : options(std::move(options)) {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(this->options.port);
+        if (inet_pton(AF_INET, this->options.host.c_str(), &address.sin_addr) != 1) {
+            throw std::invalid_argument{"invalid address " + this->options.host};
+        }
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        check(listenFd >= 0, "socket");
+        const int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        check(bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0, "bind");
+        check(listen(listenFd, SOMAXCONN) == 0, "listen");
+        socklen_t length = sizeof(address);
+        check(getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length) == 0, "getsockname");
+        port = ntohs(address.sin_port);
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        check(epollFd >= 0, "epoll_create1");
+        stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        check(stopFd >= 0, "eventfd");
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        check(wakeFd >= 0, "eventfd");
+        watch(listenFd, EPOLLIN, EPOLL_CTL_ADD);
+        watch(stopFd, EPOLLIN, EPOLL_CTL_ADD);
+        watch(wakeFd, EPOLLIN, EPOLL_CTL_ADD);
+    }
+
+    HttpRangeServer(const HttpRangeServer&) = delete;
+    HttpRangeServer& operator=(const HttpRangeServer&) = delete;
+
+    ~HttpRangeServer() {
+        // errors are ignored, the eventfd of a running loop can always be written
+        if (loop.joinable()) stopLoop();
+        // the windows being serialized still wake up the event loop
+        for (const auto& window : windows) window.Wait();
+        for (const auto& [fd, connection] : connections) ::close(fd);
+        for (const int fd : {listenFd, epollFd, stopFd, wakeFd}) ::close(fd);
+    }
+
+    uint16_t getPort() const { return port; }
+
+    // Serves the file at the path, e.g. "/lineitem.parquet". Files may be added while the server runs
+    void addFile(const std::string& path, std::shared_ptr<VirtualFile> file) {
+        std::lock_guard lock(filesMutex);
+        files[path] = std::move(file);
+    }
+
+    void removeFile(const std::string& path) {
+        std::lock_guard lock(filesMutex);
+        files.erase(path);
+    }
+
+    // Runs the event loop on a background thread until stop is called
+    void start() {
+        if (!loop.joinable()) loop = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        if (!loop.joinable()) return;
+        check(stopLoop(), "stop");
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
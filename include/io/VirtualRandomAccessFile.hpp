@@ -0,0 +1,233 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+// -------------------------------------------------------------------------------------
+#include <arrow/api.h>
+#include <arrow/io/interfaces.h>
+#include <arrow/util/future.h>
+#include <arrow/util/thread_pool.h>
+// -------------------------------------------------------------------------------------
+#include "../VirtualFile.hpp"
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+struct VirtualRandomAccessFileOptions {
+    // executor of the asynchronous reads and prefetches
+    arrow::io::IOContext ioContext = arrow::io::default_io_context();
+    // Total size of the ranges prefetched by WillNeed that have not been read yet, older ranges are dropped first
+    uint64_t prefetchCapacity = 256 << 20;
+};
+
+// Reads a virtual file in-process through the arrow::io interface, e.g. with parquet::arrow::FileReader or the
+// Arrow IPC reader, without copying it into a buffer first. Reads of a range lying within a single segment of the
+// virtual file return the segment's memory, i.e. the reader's arrays or the serialized chunk, other reads
+// concatenate the segments. Errors of the virtual file are returned as IOError.
+class VirtualRandomAccessFile final : public arrow::io::RandomAccessFile {
+    struct Prefetch {
+        ByteRange range;
+        arrow::Future<std::shared_ptr<arrow::Buffer>> data;
+    };
+
+    const std::shared_ptr<VirtualFile> file;
+    const VirtualRandomAccessFileOptions options;
+    const int64_t size;
+    int64_t position = 0;
+    std::atomic<bool> isClosed = false;
+
+    // prefetched ranges in the order of WillNeed
+    std::deque<Prefetch> prefetches;
+    uint64_t prefetchedSize = 0;
+    // the latest ranges read by ReadAsync that no WillNeed skipped yet
+    static constexpr size_t MAX_ASYNC_READS = 1024;
+    std::deque<ByteRange> asyncReads;
+    std::mutex prefetchMutex;
+
+    arrow::Status checkClosed() const {
+        return isClosed ? arrow::Status::Invalid("Operation on closed virtual file") : arrow::Status::OK();
+    }
+
+    // Clamps the read to the end of the file
+    arrow::Result<ByteRange> getReadRange(const int64_t offset, const int64_t nbytes, const bool allowShortRead) const {
+        ARROW_RETURN_NOT_OK(checkClosed());
+        if (offset < 0 || nbytes < 0) {
+            return arrow::Status::Invalid("Invalid read (offset = ", offset, ", size = ", nbytes, ")");
+        }
+        const int64_t end = std::min(offset + nbytes, std::max(size, offset));
+        if (end - offset < nbytes && !allowShortRead) {
+            return arrow::Status::IOError("Read of ", nbytes, " bytes at offset ", offset, " past the end of the virtual file of size ", size);
+        }
+        return ByteRange{offset, end - 1};
+    }
+
+    arrow::Result<std::shared_ptr<arrow::Buffer>> readSegments(const ByteRange range) const {
+        if (range.end < range.begin) return std::make_shared<arrow::Buffer>(nullptr, 0);
+        try {
+            auto segments = file->getRangeSegments(range);
+            if (segments.size() == 1) return std::move(segments[0]);
+            return arrow::ConcatenateBuffers(segments, options.ioContext.pool());
+        } catch (const std::exception& e) {
+            return arrow::Status::IOError(e.what());
+        }
+    }
+
+    // Returns the prefetched data containing the range, the prefetch is dropped once its end is read
+    std::optional<arrow::Future<std::shared_ptr<arrow::Buffer>>> takePrefetched(const ByteRange range) {
+        std::lock_guard lock(prefetchMutex);
+        for (auto it = prefetches.begin(); it != prefetches.end(); ++it) {
+            if (it->range.begin > range.begin || it->range.end < range.end) continue;
+            const int64_t offset = range.begin - it->range.begin;
+            const int64_t length = range.end - range.begin + 1;
+            auto result = it->data.Then([offset, length](const std::shared_ptr<arrow::Buffer>& buffer) {
+                return arrow::SliceBuffer(buffer, offset, length);
+            });
+            if (it->range.end == range.end) {
+                prefetchedSize -= it->range.size();
+                prefetches.erase(it);
+            }
+            return result;
+        }
+        return std::nullopt;
+    }
+
+    // Whether a prefetch or an asynchronous read contains the range, a matching asynchronous read is dropped
+    bool isPrefetched(const ByteRange range) {
+        const auto contains = [&](const ByteRange other) { return other.begin <= range.begin && other.end >= range.end; };
+        std::lock_guard lock(prefetchMutex);
+        if (std::ranges::any_of(prefetches, [&](const Prefetch& prefetch) { return contains(prefetch.range); })) {
+            return true;
+        }
+        const auto read = std::ranges::find_if(asyncReads, contains);
+        if (read == asyncReads.end()) return false;
+        asyncReads.erase(read);
+        return true;
+    }
+
+    void addPrefetch(const ByteRange range, arrow::Future<std::shared_ptr<arrow::Buffer>> data) {
+        std::lock_guard lock(prefetchMutex);
+        prefetches.push_back({range, std::move(data)});
+        prefetchedSize += range.size();
+        while (prefetchedSize > options.prefetchCapacity) {
+            prefetchedSize -= prefetches.front().range.size();
+            prefetches.pop_front();
+        }
+    }
+
+    arrow::Result<std::shared_ptr<arrow::Buffer>> read(const ByteRange range) {
+        if (range.end >= range.begin) {
+            if (auto prefetched = takePrefetched(range)) return prefetched->result();
+        }
+        return readSegments(range);
+    }
+
+public:
+    explicit VirtualRandomAccessFile(std::shared_ptr<VirtualFile> file, VirtualRandomAccessFileOptions options = {})
+        : file(std::move(file)), options(std::move(options)), size(this->file->predictSizeOfFile()) {}
+
+    arrow::Status Close() override {
+        isClosed = true;
+        std::lock_guard lock(prefetchMutex);
+        prefetches.clear();
+        prefetchedSize = 0;
+        asyncReads.clear();
+        return arrow::Status::OK();
+    }
+    bool closed() const override { return isClosed; }
+    const arrow::io::IOContext& io_context() const override { return options.ioContext; }
+    bool supports_zero_copy() const override { return true; }
+
+    arrow::Result<int64_t> GetSize() override {
+        ARROW_RETURN_NOT_OK(checkClosed());
+        return size;
+    }
+    arrow::Result<int64_t> Tell() const override {
+        ARROW_RETURN_NOT_OK(checkClosed());
+        return position;
+    }
+    arrow::Status Seek(const int64_t offset) override {
+        ARROW_RETURN_NOT_OK(checkClosed());
+        if (offset < 0) return arrow::Status::Invalid("Negative seek position ", offset);
+        position = offset;
+        return arrow::Status::OK();
+    }
+
+    arrow::Result<int64_t> Read(const int64_t nbytes, void* out) override {
+        ARROW_ASSIGN_OR_RAISE(const int64_t result, ReadAt(position, nbytes, true, out));
+        position += result;
+        return result;
+    }
+    arrow::Result<std::shared_ptr<arrow::Buffer>> Read(const int64_t nbytes) override {
+        ARROW_ASSIGN_OR_RAISE(auto result, ReadAt(position, nbytes, true));
+        position += result->size();
+        return result;
+    }
+
+    using arrow::io::RandomAccessFile::ReadAt;
+    using arrow::io::RandomAccessFile::ReadAsync;
+
+    arrow::Result<int64_t> ReadAt(const int64_t offset, const int64_t nbytes, const bool allowShortRead, void* out) override {
+        ARROW_ASSIGN_OR_RAISE(const ByteRange range, getReadRange(offset, nbytes, allowShortRead));
+        if (range.end < range.begin) return 0;
+        try {
+            file->getRange(range, std::span<char>(static_cast<char*>(out), range.size()));
+        } catch (const std::exception& e) {
+            return arrow::Status::IOError(e.what());
+        }
+        return static_cast<int64_t>(range.size());
+    }
+    arrow::Result<int64_t> ReadAt(const int64_t offset, const int64_t nbytes, void* out) override {
+        return ReadAt(offset, nbytes, true, out);
+    }
+    arrow::Result<std::shared_ptr<arrow::Buffer>> ReadAt(const int64_t offset, const int64_t nbytes, const bool allowShortRead) override {
+        ARROW_ASSIGN_OR_RAISE(const ByteRange range, getReadRange(offset, nbytes, allowShortRead));
+        return read(range);
+    }
+    arrow::Result<std::shared_ptr<arrow::Buffer>> ReadAt(const int64_t offset, const int64_t nbytes) override {
+        return ReadAt(offset, nbytes, true);
+    }
+
+    // Serializes the range on the executor of the given context unless it was prefetched. The range is recorded,
+    // s.t. a WillNeed of it, e.g. by an eager arrow::io::internal::ReadRangeCache, does not serialize it again
+    arrow::Future<std::shared_ptr<arrow::Buffer>> ReadAsync(const arrow::io::IOContext& context, const int64_t offset,
+                                                            const int64_t nbytes, const bool allowShortRead) override {
+        ARROW_ASSIGN_OR_RAISE(const ByteRange range, getReadRange(offset, nbytes, allowShortRead));
+        if (range.end >= range.begin) {
+            if (auto prefetched = takePrefetched(range)) return std::move(*prefetched);
+        }
+        auto self = std::dynamic_pointer_cast<VirtualRandomAccessFile>(shared_from_this());
+        if (range.end >= range.begin) {
+            std::lock_guard lock(prefetchMutex);
+            asyncReads.push_back(range);
+            if (asyncReads.size() > MAX_ASYNC_READS) asyncReads.pop_front();
+        }
+        return arrow::DeferNotOk(context.executor()->Submit([self, range] { return self->readSegments(range); }));
+    }
+    arrow::Future<std::shared_ptr<arrow::Buffer>> ReadAsync(const arrow::io::IOContext& context, const int64_t offset,
+                                                            const int64_t nbytes) override {
+        return ReadAsync(context, offset, nbytes, true);
+    }
+
+    // Starts serializing the ranges on the executor of the options, later reads within them use the prefetched data
+    // Ranges within a prefetch or a recent asynchronous read, whose caller holds its data, are skipped
+    arrow::Status WillNeed(const std::vector<arrow::io::ReadRange>& ranges) override {
+        ARROW_RETURN_NOT_OK(checkClosed());
+        auto self = std::dynamic_pointer_cast<VirtualRandomAccessFile>(shared_from_this());
+        for (const auto& readRange : ranges) {
+            ARROW_ASSIGN_OR_RAISE(const ByteRange range, getReadRange(readRange.offset, readRange.length, true));
+            if (range.end < range.begin || range.size() > options.prefetchCapacity || isPrefetched(range)) continue;
+            ARROW_ASSIGN_OR_RAISE(auto data, options.ioContext.executor()->Submit([self, range] { return self->readSegments(range); }));
+            addPrefetch(range, std::move(data));
+        }
+        return arrow::Status::OK();
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
@@ -0,0 +1,181 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+// -------------------------------------------------------------------------------------
+#include <arrow/api.h>
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+// Writes the flatbuffers of the Arrow IPC metadata, i.e. the messages of record batches and the file footer.
+// Every field is written even if it has its default value, s.t. the size of a message only depends on the
+// number of its fields and buffers. Unlike the flatbuffers builder, objects are written front to back,
+// children follow their parents since offsets to children only point forward.
+class IPCUtils {
+public:
+    static constexpr uint64_t ALIGNMENT = 8;
+    static constexpr uint32_t CONTINUATION = 0xFFFFFFFF;
+    static constexpr int16_t METADATA_V5 = 4;
+    static constexpr uint8_t RECORD_BATCH_HEADER = 3;
+
+    struct FieldNode {
+        int64_t length;
+        int64_t null_count;
+    };
+    struct BufferLocation {
+        int64_t offset;
+        int64_t length;
+    };
+    // Location of a message within the file
+    struct Block {
+        int64_t offset;
+        int32_t metaDataLength;
+        int32_t padding = 0;
+        int64_t bodyLength;
+    };
+
+    static uint64_t getPaddedSize(const uint64_t size) { return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; }
+
+private:
+    std::vector<uint8_t> data;
+
+    struct Field {
+        uint16_t id;
+        uint8_t size;
+        // value of scalars, offsets are set once their target is written
+        uint64_t value = 0;
+    };
+
+    void pad(const uint64_t alignment) { data.resize((data.size() + alignment - 1) / alignment * alignment); }
+
+    template <typename T>
+    void set(const uint64_t position, const T value) { memcpy(data.data() + position, &value, sizeof(T)); }
+
+    template <typename T>
+    T get(const uint64_t position) const {
+        T result;
+        memcpy(&result, data.data() + position, sizeof(T));
+        return result;
+    }
+
+    struct Table {
+        uint64_t position;
+        // positions of the fields in the order given
+        std::vector<uint64_t> fields;
+    };
+
+    // Writes the vtable followed by the table
+    Table writeTable(const std::vector<Field>& fields) {
+        std::vector<size_t> order(fields.size());
+        for (size_t f = 0; f != fields.size(); f++) order[f] = f;
+        // the widest fields first, s.t. all fields are aligned if the first one is
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return fields[a].size > fields[b].size; });
+        uint16_t numSlots = 0;
+        uint16_t tableSize = sizeof(int32_t);
+        std::vector<uint16_t> fieldOffsets(fields.size());
+        for (const size_t f : order) {
+            numSlots = std::max<uint16_t>(numSlots, fields[f].id + 1);
+            fieldOffsets[f] = tableSize;
+            tableSize += fields[f].size;
+        }
+        const uint64_t maxAlignment = fields.empty() ? sizeof(int32_t) : std::max<uint64_t>(fields[order[0]].size, 4);
+        // the vtable directly precedes the table, whose first field follows its offset to the vtable
+        const uint64_t vtableSize = sizeof(uint16_t) * (2 + numSlots);
+        pad(2);
+        while ((data.size() + vtableSize + sizeof(int32_t)) % maxAlignment != 0) data.push_back(0);
+        const uint64_t vtable = data.size();
+        data.resize(vtable + vtableSize);
+        set<uint16_t>(vtable, vtableSize);
+        set<uint16_t>(vtable + 2, tableSize);
+        for (size_t f = 0; f != fields.size(); f++) {
+            set<uint16_t>(vtable + 4 + 2 * fields[f].id, fieldOffsets[f]);
+        }
+        const uint64_t table = data.size();
+        data.resize(table + tableSize);
+        set<int32_t>(table, static_cast<int32_t>(table - vtable));
+        Table result{table, std::vector<uint64_t>(fields.size())};
+        for (size_t f = 0; f != fields.size(); f++) {
+            result.fields[f] = table + fieldOffsets[f];
+            memcpy(data.data() + result.fields[f], &fields[f].value, fields[f].size);
+        }
+        return result;
+    }
+
+    // Points the offset field to the target, which follows it
+    void setOffset(const uint64_t field, const uint64_t target) {
+        set<uint32_t>(field, static_cast<uint32_t>(target - field));
+    }
+
+    // Writes a vector of structs aligned to 8 bytes and returns its position
+    template <typename T>
+    uint64_t writeStructVector(std::span<const T> values) {
+        while ((data.size() + sizeof(uint32_t)) % ALIGNMENT != 0) data.push_back(0);
+        const uint64_t result = data.size();
+        const uint32_t length = values.size();
+        data.resize(result + sizeof(uint32_t) + values.size_bytes());
+        set(result, length);
+        if (!values.empty()) memcpy(data.data() + result + sizeof(uint32_t), values.data(), values.size_bytes());
+        return result;
+    }
+
+    // Encapsulates the flatbuffer as message, i.e. prefixes it by the continuation marker and its padded size
+    std::shared_ptr<arrow::Buffer> finishMessage() {
+        const uint64_t size = getPaddedSize(data.size());
+        std::vector<uint8_t> result(2 * sizeof(uint32_t) + size, 0);
+        const int32_t length = static_cast<int32_t>(size);
+        memcpy(result.data(), &CONTINUATION, sizeof(uint32_t));
+        memcpy(result.data() + sizeof(uint32_t), &length, sizeof(int32_t));
+        memcpy(result.data() + 2 * sizeof(uint32_t), data.data(), data.size());
+        return arrow::Buffer::FromVector(std::move(result));
+    }
+
+    IPCUtils() { data.resize(sizeof(uint32_t)); }
+
+public:
+    // Record batch message including its prefix, which is followed by a body of the given length
+    static std::shared_ptr<arrow::Buffer> writeRecordBatchMessage(const int64_t length,
+                                                                  std::span<const FieldNode> nodes,
+                                                                  std::span<const BufferLocation> buffers,
+                                                                  const int64_t bodyLength) {
+        IPCUtils writer;
+        const auto message = writer.writeTable({{0, 2, static_cast<uint64_t>(METADATA_V5)},
+            {1, 1, RECORD_BATCH_HEADER}, {2, 4}, {3, 8, static_cast<uint64_t>(bodyLength)}});
+        writer.setOffset(0, message.position);
+        const auto batch = writer.writeTable({{0, 8, static_cast<uint64_t>(length)}, {1, 4}, {2, 4}});
+        writer.setOffset(message.fields[2], batch.position);
+        writer.setOffset(batch.fields[1], writer.writeStructVector(nodes));
+        writer.setOffset(batch.fields[2], writer.writeStructVector(buffers));
+        return writer.finishMessage();
+    }
+
+    // Footer flatbuffer of the file, the schema is the table of the serialized schema message
+    static std::shared_ptr<arrow::Buffer> writeFooter(const arrow::Buffer& schemaMessage, std::span<const Block> recordBatches) {
+        IPCUtils writer;
+        const auto footer = writer.writeTable({{0, 2, static_cast<uint64_t>(METADATA_V5)}, {1, 4}, {2, 4}, {3, 4}});
+        writer.setOffset(0, footer.position);
+        writer.setOffset(footer.fields[2], writer.writeStructVector(std::span<const Block>()));
+        writer.setOffset(footer.fields[3], writer.writeStructVector(recordBatches));
+        // the offsets within the copied flatbuffer are relative and stay valid if it stays aligned
+        writer.pad(ALIGNMENT);
+        const uint64_t copy = writer.data.size();
+        const uint64_t prefix = 2 * sizeof(uint32_t);
+        writer.data.insert(writer.data.end(), schemaMessage.data() + prefix, schemaMessage.data() + schemaMessage.size());
+        const uint64_t message = copy + writer.get<uint32_t>(copy);
+        const uint64_t vtable = message - writer.get<int32_t>(message);
+        // the header of the message is its field 2
+        if (writer.get<uint16_t>(vtable) <= 4 + 2 * 2 || writer.get<uint16_t>(vtable + 4 + 2 * 2) == 0) {
+            throw std::logic_error{"schema message without a header"};
+        }
+        const uint64_t header = message + writer.get<uint16_t>(vtable + 4 + 2 * 2);
+        writer.setOffset(footer.fields[1], header + writer.get<uint32_t>(header));
+        return arrow::Buffer::FromVector(std::move(writer.data));
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
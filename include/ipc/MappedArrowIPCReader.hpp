@@ -0,0 +1,65 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+// -------------------------------------------------------------------------------------
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/reader.h>
+// -------------------------------------------------------------------------------------
+#include "../ArrowReader.hpp"
+#include "../ChunkInfoUtils.hpp"
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+// Reader of an Arrow IPC file (Feather V2), whose record batches are the rowgroups. The file is memory-mapped and
+// the arrays are zero-copy slices of the mapping unless the record batches are compressed, s.t. serving the file
+// neither copies it into memory first nor keeps more of it resident than the page cache. The metadata of all
+// record batches is read once on construction, readChunk only returns their columns.
+class MappedArrowIPCReader final : public ArrowReader {
+    std::shared_ptr<arrow::io::MemoryMappedFile> file;
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+
+    template <typename T>
+    static T valueOrThrow(arrow::Result<T> result) {
+        if (!result.ok()) throw std::runtime_error{result.status().ToString()};
+        return std::move(*result);
+    }
+
+    MappedArrowIPCReader(std::shared_ptr<arrow::io::MemoryMappedFile> file,
+                         const std::shared_ptr<arrow::ipc::RecordBatchFileReader>& reader) :
+            ArrowReader(reader->schema()), file(std::move(file)) {
+        batches.reserve(reader->num_record_batches());
+        for (int i = 0; i != reader->num_record_batches(); i++) {
+            batches.push_back(valueOrThrow(reader->ReadRecordBatch(i)));
+        }
+    }
+
+    MappedArrowIPCReader(std::shared_ptr<arrow::io::MemoryMappedFile> file) :
+            MappedArrowIPCReader(file, valueOrThrow(arrow::ipc::RecordBatchFileReader::Open(file))) {}
+
+public:
+    explicit MappedArrowIPCReader(const std::string& path) :
+            MappedArrowIPCReader(valueOrThrow(arrow::io::MemoryMappedFile::Open(path, arrow::io::FileMode::READ))) {}
+
+    uint64_t getNumRowgroups() const { return batches.size(); }
+
+    std::shared_ptr<arrow::Array> readChunk(const uint64_t rowgroup, const uint64_t column) override {
+        return batches[rowgroup]->column(column);
+    }
+
+    arrow::Future<std::shared_ptr<arrow::Array>> readChunkAsync(
+            const uint64_t rowgroup, const uint64_t column, arrow::internal::Executor*) override {
+        return arrow::Future<std::shared_ptr<arrow::Array>>::MakeFinished(readChunk(rowgroup, column));
+    }
+
+    // Chunk infos of all record batches, the chunks are inspected in parallel on the executor if one is given
+    std::vector<std::vector<ChunkInfo>> computeChunkInfos(arrow::internal::Executor* executor = nullptr) {
+        return ChunkInfoUtils::computeChunkInfos(*this, getNumRowgroups(), executor);
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
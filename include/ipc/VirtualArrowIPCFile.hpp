@@ -0,0 +1,297 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+// -------------------------------------------------------------------------------------
+#include <arrow/ipc/writer.h>
+#include <arrow/util/bitmap_ops.h>
+// -------------------------------------------------------------------------------------
+#include "../VirtualFile.hpp"
+#include "IPCUtils.hpp"
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+// Arrow IPC file (Feather V2) with one record batch per rowgroup. The body of a record batch is the concatenation
+// of the buffers of its column chunks, which are the buffers of the arrays returned by the reader, s.t. chunks
+// are served without encoding their values and mostly borrow them. Only columns of fixed width values, booleans,
+// binaries and strings are supported, neither dictionaries nor nested types.
+class VirtualArrowIPCFile final : public VirtualFile {
+    static constexpr char MAGIC[] = "ARROW1\0";
+    static constexpr uint64_t MAGIC_SIZE = 6;
+
+    // magic number followed by the schema message
+    std::shared_ptr<arrow::Buffer> header;
+    // Begin offsets of all column chunks in file order (rowgroup-major) followed by the offset of the
+    // footer, s.t. the chunk (i, j) spans [chunkOffsets[i * numColumns + j], chunkOffsets[i * numColumns + j + 1])
+    std::vector<uint64_t> chunkOffsets;
+    // record batch message preceding the chunks of every rowgroup and its offset
+    std::vector<std::shared_ptr<arrow::Buffer>> messages;
+    std::vector<uint64_t> messageOffsets;
+    uint64_t messageSize;
+    // end of stream marker followed by the footer, its length and the magic number
+    std::shared_ptr<arrow::Buffer> footer;
+    // locations of the record batches in the footer
+    std::vector<IPCUtils::Block> blocks;
+    // field nodes and buffers of the record batch registered so far
+    std::vector<IPCUtils::FieldNode> nodes;
+    std::vector<IPCUtils::BufferLocation> buffers;
+    uint64_t fileOffset = 0;
+
+    // Padding of buffers, which is never copied
+    static std::shared_ptr<arrow::Buffer> getPadding(const uint64_t size) {
+        static constexpr uint8_t zeros[IPCUtils::ALIGNMENT] = {};
+        static const auto padding = std::make_shared<arrow::Buffer>(zeros, IPCUtils::ALIGNMENT);
+        return arrow::SliceBuffer(padding, 0, size);
+    }
+
+    template <typename T>
+    static T valueOrThrow(arrow::Result<T> result) {
+        if (!result.ok()) throw std::runtime_error{result.status().ToString()};
+        return std::move(*result);
+    }
+
+    // size of the offsets of binaries and strings, 0 for fixed width values
+    static uint64_t getOffsetWidth(const arrow::DataType& type) {
+        if (arrow::is_binary_like(type.id())) return sizeof(int32_t);
+        if (arrow::is_large_binary_like(type.id())) return sizeof(int64_t);
+        return 0;
+    }
+
+    static void checkType(const arrow::DataType& type) {
+        const bool fixedWidth = type.id() == arrow::Type::BOOL
+            || (arrow::is_fixed_width(type.id()) && !arrow::is_dictionary(type.id()) && type.byte_width() > 0);
+        if (!fixedWidth && getOffsetWidth(type) == 0) {
+            throw std::logic_error{"unsupported type for Arrow IPC files " + type.ToString()};
+        }
+    }
+
+    // Lengths of the buffers of the chunk without padding, i.e. the validity bitmap followed by the values of
+    // fixed width types or by the offsets and the data of binaries and strings. Arrays without nulls have no bitmap
+    std::vector<uint64_t> getBufferLengths(const size_t column, const ChunkInfo& info) const {
+        const arrow::DataType& type = *schema->field(column)->type();
+        const uint64_t rows = info.tuple_count;
+        std::vector<uint64_t> result{info.null_count ? (rows + 7) / 8 : 0};
+        if (const uint64_t offsetWidth = getOffsetWidth(type)) {
+            // the values of the chunk info are prefixed by their 4 byte lengths, nulls have no values
+            result.push_back((rows + 1) * offsetWidth);
+            result.push_back(info.uncompressed_size - sizeof(int32_t) * (rows - info.null_count));
+        } else if (type.id() == arrow::Type::BOOL) {
+            result.push_back((rows + 7) / 8);
+        } else {
+            result.push_back(rows * type.byte_width());
+        }
+        return result;
+    }
+
+    // The footer locates the record batches, whose messages are registered with the chunks
+    uint64_t predictMetadataOverhead() override {
+        std::vector<uint8_t> result(2 * sizeof(uint32_t), 0);
+        // the stream ends with a message of length 0
+        memcpy(result.data(), &IPCUtils::CONTINUATION, sizeof(uint32_t));
+        const auto footerBuffer = IPCUtils::writeFooter(*arrow::SliceBuffer(header, IPCUtils::ALIGNMENT), blocks);
+        result.insert(result.end(), footerBuffer->data(), footerBuffer->data() + footerBuffer->size());
+        const int32_t footerSize = static_cast<int32_t>(footerBuffer->size());
+        const uint8_t* footerSizeBytes = reinterpret_cast<const uint8_t*>(&footerSize);
+        result.insert(result.end(), footerSizeBytes, footerSizeBytes + sizeof(int32_t));
+        result.insert(result.end(), MAGIC, MAGIC + MAGIC_SIZE);
+        footer = arrow::Buffer::FromVector(std::move(result));
+        return header->size() + numRowgroups * messageSize + footer->size();
+    }
+
+    ChunkInfo predictChunkInfo(const size_t column, const ChunkInfo& info) const override {
+        ChunkInfo predicted = info;
+        predicted.uncompressed_size = 0;
+        for (const uint64_t length : getBufferLengths(column, info)) {
+            predicted.uncompressed_size += IPCUtils::getPaddedSize(length);
+        }
+        return predicted;
+    }
+
+    void registerPrecomputedSize(const size_t rowgroup, const size_t column, const ChunkInfo predictedInfo) override {
+        if (column == 0) {
+            messageOffsets.push_back(fileOffset);
+            fileOffset += messageSize;
+        } else if (predictedInfo.tuple_count != static_cast<uint64_t>(nodes.back().length)) {
+            throw std::logic_error{"all chunks of a rowgroup have to have the same number of tuples"};
+        }
+        chunkOffsets.push_back(fileOffset);
+        nodes.push_back({static_cast<int64_t>(predictedInfo.tuple_count), static_cast<int64_t>(predictedInfo.null_count)});
+        uint64_t offset = fileOffset - (messageOffsets.back() + messageSize);
+        for (const uint64_t length : getBufferLengths(column, chunkInfos[column][rowgroup])) {
+            buffers.push_back({static_cast<int64_t>(offset), static_cast<int64_t>(length)});
+            offset += IPCUtils::getPaddedSize(length);
+        }
+        fileOffset += predictedInfo.uncompressed_size;
+        if (column == numColumns - 1) {
+            const int64_t bodyLength = fileOffset - (messageOffsets.back() + messageSize);
+            messages.push_back(IPCUtils::writeRecordBatchMessage(predictedInfo.tuple_count, nodes, buffers, bodyLength));
+            blocks.push_back({.offset = static_cast<int64_t>(messageOffsets.back()),
+                .metaDataLength = static_cast<int32_t>(messageSize), .bodyLength = bodyLength});
+            nodes.clear();
+            buffers.clear();
+        }
+        if (rowgroup == numRowgroups - 1 && column == numColumns - 1) {
+            chunkOffsets.push_back(fileOffset);
+        }
+    }
+
+    // The sizes were predicted from the chunk info, the chunk has to match it
+    void checkChunk(const ChunkInfo& info, const std::shared_ptr<arrow::Array>& arr) const {
+        if (static_cast<uint64_t>(arr->length()) != info.tuple_count) {
+            throw std::logic_error{"the number of tuples does not match the chunk info"};
+        }
+        if (static_cast<uint64_t>(arr->null_count()) != info.null_count) {
+            throw std::logic_error{"the null count does not match the chunk info"};
+        }
+    }
+
+    // Bitmap of the bits [offset, offset + length), which is borrowed if it starts at a byte
+    static std::shared_ptr<arrow::Buffer> getBitmap(const std::shared_ptr<arrow::Buffer>& bitmap,
+                                                    const int64_t offset, const int64_t length) {
+        if (offset % 8 == 0) {
+            return arrow::SliceBuffer(bitmap, offset / 8, (length + 7) / 8);
+        }
+        return valueOrThrow(arrow::internal::CopyBitmap(arrow::default_memory_pool(), bitmap->data(), offset, length));
+    }
+
+    // Offsets of the values of a binary or string array starting at 0, which are borrowed if they already do
+    template <typename Offset>
+    static std::shared_ptr<arrow::Buffer> getOffsets(const arrow::ArrayData& data) {
+        const Offset* offsets = data.GetValues<Offset>(1);
+        if (offsets[0] == 0) {
+            return arrow::SliceBuffer(data.buffers[1], data.offset * sizeof(Offset), (data.length + 1) * sizeof(Offset));
+        }
+        auto result = valueOrThrow(arrow::AllocateBuffer((data.length + 1) * sizeof(Offset)));
+        Offset* rebased = reinterpret_cast<Offset*>(result->mutable_data());
+        for (int64_t i = 0; i <= data.length; i++) rebased[i] = offsets[i] - offsets[0];
+        return result;
+    }
+
+    // The buffers of the chunk k including their padding, which borrow the memory of the array where possible
+    std::vector<std::shared_ptr<arrow::Buffer>> getChunkBuffers(const uint64_t k, const std::shared_ptr<arrow::Array>& arr) const {
+        const uint64_t column = k % numColumns;
+        const ChunkInfo& info = chunkInfos[column][k / numColumns];
+        checkChunk(info, arr);
+        const arrow::ArrayData& data = *arr->data();
+        std::vector<std::shared_ptr<arrow::Buffer>> result;
+        if (arr->null_count() != 0) {
+            result.push_back(getBitmap(data.buffers[0], data.offset, data.length));
+        } else {
+            result.push_back(getPadding(0));
+        }
+        if (const uint64_t offsetWidth = getOffsetWidth(*arr->type())) {
+            result.push_back(offsetWidth == sizeof(int32_t) ? getOffsets<int32_t>(data) : getOffsets<int64_t>(data));
+            const int64_t first = offsetWidth == sizeof(int32_t) ? data.GetValues<int32_t>(1)[0] : data.GetValues<int64_t>(1)[0];
+            const int64_t last = offsetWidth == sizeof(int32_t)
+                ? data.GetValues<int32_t>(1)[data.length] : data.GetValues<int64_t>(1)[data.length];
+            result.push_back(arrow::SliceBuffer(data.buffers[2], first, last - first));
+        } else if (arr->type_id() == arrow::Type::BOOL) {
+            result.push_back(getBitmap(data.buffers[1], data.offset, data.length));
+        } else {
+            const int64_t width = arr->type()->byte_width();
+            result.push_back(arrow::SliceBuffer(data.buffers[1], data.offset * width, data.length * width));
+        }
+        const std::vector<uint64_t> lengths = getBufferLengths(column, info);
+        std::vector<std::shared_ptr<arrow::Buffer>> padded;
+        for (size_t b = 0; b != result.size(); b++) {
+            if (static_cast<uint64_t>(result[b]->size()) != lengths[b]) {
+                throw std::logic_error{"the values do not match the chunk info"};
+            }
+            padded.push_back(std::move(result[b]));
+            const uint64_t padding = IPCUtils::getPaddedSize(lengths[b]) - lengths[b];
+            if (padding) padded.push_back(getPadding(padding));
+        }
+        return padded;
+    }
+
+    // Calls f(buffer, begin) for the parts of the file overlapping the range, which begin at the given offset
+    template <typename F>
+    void visitParts(const ByteRange range, F&& f) const {
+        const auto overlaps = [&](const int64_t begin, const int64_t size) {
+            return size > 0 && begin <= range.end && begin + size > range.begin;
+        };
+        if (overlaps(0, header->size())) f(header, 0);
+        // the first rowgroup is the last one beginning at or before range.begin
+        const auto firstMessage = std::upper_bound(messageOffsets.begin(), messageOffsets.end(),
+            static_cast<uint64_t>(range.begin));
+        for (uint64_t i = firstMessage == messageOffsets.begin() ? 0 : firstMessage - messageOffsets.begin() - 1;
+             i < numRowgroups && messageOffsets[i] <= static_cast<uint64_t>(range.end); i++) {
+            if (overlaps(messageOffsets[i], messageSize)) f(messages[i], messageOffsets[i]);
+            for (uint64_t k = i * numColumns; k != (i + 1) * numColumns; k++) {
+                if (!overlaps(chunkOffsets[k], chunkOffsets[k + 1] - chunkOffsets[k])) continue;
+                metrics.record(Counter::ChunksTouched);
+                std::shared_ptr<arrow::Array> arr;
+                {
+                    const Metrics::Timer timer(metrics, Latency::Read);
+                    arr = reader->readChunk(i, k % numColumns);
+                }
+                std::vector<std::shared_ptr<arrow::Buffer>> buffers;
+                {
+                    metrics.record(Counter::ChunksSerialized);
+                    const Metrics::Timer timer(metrics, Latency::Serialize);
+                    buffers = getChunkBuffers(k, arr);
+                }
+                int64_t begin = chunkOffsets[k];
+                for (auto& buffer : buffers) {
+                    if (overlaps(begin, buffer->size())) f(buffer, begin);
+                    begin += buffer->size();
+                }
+            }
+        }
+        if (overlaps(fileOffset, footer->size())) {
+            metrics.record(Counter::FooterReads);
+            f(footer, fileOffset);
+        }
+    }
+public:
+    explicit VirtualArrowIPCFile(
+        const std::shared_ptr<ArrowReader>& reader,
+        const std::shared_ptr<arrow::Schema>& schema,
+        std::vector<std::vector<ChunkInfo>>&& chunkInfos) :
+            VirtualFile(reader, schema, std::move(chunkInfos)) {
+        for (const auto& field : schema->fields()) checkType(*field->type());
+        const auto schemaMessage = valueOrThrow(arrow::ipc::SerializeSchema(*schema));
+        std::vector<uint8_t> prefix(IPCUtils::ALIGNMENT, 0);
+        memcpy(prefix.data(), MAGIC, MAGIC_SIZE);
+        prefix.insert(prefix.end(), schemaMessage->data(), schemaMessage->data() + schemaMessage->size());
+        header = arrow::Buffer::FromVector(std::move(prefix));
+        fileOffset = header->size();
+        // the size of record batch messages only depends on the number of columns and buffers
+        std::vector<IPCUtils::BufferLocation> locations;
+        for (size_t j = 0; j != numColumns; j++) {
+            locations.resize(locations.size() + (getOffsetWidth(*schema->field(j)->type()) ? 3 : 2));
+        }
+        messageSize = IPCUtils::writeRecordBatchMessage(0, std::vector<IPCUtils::FieldNode>(numColumns), locations, 0)->size();
+        size = initSize();
+    }
+
+    using VirtualFile::getRange;
+
+    // Thread-safe as long as the reader is
+    void getRange(const ByteRange range, std::span<char> out) override {
+        assert(range.end < static_cast<int64_t>(size));
+        assert(out.size() >= range.size());
+        const auto request = startRequest(range, false);
+        visitParts(range, [&](const std::shared_ptr<arrow::Buffer>& buffer, const int64_t begin) {
+            const int64_t from = std::max(begin, range.begin);
+            const int64_t to = std::min<int64_t>(begin + buffer->size() - 1, range.end);
+            memcpy(out.data() + (from - range.begin), buffer->data() + (from - begin), to - from + 1);
+        });
+    }
+
+    std::vector<std::shared_ptr<arrow::Buffer>> getRangeSegments(const ByteRange range) override {
+        assert(range.end < static_cast<int64_t>(size));
+        const auto request = startRequest(range, true);
+        std::vector<std::shared_ptr<arrow::Buffer>> segments;
+        visitParts(range, [&](const std::shared_ptr<arrow::Buffer>& buffer, const int64_t begin) {
+            const int64_t from = std::max(begin, range.begin);
+            const int64_t to = std::min<int64_t>(begin + buffer->size() - 1, range.end);
+            segments.push_back(arrow::SliceBuffer(buffer, from - begin, to - from + 1));
+        });
+        return segments;
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
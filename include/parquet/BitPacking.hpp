@@ -0,0 +1,114 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+// -------------------------------------------------------------------------------------
+#if defined(__BMI2__) && defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+// Bit-packing of the RLE/bit-packing hybrid encoding: every group of 8 values is packed into bitWidth bytes,
+// starting with the least significant bit of the first value. Indices of up to 16 bits are narrowed with
+// SSE4.1 (AVX-512 if available) and packed with BMI2, all other indices and CPUs use the scalar kernel.
+class BitPacking {
+    template <typename T>
+    static void packGroupScalar(const T* in, const uint8_t bitWidth, uint8_t* out) {
+        uint64_t buffer = 0;
+        uint8_t bits = 0;
+        for (int i = 0; i != 8; i++) {
+            buffer |= static_cast<uint64_t>(in[i]) << bits;
+            bits += bitWidth;
+            for (; bits >= 8; bits -= 8) {
+                *out++ = static_cast<uint8_t>(buffer);
+                buffer >>= 8;
+            }
+        }
+    }
+
+#if defined(__BMI2__) && defined(__SSE4_1__)
+    // 8 values of at most 8 bits, one per byte
+    static void packBytes(const uint64_t values, const uint8_t bitWidth, uint8_t* out) {
+        const uint64_t packed = _pext_u64(values, 0x0101010101010101ull * ((1u << bitWidth) - 1));
+        memcpy(out, &packed, bitWidth);
+    }
+
+    // 8 values of at most 16 bits, four per word
+    static void packWords(const uint64_t low, const uint64_t high, const uint8_t bitWidth, uint8_t* out) {
+        const uint64_t mask = 0x0001000100010001ull * ((1u << bitWidth) - 1);
+        const unsigned __int128 packed = _pext_u64(low, mask)
+            | static_cast<unsigned __int128>(_pext_u64(high, mask)) << (4 * bitWidth);
+        memcpy(out, &packed, bitWidth);
+    }
+
+    // narrows 8 values of at most 16 bits to 16 bits each
+    template <typename T>
+    static __m128i narrowToWords(const T* in) {
+        if constexpr (sizeof(T) == 2) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        } else {
+            // the values fit into 16 bits, the saturation never applies
+            return _mm_packus_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)),
+                                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4)));
+        }
+    }
+
+    // narrows 8 values of at most 8 bits to a byte each
+    template <typename T>
+    static uint64_t narrowToBytes(const T* in) {
+        uint64_t result;
+        if constexpr (sizeof(T) == 1) {
+            memcpy(&result, in, sizeof(result));
+        } else {
+#if defined(__AVX512VL__)
+            if constexpr (sizeof(T) == 4) {
+                // the zero-masked form, the unmasked one leaves the upper lanes undefined
+                return _mm_cvtsi128_si64(_mm256_maskz_cvtepi32_epi8(0xff, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in))));
+            }
+#endif
+            const __m128i words = narrowToWords(in);
+            result = _mm_cvtsi128_si64(_mm_packus_epi16(words, words));
+        }
+        return result;
+    }
+#endif
+
+public:
+    // Packs the 8 values in[0..7] of at most bitWidth <= 32 bits into out[0..bitWidth-1]
+    template <typename T>
+    static void packGroup(const T* in, const uint8_t bitWidth, uint8_t* out) {
+        static_assert(std::is_unsigned_v<T>);
+        assert(bitWidth <= 32);
+#if defined(__BMI2__) && defined(__SSE4_1__)
+        if constexpr (sizeof(T) <= 4) {
+            if (bitWidth <= 8) {
+                return packBytes(narrowToBytes(in), bitWidth, out);
+            }
+            if constexpr (sizeof(T) >= 2) {
+                if (bitWidth <= 16) {
+                    const __m128i words = narrowToWords(in);
+                    return packWords(_mm_cvtsi128_si64(words), _mm_extract_epi64(words, 1), bitWidth, out);
+                }
+            }
+        }
+#endif
+        packGroupScalar(in, bitWidth, out);
+    }
+
+    // Reference implementation of packGroup, used to validate the vectorized kernels
+    template <typename T>
+    static void packGroupReference(const T* in, const uint8_t bitWidth, uint8_t* out) {
+        packGroupScalar(in, bitWidth, out);
+    }
+
+    // Size of count values packed into groups of 8
+    static uint64_t getPackedSize(const uint64_t count, const uint8_t bitWidth) {
+        return (count + 7) / 8 * bitWidth;
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
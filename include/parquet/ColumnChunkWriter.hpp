@@ -1,70 +1,233 @@
 #pragma once
 // -------------------------------------------------------------------------------------
+#include <algorithm>
+#include <cstring>
 #include <memory>
+#include <span>
 #include <vector>
 // -------------------------------------------------------------------------------------
 #include <arrow/api.h>
+#include <arrow/visit_type_inline.h>
+// -------------------------------------------------------------------------------------
+#include "BitPacking.hpp"
+#include "ParquetUtils.hpp"
+#include "PlainEncoder.hpp"
 // -------------------------------------------------------------------------------------
 namespace virtualfile {
 // -------------------------------------------------------------------------------------
+// All writers produce the bytes [from, to] of the serialized chunk, i.e. the header followed by the values,
+// s.t. a range within a chunk is served without serializing the remainder of the chunk.
+// The values are written by the PlainEncoder of the type of the array, which is selected at compile time.
 class ColumnChunkWriter {
+    using DefinitionLevels = ParquetUtils::DefinitionLevels;
+
+    struct ValuesWriter {
+        const arrow::ArraySpan& data;
+        char* vec;
+        uint64_t from;
+        uint64_t to;
+
+        template <typename T> requires requires { PlainEncoder<T>{}; }
+        arrow::Status Visit(const T&) {
+            PlainEncoder<T>::writeValues(data, vec, from, to);
+            return arrow::Status::OK();
+        }
+
+        arrow::Status Visit(const arrow::DataType& type) {
+            return arrow::Status::NotImplemented("unknown type for serialization " + type.ToString());
+        }
+    };
+
+    struct ValuesSize {
+        const arrow::ArraySpan& data;
+        uint64_t result = 0;
+
+        template <typename T> requires requires { PlainEncoder<T>{}; }
+        arrow::Status Visit(const T&) {
+            result = PlainEncoder<T>::getValuesSize(data);
+            return arrow::Status::OK();
+        }
+
+        arrow::Status Visit(const arrow::DataType& type) {
+            return arrow::Status::NotImplemented("unknown type for serialization " + type.ToString());
+        }
+    };
+
+    struct Borrowable {
+        bool result = false;
+
+        template <typename T> requires requires (const T& type) { PlainEncoder<T>::isBorrowable(type); }
+        arrow::Status Visit(const T& type) {
+            result = PlainEncoder<T>::isBorrowable(type);
+            return arrow::Status::OK();
+        }
+
+        arrow::Status Visit(const arrow::DataType&) {
+            return arrow::Status::OK();
+        }
+    };
+
+    template <typename Visitor>
+    static void visit(const arrow::DataType& type, Visitor& visitor) {
+        const arrow::Status status = arrow::VisitTypeInline(type, &visitor);
+        if (!status.ok()) {
+            throw std::logic_error{status.message()};
+        }
+    }
+
+    // Packs the groups [firstGroup, lastGroup] of the count valid indices, values[k] is the index of the valid
+    // value first + k. Writes the bytes [from, to] of the bit-packed indices, the last group is padded with zeros
     template <typename T>
-    static void writeNumericColumnChunk(
-            const std::vector<uint8_t>& header,
-            const std::shared_ptr<arrow::Array>& array,
-            char* vec) {
-        memcpy(vec, header.data(), header.size());
-        memcpy(vec + header.size(), array->data()->buffers[1]->data(), array->length() * sizeof(T));
+    static void packGroups(const T* values, const uint64_t first, const uint64_t count, const uint64_t firstGroup,
+                           const uint64_t lastGroup, char* vec, const uint8_t bitWidth, const uint64_t from,
+                           const uint64_t to) {
+        uint8_t group[32];
+        for (uint64_t g = firstGroup; g <= lastGroup; g++) {
+            const uint64_t groupBegin = g * bitWidth;
+            // groups completely within the range are packed in place
+            const bool inPlace = groupBegin >= from && groupBegin + bitWidth - 1 <= to;
+            uint8_t* out = inPlace ? reinterpret_cast<uint8_t*>(vec + (groupBegin - from)) : group;
+            if (8 * g + 8 <= count) {
+                BitPacking::packGroup(values + (8 * g - first), bitWidth, out);
+            } else {
+                T padded[8] = {};
+                std::copy(values + (8 * g - first), values + (count - first), padded);
+                BitPacking::packGroup(padded, bitWidth, out);
+            }
+            if (!inPlace) {
+                Bits::copyClipped(vec + (std::max(groupBegin, from) - from), group, groupBegin, bitWidth, from, to);
+            }
+        }
     }
 
-    static void writeStringColumnChunk(
-            const std::vector<uint8_t>& header,
-            const std::shared_ptr<arrow::Array>& array,
-            char* vec) {
-        const uint8_t* src = array->data()->buffers[2]->data();
-        auto* offsets = reinterpret_cast<const int32_t*>(array->data()->buffers[1]->data());
-        memcpy(vec, header.data(), header.size());
-        int32_t curr_offset = header.size();
-        const int64_t n = array->length();
-        for (int64_t i=0; i!=n; i++) {
-            int32_t length = offsets[i+1] - offsets[i];
-            memcpy(vec + curr_offset, &length, sizeof(int32_t));
-            curr_offset += 4;
-            memcpy(vec + curr_offset, src + offsets[i], length);
-            curr_offset += length;
+    // Writes the bytes [from, to] of the bit-packed valid indices. Nulls have no index, the indices of the
+    // groups within the range are gathered in batches of groups on the stack before they are packed
+    template <typename T>
+    static void writePackedIndices(const arrow::ArraySpan& indices, char* vec,
+                                   const uint8_t bitWidth, const uint64_t from, const uint64_t to) {
+        constexpr uint64_t BATCH_GROUPS = 64;
+        const uint64_t firstGroup = from / bitWidth;
+        const uint64_t lastGroup = to / bitWidth;
+        const uint64_t count = indices.length - indices.GetNullCount();
+        const T* values = indices.GetValues<T>(1);
+        if (indices.GetNullCount() == 0) {
+            packGroups(values, 0, count, firstGroup, lastGroup, vec, bitWidth, from, to);
+            return;
         }
+        const int64_t slot = Bits::findValidSlot(indices, 8 * firstGroup);
+        arrow::internal::SetBitRunReader runs(indices.buffers[0].data, indices.offset + slot, indices.length - slot);
+        arrow::internal::SetBitRun run = runs.NextRun();
+        T gathered[8 * BATCH_GROUPS];
+        for (uint64_t g = firstGroup; g <= lastGroup; g += BATCH_GROUPS) {
+            // the valid indices of the batch continue the runs of the previous batch
+            const uint64_t last = std::min(lastGroup, g + BATCH_GROUPS - 1);
+            const uint64_t needed = std::min(count - 8 * g, 8 * (last - g + 1));
+            uint64_t size = 0;
+            while (size < needed && !run.AtEnd()) {
+                const uint64_t length = std::min<uint64_t>(run.length, needed - size);
+                std::copy_n(values + slot + run.position, length, gathered + size);
+                size += length;
+                run.position += length;
+                run.length -= length;
+                if (run.length == 0) run = runs.NextRun();
+            }
+            packGroups<T>(gathered, 8 * g, count, g, last, vec, bitWidth, from, to);
+        }
+    }
+
+    // Writes the header part of [from, to] and returns the range of the values to be written
+    static bool writeHeader(std::span<const uint8_t> header, char*& vec, uint64_t& from, uint64_t& to) {
+        vec += Bits::copyClipped(vec, header.data(), 0, header.size(), from, to);
+        if (to < header.size()) return false;
+        from = from > header.size() ? from - header.size() : 0;
+        to -= header.size();
+        return true;
+    }
+
+    // Writes the part of the validity bitmap of BITMAP definition levels within [from, to]
+    static bool writeBitmap(const arrow::ArraySpan& array, const DefinitionLevels levels,
+                            char*& vec, uint64_t& from, uint64_t& to) {
+        if (levels != DefinitionLevels::BITMAP) return true;
+        const uint64_t size = (array.length + 7) / 8;
+        vec += Bits::copyBits(array.buffers[0].data, array.offset, array.length, vec, from, to);
+        if (to < size) return false;
+        from = from > size ? from - size : 0;
+        to -= size;
+        return true;
     }
 public:
-    static void writeDictionaryEncodedChunk(const std::vector<uint8_t>& header,
-                                            const std::shared_ptr<arrow::Array>& array,
+    // Writes the indices of the dictionary encoded chunk, which are bit-packed in groups of 8 indices.
+    // The header ends with the definition levels, the bitmap of BITMAP levels follows it. The prefix of the
+    // indices, i.e. their bit width and run header, follows the definition levels
+    static void writeDictionaryEncodedChunk(std::span<const uint8_t> header,
+                                            std::span<const uint8_t> prefix,
+                                            const arrow::ArraySpan& indices,
                                             char* vec,
-                                            const uint8_t byteLength,
-                                            const int32_t offset) {
-        assert(byteLength == 1);
-        const auto* data = reinterpret_cast<const uint8_t *>(array->data()->buffers[1]->data());
-        const uint64_t n = array->length();
-        memcpy(vec, header.data(), header.size());
-
-        const size_t off = header.size();
-        for (uint64_t i=0; i!=n; i++) {
-            vec[off + i] = data[4 * i];
+                                            const uint8_t bitWidth,
+                                            uint64_t from, uint64_t to,
+                                            const DefinitionLevels levels = DefinitionLevels::ALL_VALID) {
+        if (!writeHeader(header, vec, from, to) || !writeBitmap(indices, levels, vec, from, to)) return;
+        if (!writeHeader(prefix, vec, from, to) || bitWidth == 0) return;
+        switch (indices.type->id()) {
+            case arrow::Type::INT8:
+            case arrow::Type::UINT8:
+                return writePackedIndices<uint8_t>(indices, vec, bitWidth, from, to);
+            case arrow::Type::INT16:
+            case arrow::Type::UINT16:
+                return writePackedIndices<uint16_t>(indices, vec, bitWidth, from, to);
+            case arrow::Type::INT32:
+            case arrow::Type::UINT32:
+                return writePackedIndices<uint32_t>(indices, vec, bitWidth, from, to);
+            case arrow::Type::INT64:
+            case arrow::Type::UINT64:
+                return writePackedIndices<uint64_t>(indices, vec, bitWidth, from, to);
+            default:
+                throw std::logic_error{"unknown index type " + indices.type->ToString()};
         }
     }
 
-    static void writeColumnChunk(const std::vector<uint8_t>& header,
+    // The header ends with the definition levels, the bitmap of BITMAP levels follows it.
+    // The values are a non-owning span, s.t. pages of a chunk are written without allocating a slice of it
+    static void writeColumnChunk(std::span<const uint8_t> header,
+                                 const arrow::ArraySpan& array,
+                                 char* vec, uint64_t from, uint64_t to,
+                                 const DefinitionLevels levels = DefinitionLevels::ALL_VALID) {
+        if (!writeHeader(header, vec, from, to) || !writeBitmap(array, levels, vec, from, to)) return;
+        ValuesWriter writer{array, vec, from, to};
+        visit(*array.type, writer);
+    }
+
+    static void writeColumnChunk(std::span<const uint8_t> header,
                                  const std::shared_ptr<arrow::Array>& array,
-                                 char* vec) {
-        if (array->type() == arrow::int32()) {
-            return writeNumericColumnChunk<int32_t>(header, array, vec);
-        }
-        if (array->type() == arrow::float64()) {
-            return writeNumericColumnChunk<double>(header, array, vec);
-        }
-        if (array->type() == arrow::utf8()) {
-            return writeStringColumnChunk(header, array, vec);
-        }
-        throw std::logic_error{"unknown type for serialization " + array->type()->ToString()};
+                                 char* vec, uint64_t from, uint64_t to,
+                                 const DefinitionLevels levels = DefinitionLevels::ALL_VALID) {
+        writeColumnChunk(header, arrow::ArraySpan(*array->data()), vec, from, to, levels);
+    }
+
+    // Size of the plain encoded valid values, strings are prefixed with their 4 byte length
+    static uint64_t getValuesSize(const arrow::ArraySpan& array) {
+        ValuesSize size{array};
+        visit(*array.type, size);
+        return size.result;
+    }
+
+    static uint64_t getValuesSize(const std::shared_ptr<arrow::Array>& array) {
+        return getValuesSize(arrow::ArraySpan(*array->data()));
+    }
+
+    // Appends the column chunk as list of segments, which borrow the values of the array instead of copying them.
+    // Returns false if the array cannot be represented that way and has to be serialized with writeColumnChunk
+    static bool appendColumnChunkSegments(std::shared_ptr<arrow::Buffer> header,
+                                          const arrow::ArraySpan& array,
+                                          std::vector<std::shared_ptr<arrow::Buffer>>& segments) {
+        Borrowable borrowable;
+        visit(*array.type, borrowable);
+        if (!borrowable.result || array.GetNullCount() != 0 || !array.buffers[1].owner) return false;
+        const int64_t width = array.type->byte_width();
+        segments.push_back(std::move(header));
+        segments.push_back(arrow::SliceBuffer(*array.buffers[1].owner, array.offset * width, array.length * width));
+        return true;
     }
 };
 // -------------------------------------------------------------------------------------
-} // namespace virtualfiles
\ No newline at end of file
+} // namespace virtualfiles
@@ -0,0 +1,120 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <memory>
+#include <string>
+#include <vector>
+// -------------------------------------------------------------------------------------
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/exception.h>
+#include <parquet/file_reader.h>
+#include <parquet/metadata.h>
+// -------------------------------------------------------------------------------------
+#include "../ArrowReader.hpp"
+#include "../ChunkInfoUtils.hpp"
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+struct MappedParquetReaderOptions {
+    // Read the string and binary columns, whose chunks are all dictionary encoded, as dictionary arrays, s.t. virtual
+    // parquet files serve them dictionary encoded again instead of with plain values
+    bool readDictionaries = true;
+    arrow::MemoryPool* pool = arrow::default_memory_pool();
+};
+
+// Reader of an existing parquet file, e.g. of a compressed file written by another system, which is served as a
+// virtual file with a different layout. The file is memory-mapped and its footer is parsed once, the column chunks
+// are decoded and decompressed on demand. Every read decodes a chunk with a reader of its own that shares the
+// footer, s.t. concurrent and asynchronous reads of several chunks decompress them in parallel.
+class MappedParquetReader final : public ArrowReader {
+    std::shared_ptr<arrow::io::MemoryMappedFile> file;
+    std::shared_ptr<parquet::FileMetaData> metadata;
+    parquet::ArrowReaderProperties properties;
+    const MappedParquetReaderOptions options;
+
+    // A chunk is read as dictionary array if all its pages are dictionary encoded in every rowgroup
+    static bool isDictionaryEncoded(const parquet::FileMetaData& metadata, const int column) {
+        if (metadata.schema()->Column(column)->physical_type() != parquet::Type::BYTE_ARRAY) return false;
+        for (int i = 0; i != metadata.num_row_groups(); i++) {
+            const auto chunk = metadata.RowGroup(i)->ColumnChunk(column);
+            if (!chunk->has_dictionary_page()) return false;
+            for (const parquet::PageEncodingStats& stats : chunk->encoding_stats()) {
+                const bool dataPage = stats.page_type == parquet::PageType::DATA_PAGE
+                    || stats.page_type == parquet::PageType::DATA_PAGE_V2;
+                if (dataPage && stats.encoding != parquet::Encoding::RLE_DICTIONARY
+                    && stats.encoding != parquet::Encoding::PLAIN_DICTIONARY) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    std::unique_ptr<parquet::arrow::FileReader> makeReader() const {
+        parquet::arrow::FileReaderBuilder builder;
+        PARQUET_THROW_NOT_OK(builder.Open(file, parquet::default_reader_properties(), metadata));
+        builder.memory_pool(options.pool)->properties(properties);
+        PARQUET_ASSIGN_OR_THROW(auto result, builder.Build());
+        return result;
+    }
+
+    static std::shared_ptr<arrow::Schema> readSchema(parquet::arrow::FileReader& reader) {
+        std::shared_ptr<arrow::Schema> result;
+        PARQUET_THROW_NOT_OK(reader.GetSchema(&result));
+        return result;
+    }
+
+    MappedParquetReader(std::shared_ptr<arrow::io::MemoryMappedFile> file,
+                        std::shared_ptr<parquet::FileMetaData> metadata, MappedParquetReaderOptions options) :
+            ArrowReader(nullptr), file(std::move(file)), metadata(std::move(metadata)), options(std::move(options)) {
+        if (this->metadata->num_columns() != this->metadata->schema()->group_node()->field_count()) {
+            throw std::logic_error{"nested columns are not supported"};
+        }
+        // the chunks are decoded whole and in parallel by several readers, pre-buffering is up to the page cache
+        properties.set_pre_buffer(false);
+        properties.set_use_threads(false);
+        for (int j = 0; j != this->metadata->num_columns(); j++) {
+            properties.set_read_dictionary(j, this->options.readDictionaries && isDictionaryEncoded(*this->metadata, j));
+        }
+        schema = readSchema(*makeReader());
+    }
+
+    static std::shared_ptr<arrow::io::MemoryMappedFile> openFile(const std::string& path) {
+        PARQUET_ASSIGN_OR_THROW(auto result, arrow::io::MemoryMappedFile::Open(path, arrow::io::FileMode::READ));
+        return result;
+    }
+
+    static std::shared_ptr<parquet::FileMetaData> readMetadata(const std::shared_ptr<arrow::io::MemoryMappedFile>& file) {
+        return parquet::ParquetFileReader::Open(file)->metadata();
+    }
+
+    MappedParquetReader(std::shared_ptr<arrow::io::MemoryMappedFile> file, MappedParquetReaderOptions options) :
+            MappedParquetReader(file, readMetadata(file), std::move(options)) {}
+
+public:
+    explicit MappedParquetReader(const std::string& path, MappedParquetReaderOptions options = {}) :
+            MappedParquetReader(openFile(path), std::move(options)) {}
+
+    uint64_t getNumRowgroups() const { return metadata->num_row_groups(); }
+
+    std::shared_ptr<arrow::Array> readChunk(const uint64_t rowgroup, const uint64_t column) override {
+        PARQUET_ASSIGN_OR_THROW(const auto table, makeReader()->ReadRowGroup(rowgroup, {static_cast<int>(column)}));
+        const arrow::ArrayVector& chunks = table->column(0)->chunks();
+        if (chunks.size() == 1) return chunks[0];
+        if (chunks.empty()) {
+            PARQUET_ASSIGN_OR_THROW(auto result, arrow::MakeEmptyArray(table->column(0)->type(), options.pool));
+            return result;
+        }
+        PARQUET_ASSIGN_OR_THROW(auto result, arrow::Concatenate(chunks, options.pool));
+        return result;
+    }
+
+    // Chunk infos of all chunks, which are decoded in parallel on the executor if one is given
+    std::vector<std::vector<ChunkInfo>> computeChunkInfos(arrow::internal::Executor* executor = nullptr) {
+        return ChunkInfoUtils::computeChunkInfos(*this, getNumRowgroups(), executor);
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
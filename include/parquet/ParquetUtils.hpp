@@ -14,11 +14,14 @@ namespace virtualfile {
 #define PLAIN_ENCODING 0x00
 #define PLAIN_DICTIONARY_ENCODING 0x02
 #define RLE_ENCODING 0x03
+#define DELTA_BINARY_PACKED_ENCODING 0x05
+#define DELTA_LENGTH_BYTE_ARRAY_ENCODING 0x06
+#define BYTE_STREAM_SPLIT_ENCODING 0x09
 // -------------------------------------------------------------------------------------
 class ParquetUtils {
 public:
     // credit duckdb
-    static uint8_t GetVarintSize(uint32_t val) {
+    static uint8_t GetVarintSize(uint64_t val) {
         uint8_t res = 0;
         do {
             val >>= 7;
@@ -31,7 +34,6 @@ public:
         return (val >> 63) ^ (val << 1);
     }
 
-private:
     // credit duckdb
     static void appendZigZagVarint(std::vector<uint8_t>& v, uint64_t val) {
         do {
@@ -43,21 +45,38 @@ private:
             v.push_back(byte);
         } while (val != 0);
     }
-public:
-    static std::vector<uint8_t> writePageWithoutData(uint64_t uncompressed_size,
-                                                     uint64_t num_values,
-                                                     bool isDictionaryPage = false,
-                                                     bool isDictionaryEncoded = false,
-                                                     uint8_t bitWidth = 0){
+
+    // Writes the varint into out and returns its size
+    static uint8_t writeZigZagVarint(uint8_t* out, uint64_t val) {
+        uint8_t size = 0;
+        do {
+            uint8_t byte = val & 0x7F;
+            val >>= 7;
+            if (val != 0) {
+                byte |= 0x80;
+            }
+            out[size++] = byte;
+        } while (val != 0);
+        return size;
+    }
+
+    // Appends the thrift page header, the compressed size is the size of the page body following the header.
+    // The encoding is the one of the values of the page
+    static void appendPageHeader(std::vector<uint8_t>& result,
+                                 uint64_t uncompressed_size,
+                                 uint64_t compressed_size,
+                                 uint64_t num_values,
+                                 bool isDictionaryPage = false,
+                                 uint8_t encoding = PLAIN_ENCODING){
         // Declare data page
-        std::vector<uint8_t> result{NEXT_INTEGER_FIELD, GetZigZag(isDictionaryPage ? DICTIONARY_PAGE : DATA_PAGE_V1)};
-        result.reserve(40);
+        result.push_back(NEXT_INTEGER_FIELD);
+        result.push_back(static_cast<uint8_t>(GetZigZag(isDictionaryPage ? DICTIONARY_PAGE : DATA_PAGE_V1)));
         // Write uncompressed size
         result.push_back(NEXT_INTEGER_FIELD);
         appendZigZagVarint(result, GetZigZag(uncompressed_size));
         // Write compressed size
         result.push_back(NEXT_INTEGER_FIELD);
-        appendZigZagVarint(result, GetZigZag(uncompressed_size));
+        appendZigZagVarint(result, GetZigZag(compressed_size));
         // Start struct
         result.push_back(isDictionaryPage ? DICTIONARY_STRUCT_FIELD : NEXT_STRUCT_FIELD);
         // Write num_values
@@ -65,11 +84,8 @@ public:
         appendZigZagVarint(result, GetZigZag(num_values));
         // Write encoding
         result.push_back(NEXT_INTEGER_FIELD);
-        appendZigZagVarint(result, GetZigZag(isDictionaryEncoded ? PLAIN_DICTIONARY_ENCODING : PLAIN_ENCODING));
+        appendZigZagVarint(result, GetZigZag(encoding));
         if (!isDictionaryPage) {
-            // Write encoding
-            result.push_back(NEXT_INTEGER_FIELD);
-            appendZigZagVarint(result, GetZigZag(PLAIN_ENCODING));
             // Write definition level encoding
             result.push_back(NEXT_INTEGER_FIELD);
             appendZigZagVarint(result, GetZigZag(RLE_ENCODING));
@@ -81,20 +97,126 @@ public:
         result.push_back(END_STRUCT);
         // End page
         result.push_back(END_STRUCT);
+    }
 
-        if (!isDictionaryPage) {
-            // Write length of rle run
-            result.push_back((GetVarintSize(num_values << 1) + 1));
-            for (int i=0; i!=3; i++) result.push_back(0x00);
-            appendZigZagVarint(result, num_values << 1);
-            result.push_back(0x01);
-        }
-        if (isDictionaryEncoded) {
-            // bit width
-            result.push_back(bitWidth);
-            appendZigZagVarint(result, ((num_values + 7) / 8) << 1 | 1);
+    static std::vector<uint8_t> writePageHeader(uint64_t uncompressed_size,
+                                                uint64_t compressed_size,
+                                                uint64_t num_values,
+                                                bool isDictionaryPage = false,
+                                                uint8_t encoding = PLAIN_ENCODING){
+        std::vector<uint8_t> result;
+        result.reserve(40);
+        appendPageHeader(result, uncompressed_size, compressed_size, num_values, isDictionaryPage, encoding);
+        return result;
+    }
+
+    // Size of the page header without writing it
+    static uint64_t getPageHeaderSize(uint64_t uncompressed_size,
+                                      uint64_t compressed_size,
+                                      uint64_t num_values,
+                                      bool isDictionaryPage = false){
+        // field headers, the page type, the encodings and the ends of the structs take a byte each
+        const uint64_t fixedSize = isDictionaryPage ? 10 : 14;
+        return fixedSize + GetVarintSize(GetZigZag(uncompressed_size)) + GetVarintSize(GetZigZag(compressed_size))
+            + GetVarintSize(GetZigZag(num_values));
+    }
+
+    // Encoding of the definition levels of a data page, which are 1 for valid and 0 for null values of nullable columns.
+    // All of them are exactly sized by the number of values and nulls.
+    enum class DefinitionLevels : uint8_t {
+        // required columns have no definition levels
+        REQUIRED,
+        // a single rle run of 1
+        ALL_VALID,
+        // a single rle run of 0
+        ALL_NULL,
+        // a single bit-packed run, which is the validity bitmap of the values
+        BITMAP
+    };
+
+    static DefinitionLevels getDefinitionLevels(bool nullable, uint64_t num_values, uint64_t null_count) {
+        if (!nullable) return DefinitionLevels::REQUIRED;
+        if (null_count == 0) return DefinitionLevels::ALL_VALID;
+        if (null_count == num_values) return DefinitionLevels::ALL_NULL;
+        return DefinitionLevels::BITMAP;
+    }
+
+private:
+    static uint64_t getDefinitionLevelsRunHeader(uint64_t num_values, DefinitionLevels levels) {
+        return levels == DefinitionLevels::BITMAP ? ((num_values + 7) / 8) << 1 | 1 : num_values << 1;
+    }
+
+    static uint64_t getDictionaryIndicesRunHeader(uint64_t num_indices, uint8_t bitWidth) {
+        // all indices of bit width 0 are 0, a single rle run without value bytes,
+        // otherwise a single bit-packed run of all indices
+        return bitWidth == 0 ? num_indices << 1 : ((num_indices + 7) / 8) << 1 | 1;
+    }
+public:
+    // Appends the definition levels preceding the values of a data page, without the bitmap of BITMAP levels
+    static void appendDefinitionLevels(std::vector<uint8_t>& result, uint64_t num_values, DefinitionLevels levels) {
+        if (levels == DefinitionLevels::REQUIRED) return;
+        // Write length of the runs
+        const uint64_t runHeader = getDefinitionLevelsRunHeader(num_values, levels);
+        uint32_t length = GetVarintSize(runHeader);
+        length += levels == DefinitionLevels::BITMAP ? (num_values + 7) / 8 : 1;
+        for (int i=0; i!=4; i++) result.push_back(length >> (8 * i));
+        appendZigZagVarint(result, runHeader);
+        if (levels != DefinitionLevels::BITMAP) {
+            result.push_back(levels == DefinitionLevels::ALL_VALID ? 0x01 : 0x00);
         }
+    }
+
+    static std::vector<uint8_t> writeDefinitionLevels(uint64_t num_values, DefinitionLevels levels) {
+        std::vector<uint8_t> result;
+        appendDefinitionLevels(result, num_values, levels);
+        return result;
+    }
+
+    // Size of the definition levels written by writeDefinitionLevels
+    static uint64_t getDefinitionLevelsPrefixSize(uint64_t num_values, DefinitionLevels levels) {
+        if (levels == DefinitionLevels::REQUIRED) return 0;
+        const uint64_t valueSize = levels == DefinitionLevels::BITMAP ? 0 : 1;
+        return 4 + GetVarintSize(getDefinitionLevelsRunHeader(num_values, levels)) + valueSize;
+    }
+
+    // Size of the definition levels including the bitmap of BITMAP levels
+    static uint64_t getDefinitionLevelsSize(uint64_t num_values, DefinitionLevels levels) {
+        const uint64_t result = getDefinitionLevelsPrefixSize(num_values, levels);
+        return levels == DefinitionLevels::BITMAP ? result + (num_values + 7) / 8 : result;
+    }
+
+    // the bit width byte and a varint of at most 10 bytes
+    static constexpr size_t MAX_DICTIONARY_INDICES_PREFIX_SIZE = 11;
+
+    // Bit width and run header of num_indices dictionary indices, i.e. of the valid values of a data page.
+    // Writes them into out, which holds MAX_DICTIONARY_INDICES_PREFIX_SIZE bytes, and returns their size
+    static uint8_t writeDictionaryIndicesPrefix(uint64_t num_indices, uint8_t bitWidth, uint8_t* out) {
+        out[0] = bitWidth;
+        return 1 + writeZigZagVarint(out + 1, getDictionaryIndicesRunHeader(num_indices, bitWidth));
+    }
+
+    static std::vector<uint8_t> writeDictionaryIndicesPrefix(uint64_t num_indices, uint8_t bitWidth) {
+        std::vector<uint8_t> result(MAX_DICTIONARY_INDICES_PREFIX_SIZE);
+        result.resize(writeDictionaryIndicesPrefix(num_indices, bitWidth, result.data()));
+        return result;
+    }
 
+    static uint64_t getDictionaryIndicesPrefixSize(uint64_t num_indices, uint8_t bitWidth) {
+        return 1 + GetVarintSize(getDictionaryIndicesRunHeader(num_indices, bitWidth));
+    }
+
+    // Page header followed by the definition levels of data pages
+    static std::vector<uint8_t> writePageWithoutData(uint64_t uncompressed_size,
+                                                     uint64_t num_values,
+                                                     bool isDictionaryPage = false,
+                                                     uint8_t encoding = PLAIN_ENCODING,
+                                                     DefinitionLevels levels = DefinitionLevels::ALL_VALID){
+        std::vector<uint8_t> result = writePageHeader(uncompressed_size, uncompressed_size, num_values,
+            isDictionaryPage, encoding);
+        if (!isDictionaryPage) {
+            const std::vector<uint8_t> prefix = writeDefinitionLevels(num_values, levels);
+            result.insert(result.end(), prefix.begin(), prefix.end());
+        }
         return result;
     }
 };
@@ -0,0 +1,351 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+// -------------------------------------------------------------------------------------
+#include <arrow/api.h>
+#include <arrow/util/bit_run_reader.h>
+#include <arrow/util/bitmap_ops.h>
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+class Bits {
+public:
+    // Copies the part of [srcBegin, srcBegin + length) within [from, to] and returns the number of copied bytes
+    static uint64_t copyClipped(char* out, const void* src, const uint64_t srcBegin, const uint64_t length,
+                                const uint64_t from, const uint64_t to) {
+        const uint64_t begin = std::max(srcBegin, from);
+        const uint64_t end = std::min(srcBegin + length, to + 1);
+        if (begin >= end) return 0;
+        memcpy(out, static_cast<const char*>(src) + (begin - srcBegin), end - begin);
+        return end - begin;
+    }
+
+    // Writes the bytes [from, to] of the bits [offset, offset + length) of the bitmap packed into bytes,
+    // the bits following the last one are zero. Returns the number of written bytes
+    static uint64_t copyBits(const uint8_t* bitmap, const int64_t offset, const int64_t length,
+                             char* out, const uint64_t from, const uint64_t to) {
+        const int64_t end = std::min<int64_t>(8 * (to + 1), length);
+        if (end <= static_cast<int64_t>(8 * from)) return 0;
+        const uint64_t bytes = (end - 8 * from + 7) / 8;
+        memset(out, 0, bytes);
+        arrow::internal::CopyBitmap(bitmap, offset + 8 * from, end - 8 * from, reinterpret_cast<uint8_t*>(out), 0);
+        return bytes;
+    }
+
+    // Returns the slot of the k-th valid slot of the array
+    static int64_t findValidSlot(const arrow::ArraySpan& data, uint64_t k) {
+        const uint8_t* validity = data.buffers[0].data;
+        constexpr int64_t BLOCK_SIZE = 512;
+        int64_t slot = 0;
+        for (; slot + BLOCK_SIZE <= data.length; slot += BLOCK_SIZE) {
+            const uint64_t valid = arrow::internal::CountSetBits(validity, data.offset + slot, BLOCK_SIZE);
+            if (valid > k) break;
+            k -= valid;
+        }
+        for (;; slot++) {
+            if (arrow::bit_util::GetBit(validity, data.offset + slot) && k-- == 0) return slot;
+        }
+    }
+};
+// -------------------------------------------------------------------------------------
+// Plain encoding of the valid values of an array of the arrow type. Unsupported types have no encoder.
+// Every encoder writes the bytes [from, to] of the serialized valid values and computes their size.
+template <typename ArrowType>
+struct PlainEncoder;
+// -------------------------------------------------------------------------------------
+// Base of encoders of whole bytes per value, the Encoder writes the bytes [from, to] of the values of the
+// slots [begin, end), which are all valid. Runs of valid values are written at once.
+template <typename Encoder>
+struct ValidRunsEncoder {
+    static void writeValues(const arrow::ArraySpan& data, char* vec, const uint64_t from, const uint64_t to) {
+        if (data.GetNullCount() == 0) {
+            return Encoder::write(data, 0, data.length, vec, from, to);
+        }
+        int64_t slot = 0;
+        uint64_t position = 0;
+        if constexpr (requires { Encoder::getWidth(data); }) {
+            // the first value within the range is located by counting the valid slots
+            const uint64_t width = Encoder::getWidth(data);
+            slot = Bits::findValidSlot(data, from / width);
+            position = from / width * width;
+        }
+        arrow::internal::SetBitRunReader runs(data.buffers[0].data, data.offset + slot, data.length - slot);
+        for (arrow::internal::SetBitRun run = runs.NextRun(); !run.AtEnd() && position <= to; run = runs.NextRun()) {
+            const int64_t begin = slot + run.position;
+            const int64_t end = begin + run.length;
+            const uint64_t size = Encoder::getSize(data, begin, end);
+            if (size != 0 && position + size > from) {
+                const uint64_t runFrom = from > position ? from - position : 0;
+                const uint64_t runTo = std::min(to - position, size - 1);
+                Encoder::write(data, begin, end, vec, runFrom, runTo);
+                vec += runTo - runFrom + 1;
+            }
+            position += size;
+        }
+    }
+
+    static uint64_t getValuesSize(const arrow::ArraySpan& data) {
+        if (data.GetNullCount() == 0) {
+            return Encoder::getSize(data, 0, data.length);
+        }
+        uint64_t result = 0;
+        arrow::internal::SetBitRunReader runs(data.buffers[0].data, data.offset, data.length);
+        for (arrow::internal::SetBitRun run = runs.NextRun(); !run.AtEnd(); run = runs.NextRun()) {
+            result += Encoder::getSize(data, run.position, run.position + run.length);
+        }
+        return result;
+    }
+};
+// -------------------------------------------------------------------------------------
+// Values stored as they are, which can be borrowed instead of copied
+template <typename CType>
+struct FixedWidthEncoder : ValidRunsEncoder<FixedWidthEncoder<CType>> {
+    static bool isBorrowable(const arrow::DataType&) { return true; }
+    static uint64_t getWidth(const arrow::ArraySpan&) { return sizeof(CType); }
+    static uint64_t getSize(const arrow::ArraySpan&, const int64_t begin, const int64_t end) {
+        return (end - begin) * sizeof(CType);
+    }
+    static void write(const arrow::ArraySpan& data, const int64_t begin, const int64_t,
+                      char* vec, const uint64_t from, const uint64_t to) {
+        memcpy(vec, reinterpret_cast<const char*>(data.GetValues<CType>(1) + begin) + from, to - from + 1);
+    }
+};
+// -------------------------------------------------------------------------------------
+template <> struct PlainEncoder<arrow::Int32Type> : FixedWidthEncoder<int32_t> {};
+template <> struct PlainEncoder<arrow::Int64Type> : FixedWidthEncoder<int64_t> {};
+template <> struct PlainEncoder<arrow::FloatType> : FixedWidthEncoder<float> {};
+template <> struct PlainEncoder<arrow::DoubleType> : FixedWidthEncoder<double> {};
+template <> struct PlainEncoder<arrow::Date32Type> : FixedWidthEncoder<int32_t> {};
+// -------------------------------------------------------------------------------------
+// Parquet has no timestamps in seconds, the schema announces them in milliseconds
+template <>
+struct PlainEncoder<arrow::TimestampType> : ValidRunsEncoder<PlainEncoder<arrow::TimestampType>> {
+    static bool isBorrowable(const arrow::DataType& type) {
+        return static_cast<const arrow::TimestampType&>(type).unit() != arrow::TimeUnit::SECOND;
+    }
+    static uint64_t getWidth(const arrow::ArraySpan&) { return sizeof(int64_t); }
+    static uint64_t getSize(const arrow::ArraySpan&, const int64_t begin, const int64_t end) {
+        return (end - begin) * sizeof(int64_t);
+    }
+    static void write(const arrow::ArraySpan& data, const int64_t begin, const int64_t end,
+                      char* vec, const uint64_t from, const uint64_t to) {
+        if (isBorrowable(*data.type)) {
+            return FixedWidthEncoder<int64_t>::write(data, begin, end, vec, from, to);
+        }
+        const int64_t* values = data.GetValues<int64_t>(1) + begin;
+        for (uint64_t i = from / sizeof(int64_t); i <= to / sizeof(int64_t); i++) {
+            const int64_t millis = values[i] * 1000;
+            vec += Bits::copyClipped(vec, &millis, i * sizeof(int64_t), sizeof(int64_t), from, to);
+        }
+    }
+};
+// -------------------------------------------------------------------------------------
+// Decimals are fixed length byte arrays of the minimal length for their precision in big-endian order
+template <typename DecimalType>
+struct DecimalEncoder : ValidRunsEncoder<DecimalEncoder<DecimalType>> {
+    static uint64_t getWidth(const arrow::ArraySpan& data) {
+        return getByteLength(static_cast<const DecimalType&>(*data.type).precision());
+    }
+    static uint64_t getSize(const arrow::ArraySpan& data, const int64_t begin, const int64_t end) {
+        return (end - begin) * getWidth(data);
+    }
+    static void write(const arrow::ArraySpan& data, const int64_t begin, const int64_t,
+                      char* vec, const uint64_t from, const uint64_t to) {
+        const uint64_t width = getWidth(data);
+        const uint8_t* values = data.GetValues<uint8_t>(1, (data.offset + begin) * DecimalType::kByteWidth);
+        for (uint64_t position = from; position <= to; position++) {
+            // the least significant bytes of the little-endian value in reverse order
+            const uint64_t i = position / width;
+            *vec++ = values[i * DecimalType::kByteWidth + width - 1 - position % width];
+        }
+    }
+
+    static uint64_t getByteLength(const int32_t precision) {
+        return static_cast<uint64_t>(std::ceil((precision * std::log2(10.0) + 1) / 8));
+    }
+};
+// -------------------------------------------------------------------------------------
+template <> struct PlainEncoder<arrow::Decimal128Type> : DecimalEncoder<arrow::Decimal128Type> {};
+template <> struct PlainEncoder<arrow::Decimal256Type> : DecimalEncoder<arrow::Decimal256Type> {};
+// -------------------------------------------------------------------------------------
+// Strings and binaries are prefixed with their 4 byte length
+template <typename Offset>
+struct StringEncoder : ValidRunsEncoder<StringEncoder<Offset>> {
+    // Lengths of the 8 values following offsets
+    static void computeLengths(const Offset* offsets, int32_t* lengths) {
+#if defined(__AVX2__)
+        if constexpr (sizeof(Offset) == 4) {
+            const __m256i begins = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets));
+            const __m256i ends = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets + 1));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lengths), _mm256_sub_epi32(ends, begins));
+            return;
+        }
+#endif
+        for (int k = 0; k != 8; k++) {
+            lengths[k] = static_cast<int32_t>(offsets[k + 1] - offsets[k]);
+        }
+    }
+
+    // Copies short payloads with one or two unaligned 16 byte copies if up to slack bytes may be accessed,
+    // without SSE2 every payload is copied by its length
+    static void copyPayload(char* vec, const uint8_t* value, const int32_t length, const int64_t slack) {
+#if defined(__SSE2__)
+        if (length <= 16 && slack >= 16) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(vec), _mm_loadu_si128(reinterpret_cast<const __m128i*>(value)));
+            return;
+        }
+        if (length <= 32 && slack >= 32) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(vec), _mm_loadu_si128(reinterpret_cast<const __m128i*>(value)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(vec + 16),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(value + 16)));
+            return;
+        }
+#endif
+        memcpy(vec, value, length);
+    }
+
+    // Interleaves the lengths and payloads of the values [begin, end), which are written completely.
+    // Short payloads may be copied past their end, the bytes overrun are overwritten by the following values
+    // and the run never writes past its end, nor reads past the end of the data buffer.
+    static char* writeRun(const Offset* offsets, const uint8_t* data, const uint8_t* dataEnd,
+                          int64_t begin, const int64_t end, char* vec) {
+        const char* vecEnd = vec + 4 * (end - begin) + (offsets[end] - offsets[begin]);
+        int32_t lengths[8];
+        for (; begin + 8 <= end; begin += 8) {
+            computeLengths(offsets + begin, lengths);
+            for (int k = 0; k != 8; k++) {
+                const uint8_t* value = data + offsets[begin + k];
+                memcpy(vec, &lengths[k], sizeof(int32_t));
+                vec += sizeof(int32_t);
+                copyPayload(vec, value, lengths[k], std::min(vecEnd - vec, dataEnd - value));
+                vec += lengths[k];
+            }
+        }
+        for (; begin < end; begin++) {
+            const int32_t length = static_cast<int32_t>(offsets[begin + 1] - offsets[begin]);
+            memcpy(vec, &length, sizeof(int32_t));
+            vec += sizeof(int32_t);
+            memcpy(vec, data + offsets[begin], length);
+            vec += length;
+        }
+        return vec;
+    }
+
+    static uint64_t getSize(const arrow::ArraySpan& data, const int64_t begin, const int64_t end) {
+        const auto* offsets = data.GetValues<Offset>(1);
+        return 4 * (end - begin) + offsets[end] - offsets[begin];
+    }
+
+    static void write(const arrow::ArraySpan& data, const int64_t begin, const int64_t end,
+                      char* vec, const uint64_t from, const uint64_t to) {
+        const uint8_t* src = data.buffers[2].data;
+        const uint8_t* srcEnd = src ? src + data.buffers[2].size : nullptr;
+        const auto* offsets = data.GetValues<Offset>(1);
+        // value i is serialized at 4 * (i - begin) + offsets[i] - offsets[begin], the offsets locate the values
+        const auto position = [&](const int64_t i) -> uint64_t { return 4 * (i - begin) + offsets[i] - offsets[begin]; };
+        // the last value beginning at or before a position
+        const auto find = [&](const uint64_t pos) {
+            int64_t first = begin;
+            int64_t last = end;
+            while (first + 1 < last) {
+                const int64_t mid = (first + last) / 2;
+                if (position(mid) <= pos) first = mid; else last = mid;
+            }
+            return first;
+        };
+
+        int64_t i = find(from);
+        if (from != position(i) && i < end) {
+            // the range starts within the first value
+            const int32_t length = offsets[i+1] - offsets[i];
+            vec += Bits::copyClipped(vec, &length, position(i), sizeof(int32_t), from, to);
+            vec += Bits::copyClipped(vec, src + offsets[i], position(i) + 4, length, from, to);
+            i++;
+        }
+        // the values ending within the range are written completely
+        int64_t last = std::max(i, find(to + 1));
+        if (last < end && position(last + 1) <= to + 1) last++;
+        vec = writeRun(offsets, src, srcEnd, i, last, vec);
+        i = last;
+        if (i < end && position(i) <= to) {
+            // the range ends within the last value
+            const int32_t length = offsets[i+1] - offsets[i];
+            vec += Bits::copyClipped(vec, &length, position(i), sizeof(int32_t), from, to);
+            Bits::copyClipped(vec, src + offsets[i], position(i) + 4, length, from, to);
+        }
+    }
+};
+// -------------------------------------------------------------------------------------
+template <> struct PlainEncoder<arrow::StringType> : StringEncoder<int32_t> {};
+template <> struct PlainEncoder<arrow::BinaryType> : StringEncoder<int32_t> {};
+template <> struct PlainEncoder<arrow::LargeStringType> : StringEncoder<int64_t> {};
+template <> struct PlainEncoder<arrow::LargeBinaryType> : StringEncoder<int64_t> {};
+// -------------------------------------------------------------------------------------
+// Views have no offsets, the positions of their values are located by a scan of the lengths
+struct ViewEncoder : ValidRunsEncoder<ViewEncoder> {
+    static uint64_t getSize(const arrow::ArraySpan& data, const int64_t begin, const int64_t end) {
+        const auto* views = data.GetValues<arrow::BinaryViewType::c_type>(1);
+        uint64_t result = 4 * (end - begin);
+        for (int64_t i = begin; i != end; i++) result += views[i].size();
+        return result;
+    }
+
+    static void write(const arrow::ArraySpan& data, const int64_t begin, const int64_t end,
+                      char* vec, const uint64_t from, const uint64_t to) {
+        const auto* views = data.GetValues<arrow::BinaryViewType::c_type>(1);
+        uint64_t position = 0;
+        for (int64_t i = begin; i < end && position <= to; i++) {
+            const auto& view = views[i];
+            const int32_t length = view.size();
+            if (position + 4 + length > from) {
+                const uint8_t* value = view.is_inline() ? view.inline_data()
+                    : data.GetVariadicBuffers()[view.ref.buffer_index]->data() + view.ref.offset;
+                vec += Bits::copyClipped(vec, &length, position, sizeof(int32_t), from, to);
+                vec += Bits::copyClipped(vec, value, position + 4, length, from, to);
+            }
+            position += 4 + length;
+        }
+    }
+};
+// -------------------------------------------------------------------------------------
+template <> struct PlainEncoder<arrow::StringViewType> : ViewEncoder {};
+template <> struct PlainEncoder<arrow::BinaryViewType> : ViewEncoder {};
+// -------------------------------------------------------------------------------------
+// Booleans are bit-packed, the valid values are written bit by bit
+template <>
+struct PlainEncoder<arrow::BooleanType> {
+    static void writeValues(const arrow::ArraySpan& data, char* vec, const uint64_t from, const uint64_t to) {
+        const uint8_t* values = data.buffers[1].data;
+        if (data.GetNullCount() == 0) {
+            Bits::copyBits(values, data.offset, data.length, vec, from, to);
+            return;
+        }
+        // the valid values are compacted, the value of bit 8 * from is located by counting the valid slots
+        const int64_t firstBit = 8 * from;
+        const int64_t endBit = std::min<int64_t>(8 * (to + 1), data.length - data.GetNullCount());
+        const int64_t slot = Bits::findValidSlot(data, firstBit);
+        memset(vec, 0, (endBit - firstBit + 7) / 8);
+        int64_t position = firstBit;
+        arrow::internal::SetBitRunReader runs(data.buffers[0].data, data.offset + slot, data.length - slot);
+        for (arrow::internal::SetBitRun run = runs.NextRun(); !run.AtEnd() && position < endBit; run = runs.NextRun()) {
+            const int64_t length = std::min(run.length, endBit - position);
+            arrow::internal::CopyBitmap(values, data.offset + slot + run.position, length,
+                reinterpret_cast<uint8_t*>(vec), position - firstBit);
+            position += length;
+        }
+    }
+
+    static uint64_t getValuesSize(const arrow::ArraySpan& data) {
+        return (data.length - data.GetNullCount() + 7) / 8;
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
@@ -0,0 +1,250 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+// -------------------------------------------------------------------------------------
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+// -------------------------------------------------------------------------------------
+#include <parquet/schema.h>
+#include <parquet/types.h>
+// -------------------------------------------------------------------------------------
+#include "../Statistics.hpp"
+#include "BitPacking.hpp"
+#include "ParquetUtils.hpp"
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+// Encodings of values besides PLAIN, which re-encode the plain encoded values of a data page. The plain values are
+// the physical values of the column, s.t. the conversions of the plain encoder, e.g. of timestamps and decimals,
+// apply to all encodings. The deltas of DELTA_BINARY_PACKED are computed and reduced in loops the compiler
+// vectorizes and packed with the kernels of BitPacking, BYTE_STREAM_SPLIT of 4 and 8 byte values transposes
+// blocks of 16 values with SSSE3.
+class ValueEncoder {
+    static constexpr uint64_t BLOCK_SIZE = 128;
+    static constexpr uint64_t MINIBLOCKS = 4;
+    static constexpr uint64_t MINIBLOCK_SIZE = BLOCK_SIZE / MINIBLOCKS;
+
+    static void appendSignedVarint(std::vector<uint8_t>& out, const int64_t value) {
+        ParquetUtils::appendZigZagVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    // Packs 8 values of up to 64 bits, the kernels of BitPacking pack up to 32 bits
+    template <typename U>
+    static void packGroup(const U* in, const uint8_t bitWidth, uint8_t* out) {
+        if (bitWidth <= 32) return BitPacking::packGroup(in, bitWidth, out);
+        unsigned __int128 buffer = 0;
+        uint8_t bits = 0;
+        for (int i = 0; i != 8; i++) {
+            buffer |= static_cast<unsigned __int128>(in[i]) << bits;
+            bits += bitWidth;
+            for (; bits >= 8; bits -= 8) {
+                *out++ = static_cast<uint8_t>(buffer);
+                buffer >>= 8;
+            }
+        }
+    }
+
+    // Blocks of 128 deltas in 4 miniblocks of 32 deltas, each bit-packed with the bit width of its largest delta
+    // minus the smallest delta of the block. Deltas wrap around like the physical type
+    template <typename T>
+    static void appendDeltaBinaryPacked(const T* values, const uint64_t count, std::vector<uint8_t>& out) {
+        using U = std::make_unsigned_t<T>;
+        ParquetUtils::appendZigZagVarint(out, BLOCK_SIZE);
+        ParquetUtils::appendZigZagVarint(out, MINIBLOCKS);
+        ParquetUtils::appendZigZagVarint(out, count);
+        appendSignedVarint(out, count ? values[0] : 0);
+        U deltas[BLOCK_SIZE];
+        for (uint64_t begin = 1; begin < count; begin += BLOCK_SIZE) {
+            const uint64_t size = std::min(BLOCK_SIZE, count - begin);
+            T minDelta = std::numeric_limits<T>::max();
+            for (uint64_t i = 0; i != size; i++) {
+                deltas[i] = static_cast<U>(values[begin + i]) - static_cast<U>(values[begin + i - 1]);
+                minDelta = std::min(minDelta, static_cast<T>(deltas[i]));
+            }
+            // the padding of the last miniblock is 0
+            for (uint64_t i = 0; i != BLOCK_SIZE; i++) {
+                deltas[i] = i < size ? deltas[i] - static_cast<U>(minDelta) : 0;
+            }
+            appendSignedVarint(out, minDelta);
+            // the bit widths of miniblocks without deltas are 0 and the miniblocks are left out
+            const uint64_t miniblocks = (size + MINIBLOCK_SIZE - 1) / MINIBLOCK_SIZE;
+            uint8_t bitWidths[MINIBLOCKS] = {};
+            for (uint64_t m = 0; m != miniblocks; m++) {
+                U bits = 0;
+                for (uint64_t i = 0; i != MINIBLOCK_SIZE; i++) bits |= deltas[m * MINIBLOCK_SIZE + i];
+                bitWidths[m] = std::bit_width(bits);
+            }
+            out.insert(out.end(), bitWidths, bitWidths + MINIBLOCKS);
+            for (uint64_t m = 0; m != miniblocks; m++) {
+                uint64_t offset = out.size();
+                out.resize(offset + MINIBLOCK_SIZE / 8 * bitWidths[m]);
+                for (uint64_t g = 0; g != MINIBLOCK_SIZE / 8; g++, offset += bitWidths[m]) {
+                    packGroup(deltas + m * MINIBLOCK_SIZE + g * 8, bitWidths[m], out.data() + offset);
+                }
+            }
+        }
+    }
+
+    // The plain values are prefixed by their 4 byte lengths
+    static void appendDeltaLengthByteArray(const uint8_t* plain, const uint64_t size, std::vector<uint8_t>& out) {
+        std::vector<int32_t> lengths;
+        lengths.reserve(size / sizeof(int32_t));
+        for (uint64_t offset = 0; offset < size; ) {
+            int32_t length;
+            memcpy(&length, plain + offset, sizeof(length));
+            lengths.push_back(length);
+            offset += sizeof(length) + length;
+        }
+        // the bytes follow the few bytes of the lengths without growing the output again
+        out.reserve(out.size() + size);
+        appendDeltaBinaryPacked(lengths.data(), lengths.size(), out);
+        uint64_t position = out.size();
+        out.resize(position + size - lengths.size() * sizeof(int32_t));
+        const uint8_t* value = plain;
+        for (const int32_t length : lengths) {
+            memcpy(out.data() + position, value + sizeof(int32_t), length);
+            position += length;
+            value += sizeof(int32_t) + length;
+        }
+    }
+
+    static void writeByteStreamSplitScalar(const uint8_t* plain, const uint64_t begin, const uint64_t count,
+                                           const uint64_t width, uint8_t* out) {
+        for (uint64_t b = 0; b != width; b++) {
+            for (uint64_t i = begin; i != count; i++) out[b * count + i] = plain[i * width + b];
+        }
+    }
+
+    // Byte b of value i is written to out[b * count + i]
+    static void writeByteStreamSplit(const uint8_t* plain, const uint64_t count, const uint64_t width, uint8_t* out) {
+        uint64_t i = 0;
+#if defined(__SSSE3__)
+        const auto load = [&](const uint64_t offset, const __m128i mask) {
+            return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(plain + offset)), mask);
+        };
+        const auto store = [&](const uint64_t b, const __m128i stream) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + b * count + i), stream);
+        };
+        if (width == 4) {
+            // lane b of a register holds byte b of its 4 values, the transposition gathers the lanes b
+            const __m128i mask = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+            for (; i + 16 <= count; i += 16) {
+                const __m128i r0 = load(4 * i, mask), r1 = load(4 * i + 16, mask);
+                const __m128i r2 = load(4 * i + 32, mask), r3 = load(4 * i + 48, mask);
+                const __m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpackhi_epi32(r0, r1);
+                const __m128i t2 = _mm_unpacklo_epi32(r2, r3), t3 = _mm_unpackhi_epi32(r2, r3);
+                store(0, _mm_unpacklo_epi64(t0, t2));
+                store(1, _mm_unpackhi_epi64(t0, t2));
+                store(2, _mm_unpacklo_epi64(t1, t3));
+                store(3, _mm_unpackhi_epi64(t1, t3));
+            }
+        } else if (width == 8) {
+            // word b of a register holds byte b of its 2 values, the transposition gathers the words b
+            const __m128i mask = _mm_setr_epi8(0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15);
+            for (; i + 16 <= count; i += 16) {
+                __m128i r[8];
+                for (int k = 0; k != 8; k++) r[k] = load(8 * i + 16 * k, mask);
+                __m128i a[8];
+                for (int k = 0; k != 4; k++) {
+                    a[2 * k] = _mm_unpacklo_epi16(r[2 * k], r[2 * k + 1]);
+                    a[2 * k + 1] = _mm_unpackhi_epi16(r[2 * k], r[2 * k + 1]);
+                }
+                const __m128i b0 = _mm_unpacklo_epi32(a[0], a[2]), b1 = _mm_unpackhi_epi32(a[0], a[2]);
+                const __m128i b2 = _mm_unpacklo_epi32(a[1], a[3]), b3 = _mm_unpackhi_epi32(a[1], a[3]);
+                const __m128i b4 = _mm_unpacklo_epi32(a[4], a[6]), b5 = _mm_unpackhi_epi32(a[4], a[6]);
+                const __m128i b6 = _mm_unpacklo_epi32(a[5], a[7]), b7 = _mm_unpackhi_epi32(a[5], a[7]);
+                store(0, _mm_unpacklo_epi64(b0, b4));
+                store(1, _mm_unpackhi_epi64(b0, b4));
+                store(2, _mm_unpacklo_epi64(b1, b5));
+                store(3, _mm_unpackhi_epi64(b1, b5));
+                store(4, _mm_unpacklo_epi64(b2, b6));
+                store(5, _mm_unpackhi_epi64(b2, b6));
+                store(6, _mm_unpacklo_epi64(b3, b7));
+                store(7, _mm_unpackhi_epi64(b3, b7));
+            }
+        }
+#endif
+        writeByteStreamSplitScalar(plain, i, count, width, out);
+    }
+
+public:
+    // Value of the encoding in page headers
+    static uint8_t getEncodingId(const ValueEncoding encoding) {
+        switch (encoding) {
+            case ValueEncoding::PLAIN: return PLAIN_ENCODING;
+            case ValueEncoding::DELTA_BINARY_PACKED: return DELTA_BINARY_PACKED_ENCODING;
+            case ValueEncoding::DELTA_LENGTH_BYTE_ARRAY: return DELTA_LENGTH_BYTE_ARRAY_ENCODING;
+            case ValueEncoding::BYTE_STREAM_SPLIT: return BYTE_STREAM_SPLIT_ENCODING;
+        }
+        throw std::logic_error{"unknown encoding"};
+    }
+
+    static parquet::Encoding::type getParquetEncoding(const ValueEncoding encoding) {
+        return static_cast<parquet::Encoding::type>(getEncodingId(encoding));
+    }
+
+    // Encodings other than PLAIN of the column. BYTE_STREAM_SPLIT does not change the size of the values and only
+    // pays off with compression
+    static std::vector<ValueEncoding> getCandidates(const parquet::ColumnDescriptor& descriptor, const bool compressed) {
+        std::vector<ValueEncoding> result;
+        switch (descriptor.physical_type()) {
+            case parquet::Type::INT32:
+            case parquet::Type::INT64:
+                result.push_back(ValueEncoding::DELTA_BINARY_PACKED);
+                if (compressed) result.push_back(ValueEncoding::BYTE_STREAM_SPLIT);
+                break;
+            case parquet::Type::FLOAT:
+            case parquet::Type::DOUBLE:
+            case parquet::Type::FIXED_LEN_BYTE_ARRAY:
+                if (compressed) result.push_back(ValueEncoding::BYTE_STREAM_SPLIT);
+                break;
+            case parquet::Type::BYTE_ARRAY:
+                result.push_back(ValueEncoding::DELTA_LENGTH_BYTE_ARRAY);
+                break;
+            default:
+                break;
+        }
+        return result;
+    }
+
+    // Appends the plain encoded values of the column in the encoding, which has to be a candidate of the column
+    static void appendEncoded(const ValueEncoding encoding, const parquet::ColumnDescriptor& descriptor,
+                              const uint8_t* plain, const uint64_t size, std::vector<uint8_t>& out) {
+        const parquet::Type::type physicalType = descriptor.physical_type();
+        switch (encoding) {
+            case ValueEncoding::PLAIN:
+                out.insert(out.end(), plain, plain + size);
+                return;
+            case ValueEncoding::DELTA_BINARY_PACKED:
+                if (physicalType == parquet::Type::INT32) {
+                    std::vector<int32_t> values(size / sizeof(int32_t));
+                    memcpy(values.data(), plain, size);
+                    return appendDeltaBinaryPacked(values.data(), values.size(), out);
+                } else {
+                    std::vector<int64_t> values(size / sizeof(int64_t));
+                    memcpy(values.data(), plain, size);
+                    return appendDeltaBinaryPacked(values.data(), values.size(), out);
+                }
+            case ValueEncoding::DELTA_LENGTH_BYTE_ARRAY:
+                return appendDeltaLengthByteArray(plain, size, out);
+            case ValueEncoding::BYTE_STREAM_SPLIT: {
+                const uint64_t width = physicalType == parquet::Type::FIXED_LEN_BYTE_ARRAY
+                    ? descriptor.type_length() : parquet::GetTypeByteSize(physicalType);
+                const uint64_t offset = out.size();
+                out.resize(offset + size);
+                return writeByteStreamSplit(plain, size / width, width, out.data() + offset);
+            }
+        }
+    }
+};
+// -------------------------------------------------------------------------------------
+} // namespace virtualfile
+// -------------------------------------------------------------------------------------
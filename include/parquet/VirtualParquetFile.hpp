@@ -1,240 +1,1165 @@
 #pragma once
 // -------------------------------------------------------------------------------------
+#include <algorithm>
+#include <bit>
+#include <map>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <unordered_map>
+// -------------------------------------------------------------------------------------
+#include <arrow/io/memory.h>
+#include <arrow/util/compression.h>
+#include <arrow/util/parallel.h>
 #include <parquet/metadata.h>
+#include <parquet/page_index.h>
+#include <parquet/size_statistics.h>
+#include <parquet/statistics.h>
 #include <parquet/arrow/schema.h>
 // -------------------------------------------------------------------------------------
+#include "../ChunkCache.hpp"
+#include "../LayoutSnapshot.hpp"
 #include "../VirtualFile.hpp"
 #include "ColumnChunkWriter.hpp"
 #include "ParquetUtils.hpp"
+#include "ValueEncoder.hpp"
 
 // -------------------------------------------------------------------------------------
 namespace virtualfile {
 // -------------------------------------------------------------------------------------
 enum PageType { DATA_PAGE_TYPE, DICTIONARY_PAGE_TYPE };
+// Selection of the encodings of the values of chunks, which are not dictionary encoded
+enum class EncodingPolicy {
+    // plain values, which are served without serializing the chunks first
+    PLAIN,
+    // the encoding of the fewest bytes per chunk, which is selected by serializing every chunk once in all encodings
+    // of its physical type at construction. Chunks in other encodings than PLAIN are served from the cache
+    SMALLEST
+};
+// -------------------------------------------------------------------------------------
+struct VirtualParquetFileOptions {
+    // Thread pool used to serialize the column chunks of large ranges in parallel,
+    // e.g. arrow::internal::ThreadPool::Make(n). Without one all chunks are serialized by the caller
+    std::shared_ptr<arrow::internal::Executor> executor = nullptr;
+    // Minimum number of column chunks a range has to touch to be serialized in parallel
+    uint64_t minParallelChunks = 4;
+    // Cache of serialized column chunks, may be shared between files. Without one every
+    // request serializes the chunks it touches again
+    std::shared_ptr<ChunkCache> cache = nullptr;
+    // Number of column chunks read ahead once a sequential scan over the chunks is detected, 0 disables readahead
+    uint64_t readaheadChunks = 0;
+    // Executor the chunks are read ahead on, defaults to a pool with one thread per chunk read ahead
+    std::shared_ptr<arrow::internal::Executor> ioExecutor = nullptr;
+    // Codec of the data pages of all columns not listed in columnCompression. The compressed size of every chunk is
+    // computed at construction unless given in its ChunkInfo, compressed chunks are served from the cache. Columns
+    // with dictionary encoded chunks are left uncompressed, naming them in columnCompression is an error
+    arrow::Compression::type compression = arrow::Compression::UNCOMPRESSED;
+    std::unordered_map<uint64_t, arrow::Compression::type> columnCompression = {};
+    // Writes a ColumnIndex and an OffsetIndex of every column chunk between the last chunk and the footer,
+    // s.t. readers can prune pages. Column indexes require the zone maps of all chunks of the column
+    bool writePageIndex = false;
+    // Maximum number of rows of a data page, 0 does not limit the rows
+    uint64_t pageRows = 0;
+    // Target size of the values of a data page in bytes, 0 does not limit the size. All data pages of a chunk hold
+    // the same number of rows, the size of pages of variable width values is approximate
+    uint64_t pageSize = 0;
+    // Trades the CPU time of serializing the chunks in other encodings than PLAIN for fewer bytes. The encoding of
+    // every chunk is selected at construction unless given in its ChunkInfo
+    EncodingPolicy encodingPolicy = EncodingPolicy::PLAIN;
+    // Fraction of the bytes of the plain chunk another encoding has to save to be selected
+    double minEncodingSavings = 0.1;
+};
 // -------------------------------------------------------------------------------------
 class VirtualParquetFile final : public VirtualFile {
     static constexpr uint64_t MAGIC_NUMBER_SIZE = 4;
     static constexpr uint64_t FOOTER_LENGTH_SIZE = 4;
 
     std::shared_ptr<parquet::SchemaDescriptor> schemaDescriptor;
-    std::unique_ptr<parquet::FileMetaData> metadata;
-    std::unique_ptr<parquet::FileMetaDataBuilder> metadataBuilder;
-    parquet::RowGroupMetaDataBuilder* rowgroupBuilder = nullptr;
+    static constexpr uint64_t DEFAULT_COMPRESSED_CACHE_SIZE = 256ull << 20;
+
     uint64_t fileOffset = MAGIC_NUMBER_SIZE;
-    uint64_t metadataOffset;
-    uint64_t rowGroupSize;
-    std::string serializedMetadata;
-    std::string buffer;
-    std::vector<char> currBuffer;
+    // page index followed by the serialized metadata, its length and the magic number
+    std::shared_ptr<arrow::Buffer> footer;
+    // Begin offsets of all column chunks in file order (rowgroup-major) followed by the offset of the
+    // footer, s.t. the chunk (i, j) spans [chunkOffsets[i * numColumns + j], chunkOffsets[i * numColumns + j + 1])
+    std::vector<uint64_t> chunkOffsets;
+    const VirtualParquetFileOptions options;
+    // codec of every column
+    std::vector<arrow::Compression::type> codecs;
+    // the cache given in the options or one for the compressed chunks
+    std::shared_ptr<ChunkCache> cache;
+    // identifies the chunks of this file in the cache
+    uint64_t fileId = 0;
+
+    // Page of a column chunk, the dictionary page of dictionary encoded chunks precedes the data pages
+    struct Page {
+        // offset of the page within the chunk
+        uint64_t offset;
+        uint64_t size;
+        // size of the page with an uncompressed body
+        uint64_t uncompressedSize;
+        // rows of the chunk within the data page, the dictionary values of a dictionary page
+        uint64_t firstRow;
+        uint64_t rows;
+        uint64_t nulls;
+        // page header followed by the definition levels of uncompressed data pages within the headers
+        uint64_t headerOffset;
+        uint32_t headerSize;
+        PageType type;
+    };
+    // pages of all column chunks in file order, the pages of chunk k are [chunkPages[k], chunkPages[k + 1])
+    std::vector<Page> pages;
+    std::vector<uint64_t> chunkPages;
+    // headers of all pages, which are appended to the arena while the pages are registered
+    std::vector<uint8_t> headerArena;
+    std::shared_ptr<arrow::Buffer> headers;
 
+    struct Readahead {
+        std::mutex mutex;
+        std::shared_ptr<arrow::internal::Executor> executor;
+        // the chunk a sequential scan requests next
+        uint64_t nextChunk = 0;
+        // chunks read ahead and not yet requested
+        std::unordered_map<uint64_t, arrow::Future<std::shared_ptr<arrow::Array>>> chunks;
+        // reads of chunks the scan skipped, which may still use the reader until they finish
+        std::vector<arrow::Future<std::shared_ptr<arrow::Array>>> dropped;
+    };
+    mutable Readahead readahead;
+
+    // views serve their chunks from the file and serialize their footer like it
+    friend class VirtualParquetFileView;
+
+    // The footer is serialized once all chunks are registered
     uint64_t predictMetadataOverhead() override {
-        return 2 * MAGIC_NUMBER_SIZE + serializedMetadata.size() + FOOTER_LENGTH_SIZE;
+        chunkOffsets.push_back(fileOffset);
+        chunkPages.push_back(pages.size());
+        std::vector<uint64_t> columns(numColumns);
+        std::vector<uint64_t> rowgroups(numRowgroups);
+        for (size_t j = 0; j != numColumns; j++) columns[j] = j;
+        for (size_t i = 0; i != numRowgroups; i++) rowgroups[i] = i;
+        footer = writeFooter(*schemaDescriptor, columns, rowgroups, chunkOffsets);
+        return MAGIC_NUMBER_SIZE + footer->size();
     }
 
-    ChunkInfo predictChunkInfo(const ChunkInfo &info) override {
-        ChunkInfo predicted;
-        predicted.tuple_count = info.tuple_count;
-        if (info.dictionary_chunk_info) {
-            // todo
-            predicted.dictionary_chunk_info = info.dictionary_chunk_info;
-            assert(false);
-        }else{
-            predicted.uncompressed_size = getSize(info);
+    ChunkInfo predictChunkInfo(const size_t column, const ChunkInfo &info) const override {
+        ChunkInfo predicted = info;
+        predicted.uncompressed_size = 0;
+        uint64_t size = 0;
+        visitPages(column, info, [&](const Page& page) {
+            predicted.uncompressed_size += page.uncompressedSize;
+            size += page.size;
+        });
+        if (info.compressed_size) {
+            predicted.compressed_size = size;
         }
         return predicted;
     }
 
-    void registerPrecomputedSize(const size_t rowgroup, const size_t column, const ChunkInfo predictedInfo) override {
-        if (column == 0) {
-            rowgroupBuilder = metadataBuilder->AppendRowGroup();
-            rowgroupBuilder->set_num_rows(predictedInfo.tuple_count);
-            rowGroupSize = 0;
-        }
+    void registerPrecomputedSize(const size_t, const size_t column, const ChunkInfo predictedInfo) override {
+        chunkOffsets.push_back(fileOffset);
+        chunkPages.push_back(pages.size());
+        visitPages(column, predictedInfo, [&](const Page& page) { pages.push_back(page); }, &headerArena);
+        fileOffset += predictedInfo.compressed_size.value_or(predictedInfo.uncompressed_size);
+    }
 
-        parquet::ColumnChunkMetaDataBuilder* chunkBuilder = rowgroupBuilder->NextColumnChunk();
-        // TODO fix zone maps
-        // TODO allow dictionary encoded data
-        chunkBuilder->Finish(predictedInfo.tuple_count,
-            -1, -1, fileOffset,
-            predictedInfo.uncompressed_size, predictedInfo.uncompressed_size,
-            false, false, {}, {});
+    // Serializes the footer of the chunks of the columns and rowgroups, which are placed in rowgroup-major order at
+    // the given offsets followed by the footer at offsets.back(). The descriptor is the schema of the columns.
+    // Returns the page index followed by the serialized metadata, its length and the magic number
+    std::shared_ptr<arrow::Buffer> writeFooter(const parquet::SchemaDescriptor& descriptor,
+                                               const std::span<const uint64_t> columns,
+                                               const std::span<const uint64_t> rowgroups,
+                                               const std::span<const uint64_t> offsets) const {
+        // the codecs are announced in the metadata of the column chunks
+        parquet::WriterProperties::Builder writerPropsBuilder;
+        for (size_t c = 0; c != columns.size(); c++) {
+            writerPropsBuilder.compression(descriptor.Column(c)->path(), codecs[columns[c]]);
+        }
+        const auto metadataBuilder = parquet::FileMetaDataBuilder::Make(&descriptor, writerPropsBuilder.build());
+        const auto pageIndexBuilder = options.writePageIndex ? parquet::PageIndexBuilder::Make(&descriptor) : nullptr;
+        const uint64_t footerOffset = offsets.back();
+        for (size_t r = 0; r != rowgroups.size(); r++) {
+            const uint64_t i = rowgroups[r];
+            parquet::RowGroupMetaDataBuilder* rowgroupBuilder = metadataBuilder->AppendRowGroup();
+            rowgroupBuilder->set_num_rows(chunkInfos[columns[0]][i].tuple_count);
+            if (pageIndexBuilder) pageIndexBuilder->AppendRowGroup();
+            uint64_t uncompressedSize = 0;
+            for (size_t c = 0; c != columns.size(); c++) {
+                const uint64_t j = columns[c];
+                const uint64_t k = i * numColumns + j;
+                const ChunkInfo& info = chunkInfos[j][i];
+                const uint64_t offset = offsets[r * columns.size() + c];
+                const std::span<const Page> chunk(pages.begin() + chunkPages[k], pages.begin() + chunkPages[k + 1]);
+                const uint64_t chunkSize = chunkOffsets[k + 1] - chunkOffsets[k];
+                uint64_t chunkUncompressedSize = 0;
+                for (const Page& page : chunk) chunkUncompressedSize += page.uncompressedSize;
+                uncompressedSize += chunkUncompressedSize;
 
+                parquet::ColumnChunkMetaDataBuilder* chunkBuilder = rowgroupBuilder->NextColumnChunk();
+                chunkBuilder->SetStatistics(getStatistics(j, *descriptor.Column(c), info.zone_map, info.tuple_count,
+                    info.null_count));
+                const int32_t numDataPages = info.pages.size();
+                if (info.dictionary_chunk_info) {
+                    // the dictionary page precedes the data pages
+                    chunkBuilder->Finish(info.tuple_count,
+                        offset, -1, offset + chunk[1].offset,
+                        chunkSize, chunkUncompressedSize,
+                        true, false, {{parquet::Encoding::PLAIN, 1}}, {{parquet::Encoding::PLAIN_DICTIONARY, numDataPages}});
+                } else {
+                    const auto encoding = ValueEncoder::getParquetEncoding(info.encoding.value_or(ValueEncoding::PLAIN));
+                    chunkBuilder->Finish(info.tuple_count,
+                        -1, -1, offset,
+                        chunkSize, chunkUncompressedSize,
+                        false, false, {}, {{encoding, numDataPages}});
+                }
+                if (pageIndexBuilder) {
+                    // the zone map of the chunk bounds the values of all of its pages
+                    parquet::ColumnIndexBuilder* columnIndex = pageIndexBuilder->GetColumnIndexBuilder(c);
+                    parquet::OffsetIndexBuilder* offsetIndex = pageIndexBuilder->GetOffsetIndexBuilder(c);
+                    for (const Page& page : chunk) {
+                        if (page.type == DICTIONARY_PAGE_TYPE) continue;
+                        columnIndex->AddPage(getStatistics(j, *descriptor.Column(c), info.zone_map, page.rows, page.nulls), {});
+                        offsetIndex->AddPage(offset + page.offset, page.size, page.firstRow);
+                    }
+                    columnIndex->Finish();
+                    offsetIndex->Finish(0);
+                }
+            }
+            rowgroupBuilder->Finish(uncompressedSize);
+        }
+        // the page index is placed right after the last chunk
+        std::string pageIndex;
+        if (pageIndexBuilder) {
+            pageIndexBuilder->Finish();
+            PARQUET_ASSIGN_OR_THROW(auto sink, arrow::io::BufferOutputStream::Create());
+            parquet::PageIndexBuilder::WriteResult locations = pageIndexBuilder->WriteTo(sink.get());
+            PARQUET_ASSIGN_OR_THROW(const auto buffer, sink->Finish());
+            pageIndex = buffer->ToString();
+            for (auto* indexLocations : {&locations.column_index_locations, &locations.offset_index_locations}) {
+                for (auto& [chunk, location] : *indexLocations) location.offset += footerOffset;
+            }
+            metadataBuilder->SetIndexLocations(parquet::IndexKind::kColumnIndex, locations.column_index_locations);
+            metadataBuilder->SetIndexLocations(parquet::IndexKind::kOffsetIndex, locations.offset_index_locations);
+        }
+        const std::string serializedMetadata = metadataBuilder->Finish()->SerializeToString();
+        std::string result = pageIndex + serializedMetadata + "xxxxPAR1";
+        const int32_t s = serializedMetadata.size();
+        memcpy(result.data() + result.size() - FOOTER_LENGTH_SIZE - MAGIC_NUMBER_SIZE, &s, FOOTER_LENGTH_SIZE);
+        return arrow::Buffer::FromString(std::move(result));
+    }
 
-        fileOffset += predictedInfo.uncompressed_size;
-        if (column == numColumns - 1) {
-            rowgroupBuilder->Finish(predictedInfo.uncompressed_size);
+    // Min and max of the zone map in the plain encoding of the physical type, the zone map holds the value
+    // in the representation of the arrow type. Strings and decimals do not fit into the zone map
+    std::optional<std::string> encodeZoneMapValue(const size_t column, const std::array<std::byte, 8>& value) const {
+        const std::shared_ptr<arrow::DataType> type = getValueType(column);
+        const char* bytes = reinterpret_cast<const char*>(value.data());
+        switch (type->id()) {
+            case arrow::Type::BOOL:
+                return std::string(1, value[0] != std::byte{0} ? 1 : 0);
+            case arrow::Type::INT32:
+            case arrow::Type::DATE32:
+            case arrow::Type::FLOAT:
+                return std::string(bytes, 4);
+            case arrow::Type::INT64:
+            case arrow::Type::DOUBLE:
+                return std::string(bytes, 8);
+            case arrow::Type::TIMESTAMP: {
+                // seconds are stored as milliseconds
+                int64_t timestamp;
+                memcpy(&timestamp, bytes, sizeof(timestamp));
+                if (static_cast<const arrow::TimestampType&>(*type).unit() == arrow::TimeUnit::SECOND) timestamp *= 1000;
+                return std::string(reinterpret_cast<const char*>(&timestamp), sizeof(timestamp));
+            }
+            default:
+                return std::nullopt;
         }
-        if (rowgroup == numRowgroups - 1 && column == numColumns - 1) {
-            metadata = metadataBuilder->Finish();
+    }
+
+    // Statistics of a column chunk or page, min and max are only known if the chunk info has a zone map
+    parquet::EncodedStatistics getStatistics(const size_t column, const parquet::ColumnDescriptor& descriptor,
+                                             const std::optional<ZoneMap>& zoneMap,
+                                             const uint64_t tupleCount, const uint64_t nullCount) const {
+        parquet::EncodedStatistics result;
+        result.set_null_count(nullCount);
+        result.all_null_value = nullCount == tupleCount;
+        result.set_is_signed(descriptor.sort_order() == parquet::SortOrder::SIGNED);
+        if (zoneMap && !result.all_null_value) {
+            const auto min = encodeZoneMapValue(column, zoneMap->min_value);
+            const auto max = encodeZoneMapValue(column, zoneMap->max_value);
+            if (min && max) {
+                result.set_min(*min);
+                result.set_max(*max);
+            }
         }
+        return result;
+    }
+
+    // Indices of up to uniqueValues values, a single unique value needs no bits at all
+    static uint8_t getBitWidth(const uint64_t uniqueValues) {
+        return uniqueValues > 1 ? std::bit_width(uniqueValues - 1) : 0;
+    }
+
+    ParquetUtils::DefinitionLevels getDefinitionLevels(const size_t column, const uint64_t num_values,
+                                                       const uint64_t null_count) const {
+        return ParquetUtils::getDefinitionLevels(schema->field(column)->nullable(), num_values, null_count);
+    }
+
+    // size of the body of the data page holding the bit-packed indices of the valid values
+    [[nodiscard]] uint64_t getDictEncodedDataSize(const size_t column, const uint64_t num_values,
+                                                  const uint64_t null_count, const uint8_t bitWidth) const {
+        return ParquetUtils::getDefinitionLevelsSize(num_values, getDefinitionLevels(column, num_values, null_count))
+            + ParquetUtils::getDictionaryIndicesPrefixSize(num_values - null_count, bitWidth)
+            + BitPacking::getPackedSize(num_values - null_count, bitWidth);
     }
-    // TODO deduplicate logic
-    [[nodiscard]] uint64_t getDataSize(const int rowgroup, const int column) const {
-        const auto& info = chunkInfos[column][rowgroup];
-        uint64_t result = info.uncompressed_size;
-        if (metadata->schema()->Column(column)->logical_type() == parquet::LogicalType::String()) {
-            result -= 4;
+
+    // type of the values of the column, i.e. the type of the dictionary of dictionary encoded columns
+    std::shared_ptr<arrow::DataType> getValueType(const size_t column) const {
+        const std::shared_ptr<arrow::DataType>& type = schema->field(column)->type();
+        if (arrow::is_dictionary(type->id())) {
+            return std::static_pointer_cast<arrow::DictionaryType>(type)->value_type();
         }
-        return result + 5 + ParquetUtils::GetVarintSize(info.tuple_count << 1);
+        return type;
     }
 
-    [[nodiscard]] static uint64_t getDictEncodedDataSize(uint64_t num_values, uint64_t num_unique_values) {
-        const uint8_t byteLength = (std::bit_width(num_unique_values) + 7) / 8;
-        return num_values * byteLength + 6 + ParquetUtils::GetVarintSize(num_values << 1) + ParquetUtils::GetVarintSize(((num_values + 7 )/ 8) << 1 | 1);
+    // size of count plain encoded values of the column, which is only known for fixed width values
+    [[nodiscard]] std::optional<uint64_t> getFixedValuesSize(const size_t column, const uint64_t count) const {
+        const std::shared_ptr<arrow::DataType> type = getValueType(column);
+        if (type->id() == arrow::Type::BOOL) {
+            return (count + 7) / 8;
+        }
+        if (arrow::is_decimal(type->id())) {
+            const auto& decimal = static_cast<const arrow::DecimalType&>(*type);
+            return count * DecimalEncoder<arrow::Decimal128Type>::getByteLength(decimal.precision());
+        }
+        if (type->byte_width() > 0) {
+            return count * type->byte_width();
+        }
+        return std::nullopt;
     }
 
-    [[nodiscard]] static uint64_t getDataSize(const std::shared_ptr<arrow::Array>& arr, bool isDictionary) {
-        uint64_t result;
-        if (isDictionary || arr->type() == arrow::utf8()) {
-            int64_t tuple_count = arr->data()->length;
-            const auto* offsets = reinterpret_cast<const int32_t*>(arr->data()->buffers[1]->data());
-            result = tuple_count * 4 + offsets[tuple_count];
-        }else {
-            result = arr->length() * arr->type()->byte_width();
+    // size of the plain encoded dictionary, the length of the unique values is only needed for strings
+    [[nodiscard]] uint64_t getDictionaryValuesSize(const size_t column, const DictionaryChunkInfo& info) const {
+        if (const auto size = getFixedValuesSize(column, info.unique_values_count)) {
+            return *size;
         }
-        if (isDictionary) return result;
-        return result + 5 + ParquetUtils::GetVarintSize(arr->length() << 1);
+        return info.unique_values_length + info.unique_values_count * sizeof(int32_t);
     }
 
-    uint64_t getSize(const ChunkInfo& info) const {
-        uint64_t result = info.uncompressed_size;
-        // TODO if ( == btrblocks::ColumnType::STRING) result -= 4;
-        return result + ParquetUtils::writePageWithoutData(info.uncompressed_size, info.tuple_count).size();
+    // size of the page body, i.e. the definition levels followed by the values
+    [[nodiscard]] uint64_t getPageSize(const size_t column, const uint64_t num_values, const uint64_t null_count,
+                                       const uint64_t valuesSize) const {
+        return ParquetUtils::getDefinitionLevelsSize(num_values, getDefinitionLevels(column, num_values, null_count))
+            + valuesSize;
     }
 
-    [[nodiscard]] static uint64_t getDictionarySize(uint64_t num_unique_values, uint64_t total_length) {
-        const uint64_t dataSize = total_length + num_unique_values * sizeof(int32_t);
-        return dataSize + ParquetUtils::writePageWithoutData(dataSize, num_unique_values, true).size();
+    [[nodiscard]] uint64_t getPageSize(const size_t column, const std::shared_ptr<arrow::Array>& arr) const {
+        return getPageSize(column, arr->length(), arr->null_count(), ColumnChunkWriter::getValuesSize(arr));
     }
 
-    void writeChunk(
-            int64_t chunkBegin, const int64_t chunkEnd, const ByteRange byteRange,
-            const std::shared_ptr<arrow::Array>& arr, size_t &offset,
-            bool isDictionaryPage, size_t uncompressed_size, uint64_t unique_values = 0) {
-        if (!(chunkEnd < byteRange.begin || chunkBegin > byteRange.end)) {
-            const int64_t begin = std::max(chunkBegin, byteRange.begin);
-            const int64_t end = std::min(chunkEnd, byteRange.end);
-            // should not be needed, but warns if a reader does something unexpected
-            assert(begin == chunkBegin);
-            assert(end == chunkEnd);
+    // Calls f for all pages of the chunk in file order, which only depend on the chunk info. The headers are
+    // appended to the arena if one is given, the sizes of the pages are computed without writing them
+    template <typename F>
+    void visitPages(const size_t column, const ChunkInfo& info, F&& f, std::vector<uint8_t>* arena = nullptr) const {
+        uint64_t offset = 0;
+        uint8_t bitWidth = 0;
+        const bool isDictionaryEncoded = info.dictionary_chunk_info.has_value();
+        if (isDictionaryEncoded) {
+            const uint64_t uniqueValues = info.dictionary_chunk_info->unique_values_count;
+            const uint64_t valuesSize = getDictionaryValuesSize(column, *info.dictionary_chunk_info);
+            const uint64_t headerSize = ParquetUtils::getPageHeaderSize(valuesSize, valuesSize, uniqueValues, true);
+            const uint64_t size = headerSize + valuesSize;
+            f(Page{offset, size, size, 0, uniqueValues, 0, arena ? arena->size() : 0,
+                static_cast<uint32_t>(headerSize), DICTIONARY_PAGE_TYPE});
+            if (arena) ParquetUtils::appendPageHeader(*arena, valuesSize, valuesSize, uniqueValues, true);
+            offset += size;
+            bitWidth = getBitWidth(uniqueValues);
+        }
+        const uint8_t encoding = isDictionaryEncoded ? PLAIN_DICTIONARY_ENCODING
+            : ValueEncoder::getEncodingId(info.encoding.value_or(ValueEncoding::PLAIN));
+        uint64_t firstRow = 0;
+        for (const PageInfo& page : info.pages) {
+            const auto levels = getDefinitionLevels(column, page.tuple_count, page.null_count);
+            const uint64_t bodySize = isDictionaryEncoded
+                ? getDictEncodedDataSize(column, page.tuple_count, page.null_count, bitWidth)
+                : getPageSize(column, page.tuple_count, page.null_count, page.encoded_size.value_or(page.uncompressed_size));
+            const uint64_t compressedSize = page.compressed_size.value_or(bodySize);
+            uint64_t headerSize = ParquetUtils::getPageHeaderSize(bodySize, compressedSize, page.tuple_count);
+            const uint64_t size = headerSize + compressedSize;
+            const uint64_t uncompressedSize = headerSize + bodySize;
+            // the definition levels of compressed pages are part of the compressed body
+            if (!page.compressed_size) headerSize += ParquetUtils::getDefinitionLevelsPrefixSize(page.tuple_count, levels);
+            f(Page{offset, size, uncompressedSize, firstRow, page.tuple_count, page.null_count,
+                arena ? arena->size() : 0, static_cast<uint32_t>(headerSize), DATA_PAGE_TYPE});
+            if (arena) {
+                ParquetUtils::appendPageHeader(*arena, bodySize, compressedSize, page.tuple_count, false, encoding);
+                if (!page.compressed_size) ParquetUtils::appendDefinitionLevels(*arena, page.tuple_count, levels);
+            }
+            offset += size;
+            firstRow += page.tuple_count;
+        }
+    }
 
-            const bool fast_path = begin == chunkBegin && end == chunkEnd;
-            char* vec;
-            if (fast_path) [[likely]] {
-                vec = buffer.data() + offset;
-            }else {
-                currBuffer.resize(uncompressed_size);
-                vec = currBuffer.data();
+    // Rows of the data pages of the chunk, limited by the page rows and the page size of the options
+    [[nodiscard]] uint64_t getPageRows(const ChunkInfo& info) const {
+        uint64_t result = options.pageRows ? options.pageRows : std::max<uint64_t>(info.tuple_count, 1);
+        if (options.pageSize) {
+            const uint64_t valuesSize = info.dictionary_chunk_info
+                ? BitPacking::getPackedSize(info.tuple_count - info.null_count,
+                    getBitWidth(info.dictionary_chunk_info->unique_values_count))
+                : info.uncompressed_size;
+            if (valuesSize > options.pageSize) {
+                const double rowsPerByte = static_cast<double>(info.tuple_count) / valuesSize;
+                result = std::min(result, std::max<uint64_t>(1, options.pageSize * rowsPerByte));
             }
+        }
+        return result;
+    }
 
-            if (arrow::is_dictionary(arr->type_id())) {
-                const uint8_t byteLength = (std::bit_width(unique_values) + 7) / 8;
-                ColumnChunkWriter::writeDictionaryEncodedChunk(
-                    ParquetUtils::writePageWithoutData(getDictEncodedDataSize(arr->length(), unique_values),
-                    arr->length(), false, true, byteLength),
-                    std::static_pointer_cast<arrow::DictionaryArray>(arr)->indices(), vec, byteLength, 0);
+    // Whether the pages of the chunk info were computed for the given rows per page
+    static bool hasPages(const ChunkInfo& info, const uint64_t pageRows) {
+        uint64_t rows = 0;
+        uint64_t nulls = 0;
+        for (const PageInfo& page : info.pages) {
+            if (rows >= info.tuple_count || page.tuple_count != std::min(pageRows, info.tuple_count - rows)) return false;
+            rows += page.tuple_count;
+            nulls += page.null_count;
+        }
+        return rows == info.tuple_count && nulls == info.null_count;
+    }
+
+    // Splits the chunks into data pages. The pages of chunks of fixed width values or dictionary indices without
+    // nulls or with nulls only follow from the chunk info, all other chunks with several pages are read once
+    void initPages() {
+        std::vector<uint64_t> chunks;
+        for (uint64_t k = 0; k != numRowgroups * numColumns; k++) {
+            const uint64_t j = k % numColumns;
+            ChunkInfo& info = chunkInfos[j][k / numColumns];
+            if (info.tuple_count <= getPageRows(info)) {
+                // a single page, its compressed size is the one of the chunk unless the chunk had other pages before
+                const bool samePage = info.pages.empty()
+                    || (info.pages.size() == 1 && info.pages[0].tuple_count == info.tuple_count);
+                if (!samePage) {
+                    info.compressed_size = std::nullopt;
+                    info.compression = std::nullopt;
+                }
+                info.pages = {{info.uncompressed_size, info.tuple_count, info.null_count, info.compressed_size,
+                    samePage && !info.pages.empty() ? info.pages[0].encoded_size : std::nullopt}};
+                continue;
+            }
+            const uint64_t pageRows = getPageRows(info);
+            if (hasPages(info, pageRows)) continue;
+            info.pages.clear();
+            info.compressed_size = std::nullopt;
+            info.compression = std::nullopt;
+            const std::optional<uint64_t> width = getFixedValuesSize(j, 1);
+            if ((info.dictionary_chunk_info || width) && (info.null_count == 0 || info.null_count == info.tuple_count)) {
+                for (uint64_t row = 0; row < info.tuple_count; row += pageRows) {
+                    const uint64_t rows = std::min(pageRows, info.tuple_count - row);
+                    const uint64_t nulls = info.null_count ? rows : 0;
+                    const uint64_t valuesSize = info.dictionary_chunk_info ? 0 : *getFixedValuesSize(j, rows - nulls);
+                    info.pages.push_back({valuesSize, rows, nulls});
+                }
             } else {
-                ColumnChunkWriter::writeColumnChunk(
-                    ParquetUtils::writePageWithoutData(getDataSize(arr, isDictionaryPage),
-                                                                     arr->length(), isDictionaryPage, false),
-                    arr, vec);
+                chunks.push_back(k);
             }
+        }
+        PARQUET_THROW_NOT_OK(arrow::internal::OptionalParallelFor(options.executor != nullptr,
+            static_cast<int>(chunks.size()), [&](const int t) {
+                const uint64_t k = chunks[t];
+                const uint64_t i = k / numColumns;
+                const uint64_t j = k % numColumns;
+                ChunkInfo& info = chunkInfos[j][i];
+                const std::shared_ptr<arrow::Array> arr = reader->readChunk(i, j);
+                checkChunk(info, j, arr);
+                const uint64_t pageRows = getPageRows(info);
+                for (uint64_t row = 0; row < info.tuple_count; row += pageRows) {
+                    const std::shared_ptr<arrow::Array> page = arr->Slice(row, std::min(pageRows, info.tuple_count - row));
+                    const uint64_t valuesSize = info.dictionary_chunk_info ? 0 : ColumnChunkWriter::getValuesSize(page);
+                    info.pages.push_back({valuesSize, static_cast<uint64_t>(page->length()),
+                        static_cast<uint64_t>(page->null_count())});
+                }
+                return arrow::Status::OK();
+            }, options.executor ? options.executor.get() : arrow::internal::GetCpuThreadPool()));
+    }
+
+    // Non-owning slice of the rows of the data page, whose null count is known. Unlike slices of the array,
+    // it does not allocate
+    static arrow::ArraySpan slicePage(const arrow::ArraySpan& chunk, const Page& page) {
+        arrow::ArraySpan result = chunk;
+        result.SetSlice(chunk.offset + page.firstRow, page.rows);
+        result.null_count = page.nulls;
+        return result;
+    }
+
+    // The values of a chunk, i.e. the indices of dictionary encoded chunks
+    static arrow::ArraySpan getChunkValues(const std::shared_ptr<arrow::Array>& arr) {
+        if (arrow::is_dictionary(arr->type_id())) {
+            return arrow::ArraySpan(*std::static_pointer_cast<arrow::DictionaryArray>(arr)->indices()->data());
+        }
+        return arrow::ArraySpan(*arr->data());
+    }
+
+    // Returns the pages of the chunk k overlapping the range
+    std::span<const Page> findPages(const uint64_t k, const ByteRange range) const {
+        const std::span<const Page> chunk(pages.begin() + chunkPages[k], pages.begin() + chunkPages[k + 1]);
+        const int64_t begin = range.begin - static_cast<int64_t>(chunkOffsets[k]);
+        const int64_t end = range.end - static_cast<int64_t>(chunkOffsets[k]);
+        auto first = std::upper_bound(chunk.begin(), chunk.end(), begin, [](const int64_t offset, const Page& page) {
+            return offset < static_cast<int64_t>(page.offset);
+        });
+        if (first != chunk.begin()) --first;
+        auto last = first;
+        while (last != chunk.end() && static_cast<int64_t>(last->offset) <= end) ++last;
+        return {first, last};
+    }
+
+    std::span<const uint8_t> getHeader(const Page& page) const {
+        return {headers->data() + page.headerOffset, page.headerSize};
+    }
 
+    // Writes the part of the uncompressed page of chunk k within the range. The values are the ones of the whole
+    // chunk, the dictionary is only used by the dictionary page
+    void writePage(const uint64_t k, const Page& page, const arrow::ArraySpan& values,
+                   const std::shared_ptr<arrow::Array>& dictionary, const ByteRange range, char* out,
+                   const uint8_t bitWidth) const {
+        const int64_t pageBegin = chunkOffsets[k] + page.offset;
+        const int64_t begin = std::max(pageBegin, range.begin);
+        const int64_t end = std::min<int64_t>(pageBegin + page.size - 1, range.end);
+        // only the requested bytes of the page are produced
+        char* vec = out + (begin - range.begin);
+        const uint64_t from = begin - pageBegin;
+        const uint64_t to = end - pageBegin;
+        if (from != 0 || to != page.size - 1) metrics.record(Counter::PartialPages);
 
-            if (!fast_path) {
-                memcpy(buffer.data() + offset, currBuffer.data() + begin - chunkBegin, end - begin + 1);
+        if (page.type == DICTIONARY_PAGE_TYPE) {
+            ColumnChunkWriter::writeColumnChunk(getHeader(page), dictionary, vec, from, to);
+            return;
+        }
+        const arrow::ArraySpan pageValues = slicePage(values, page);
+        const auto levels = getDefinitionLevels(k % numColumns, page.rows, page.nulls);
+        if (dictionary) {
+            uint8_t prefix[ParquetUtils::MAX_DICTIONARY_INDICES_PREFIX_SIZE];
+            const uint8_t prefixSize = ParquetUtils::writeDictionaryIndicesPrefix(page.rows - page.nulls, bitWidth, prefix);
+            ColumnChunkWriter::writeDictionaryEncodedChunk(getHeader(page), {prefix, prefixSize}, pageValues, vec,
+                bitWidth, from, to, levels);
+        } else {
+            ColumnChunkWriter::writeColumnChunk(getHeader(page), pageValues, vec, from, to, levels);
+        }
+    }
+
+    // The sizes were predicted from the chunk info, the chunk has to match it
+    void checkChunk(const ChunkInfo& info, const size_t column, const std::shared_ptr<arrow::Array>& arr) const {
+        if (static_cast<uint64_t>(arr->null_count()) != info.null_count) {
+            throw std::logic_error{"the null count does not match the chunk info"};
+        }
+        if (info.null_count != 0 && !schema->field(column)->nullable()) {
+            throw std::logic_error{"nulls in a column, which is not nullable"};
+        }
+        if (info.dictionary_chunk_info) {
+            if (!arrow::is_dictionary(arr->type_id())) {
+                throw std::logic_error{"dictionary encoded chunks have to be read as dictionary arrays"};
+            }
+            const std::shared_ptr<arrow::Array>& dictionary = std::static_pointer_cast<arrow::DictionaryArray>(arr)->dictionary();
+            if (dictionary->null_count() != 0
+                || ColumnChunkWriter::getValuesSize(dictionary) != getDictionaryValuesSize(column, *info.dictionary_chunk_info)) {
+                throw std::logic_error{"the dictionary does not match the dictionary chunk info"};
+            }
+        }
+        if (info.pages.size() > 1 && info.null_count != 0 && info.null_count != info.tuple_count) {
+            uint64_t firstRow = 0;
+            for (const PageInfo& page : info.pages) {
+                const int64_t valid = arrow::internal::CountSetBits(arr->null_bitmap_data(), arr->offset() + firstRow,
+                    page.tuple_count);
+                if (page.tuple_count - valid != page.null_count) {
+                    throw std::logic_error{"the null count of a page does not match the chunk info"};
+                }
+                firstRow += page.tuple_count;
             }
-            offset += end - begin + 1;
         }
     }
-public:
-    explicit VirtualParquetFile(
-        const std::shared_ptr<ArrowReader>& reader,
-        const std::shared_ptr<arrow::Schema>& schema,
-        std::vector<std::vector<ChunkInfo>>&& chunkInfos) :
-            VirtualFile(reader, schema, std::move(chunkInfos)) {
-        const auto writerProps = parquet::WriterProperties::Builder().build();
-        PARQUET_THROW_NOT_OK(parquet::arrow::ToParquetSchema(schema.get(), *writerProps,
-            *parquet::default_arrow_writer_properties(), &schemaDescriptor));
-        metadataBuilder = parquet::FileMetaDataBuilder::Make(schemaDescriptor.get(), writerProps);
-        size = initSize();
-        metadataOffset = size - MAGIC_NUMBER_SIZE - FOOTER_LENGTH_SIZE;
-    }
-
-    ~VirtualParquetFile() override = default;
-
-    std::string getRange(const ByteRange range) override {
-        assert(range.end <= size);
-        buffer.resize(range.size());
-        size_t offset = 0;
-        if (range.begin == 0) {
-            buffer[0] = 'P';
-            buffer[1] = 'A';
-            buffer[2] = 'R';
-            buffer[3] = '1';
-            offset = 4;
-        }
-
-
-        for (uint64_t i=0; i<numRowgroups; i++) {
-            for (uint64_t j=0; j!=numColumns; j++) {
-                std::shared_ptr<arrow::Array> arr = reader->readChunk(i, j);
-                auto columnChunkMeta = metadata->RowGroup(i)->ColumnChunk(j);
-                int64_t chunkBegin = columnChunkMeta->has_dictionary_page() ?
-                    columnChunkMeta->dictionary_page_offset() : columnChunkMeta->data_page_offset();
-
-                if (columnChunkMeta->has_dictionary_page()
-                    && !(columnChunkMeta->dictionary_page_offset() > range.end
-                         || columnChunkMeta->data_page_offset() < range.begin)) {
-                    arrow::ArrayVector arrays;
-                    arrow::StringBuilder builder;
-
-                    arrays.push_back(arr);
-                    if (arrow::is_dictionary(arr->type_id())) {
-                        auto dictArray = std::static_pointer_cast<arrow::DictionaryArray>(arr)->dictionary();
-                        auto status = builder.AppendArraySlice(*dictArray->data(), 0, dictArray->length());
-                    }
 
+    void writeChunk(const uint64_t k, const std::shared_ptr<arrow::Array>& arr, const ByteRange range, char* out) const {
+        const ChunkInfo& info = chunkInfos[k % numColumns][k / numColumns];
+        checkChunk(info, k % numColumns, arr);
+        const uint8_t bitWidth = info.dictionary_chunk_info ? getBitWidth(info.dictionary_chunk_info->unique_values_count) : 0;
+        metrics.record(Counter::ChunksSerialized);
+        const Metrics::Timer timer(metrics, Latency::Serialize);
+        const arrow::ArraySpan values = getChunkValues(arr);
+        const std::shared_ptr<arrow::Array> dictionary = info.dictionary_chunk_info
+            ? std::static_pointer_cast<arrow::DictionaryArray>(arr)->dictionary() : nullptr;
+        for (const Page& page : findPages(k, range)) {
+            writePage(k, page, values, dictionary, range, out, bitWidth);
+        }
+    }
+
+    // Returns the chunk k, either read ahead before or read synchronously
+    std::shared_ptr<arrow::Array> fetchChunk(const uint64_t k) const {
+        const Metrics::Timer timer(metrics, Latency::Read);
+        if (options.readaheadChunks) {
+            std::unique_lock lock(readahead.mutex);
+            if (const auto it = readahead.chunks.find(k); it != readahead.chunks.end()) {
+                const auto chunk = it->second;
+                readahead.chunks.erase(it);
+                lock.unlock();
+                PARQUET_ASSIGN_OR_THROW(auto arr, chunk.result());
+                return arr;
+            }
+        }
+        return reader->readChunk(k / numColumns, k % numColumns);
+    }
+
+    // Returns the chunk k, which a stream keeps for its next windows
+    std::shared_ptr<arrow::Array> fetchChunk(const uint64_t k, StreamChunk* stream) const {
+        if (!stream) return fetchChunk(k);
+        if (stream->index != k || !stream->values) *stream = {k, fetchChunk(k), nullptr};
+        return stream->values;
+    }
+
+    // Reads the chunks following [first, last) in the background if the requests scan the chunks sequentially,
+    // i.e. if a request continues at or within the last chunk of the previous one. Readers request the
+    // footer before the column chunks, so the scan starts with the request of the first chunk.
+    void readAhead(const uint64_t first, const uint64_t last) const {
+        if (!options.readaheadChunks || first == last) return;
+        std::lock_guard lock(readahead.mutex);
+        const bool sequential = first == readahead.nextChunk || first + 1 == readahead.nextChunk;
+        readahead.nextChunk = last;
+        // drop the chunks outside the window, the scan skipped them
+        const uint64_t windowEnd = sequential ? std::min(last + options.readaheadChunks, numRowgroups * numColumns) : 0;
+        std::erase_if(readahead.dropped, [](const auto& chunk) { return chunk.is_finished(); });
+        std::erase_if(readahead.chunks, [&](const auto& chunk) {
+            const bool drop = chunk.first < first || chunk.first >= std::max(last, windowEnd);
+            if (drop && !chunk.second.is_finished()) readahead.dropped.push_back(chunk.second);
+            return drop;
+        });
+        for (uint64_t k = last; k < windowEnd; k++) {
+            // chunks in the cache are served without reading them
+            const bool inCache = isCached(k) && cache->contains({fileId, k / numColumns, k % numColumns});
+            if (!inCache && !readahead.chunks.contains(k)) {
+                readahead.chunks.emplace(k, reader->readChunkAsync(k / numColumns, k % numColumns, readahead.executor.get()));
+            }
+        }
+    }
+
+    // Returns the whole serialized chunk k from the cache or serializes and caches it
+    std::shared_ptr<arrow::Buffer> getCachedChunk(const uint64_t k) const {
+        const ChunkCache::Key key{fileId, k / numColumns, k % numColumns};
+        if (auto chunk = cache->get(key)) {
+            metrics.record(Counter::CacheHits);
+            return chunk;
+        }
+        metrics.record(Counter::CacheMisses);
+        std::shared_ptr<arrow::Buffer> chunk;
+        if (isEncodedWhole(k)) {
+            const std::shared_ptr<arrow::Array> arr = fetchChunk(k);
+            const ChunkInfo& info = chunkInfos[key.column][key.rowgroup];
+            checkChunk(info, key.column, arr);
+            metrics.record(Counter::ChunksSerialized);
+            const Metrics::Timer timer(metrics, Latency::Serialize);
+            chunk = writeEncodedChunk(key.column, info, arr, info.encoding.value_or(ValueEncoding::PLAIN));
+        } else {
+            const ByteRange chunkRange{static_cast<int64_t>(chunkOffsets[k]), static_cast<int64_t>(chunkOffsets[k + 1]) - 1};
+            PARQUET_ASSIGN_OR_THROW(chunk, arrow::AllocateBuffer(chunkRange.size()));
+            writeChunk(k, fetchChunk(k), chunkRange, reinterpret_cast<char*>(chunk->mutable_data()));
+        }
+        if (static_cast<uint64_t>(chunk->size()) != chunkOffsets[k + 1] - chunkOffsets[k]) {
+            throw std::logic_error{"the serialized chunk does not match its predicted size"};
+        }
+        cache->put(key, chunk);
+        return chunk;
+    }
+
+    // Returns the whole serialized chunk k, which a stream keeps for its next windows
+    std::shared_ptr<arrow::Buffer> getCachedChunk(const uint64_t k, StreamChunk* stream) const {
+        if (!stream) return getCachedChunk(k);
+        if (stream->index != k || !stream->serialized) *stream = {k, nullptr, getCachedChunk(k)};
+        return stream->serialized;
+    }
+
+    // Compressed chunks and chunks in other encodings than PLAIN are only produced as a whole
+    bool isEncodedWhole(const uint64_t k) const {
+        const ChunkInfo& info = chunkInfos[k % numColumns][k / numColumns];
+        return codecs[k % numColumns] != arrow::Compression::UNCOMPRESSED
+            || info.encoding.value_or(ValueEncoding::PLAIN) != ValueEncoding::PLAIN;
+    }
 
-                    std::shared_ptr<arrow::Array> dictionaryArr;
-                    auto status = builder.Finish(&dictionaryArr);
-                    const int64_t dictionaryPageSize = columnChunkMeta->data_page_offset() - columnChunkMeta->dictionary_page_offset();
-                    writeChunk(chunkBegin, chunkBegin + dictionaryPageSize - 1, range, dictionaryArr, offset, true, dictionaryPageSize);
-                    chunkBegin += dictionaryPageSize;
+    // Chunks produced as a whole are always cached
+    bool isCached(const uint64_t k) const {
+        return options.cache || isEncodedWhole(k);
+    }
 
-                    int64_t chunkSize = chunkInfos[j][i].uncompressed_size;
-                    int64_t chunkEnd = chunkBegin + chunkInfos[j][i].uncompressed_size - 1;
-                    writeChunk(chunkBegin, chunkEnd, range, arrays[0], offset, false, chunkInfos[j][i].uncompressed_size, dictionaryArr->length());
-                    // Prepare next chunk
-                    chunkBegin += chunkSize;
+    // Serializes the chunk as data pages with the values in the encoding and bodies compressed with the codec of the
+    // column. Optionally returns the sizes of the page bodies after compression and of the encoded values
+    std::shared_ptr<arrow::Buffer> writeEncodedChunk(const uint64_t column, const ChunkInfo& info,
+                                                     const std::shared_ptr<arrow::Array>& arr,
+                                                     const ValueEncoding encoding,
+                                                     std::vector<uint64_t>* bodySizes = nullptr,
+                                                     std::vector<uint64_t>* encodedSizes = nullptr) const {
+        // codecs are not necessarily thread-safe, uncompressed columns have none
+        const std::unique_ptr<arrow::util::Codec> codec = parquet::GetCodec(codecs[column]);
+        const parquet::ColumnDescriptor& descriptor = *schemaDescriptor->Column(column);
+        std::vector<uint8_t> chunk;
+        std::vector<uint8_t> page;
+        std::vector<uint8_t> encoded;
+        std::vector<uint8_t> compressed;
+        int64_t firstRow = 0;
+        for (const PageInfo& pageInfo : info.pages) {
+            const std::shared_ptr<arrow::Array> values = arr->Slice(firstRow, pageInfo.tuple_count);
+            firstRow += pageInfo.tuple_count;
+            const uint64_t pageSize = getPageSize(column, values);
+            const auto levels = getDefinitionLevels(column, values->length(), values->null_count());
+            page.resize(pageSize);
+            ColumnChunkWriter::writeColumnChunk(ParquetUtils::writeDefinitionLevels(values->length(), levels), values,
+                reinterpret_cast<char*>(page.data()), 0, pageSize - 1, levels);
+            if (encoding != ValueEncoding::PLAIN) {
+                // the definition levels are followed by the plain values, which are encoded again
+                const uint64_t levelsSize = ParquetUtils::getDefinitionLevelsSize(values->length(), levels);
+                encoded.assign(page.begin(), page.begin() + levelsSize);
+                ValueEncoder::appendEncoded(encoding, descriptor, page.data() + levelsSize, pageSize - levelsSize, encoded);
+                if (encodedSizes) encodedSizes->push_back(encoded.size() - levelsSize);
+                page.swap(encoded);
+            }
 
-                }else {
-                    const int64_t chunkSize = chunkInfos[j][i].uncompressed_size;
-                    const int64_t chunkEnd = chunkBegin + chunkSize - 1;
+            const uint64_t bodySize = page.size();
+            const uint8_t* body = page.data();
+            int64_t compressedSize = bodySize;
+            if (codec) {
+                compressed.resize(codec->MaxCompressedLen(bodySize, page.data()));
+                PARQUET_ASSIGN_OR_THROW(compressedSize,
+                    codec->Compress(bodySize, page.data(), compressed.size(), compressed.data()));
+                body = compressed.data();
+            }
+            const std::vector<uint8_t> header = ParquetUtils::writePageHeader(bodySize, compressedSize, values->length(),
+                false, ValueEncoder::getEncodingId(encoding));
+            chunk.insert(chunk.end(), header.begin(), header.end());
+            chunk.insert(chunk.end(), body, body + compressedSize);
+            if (bodySizes) bodySizes->push_back(compressedSize);
+        }
+        return arrow::Buffer::FromVector(std::move(chunk));
+    }
 
-                    if (!(chunkEnd < range.begin || chunkBegin > range.end)) {
-                        writeChunk(chunkBegin, chunkEnd, range, reader->readChunk(i, j), offset, false, chunkInfos[j][i].uncompressed_size);
+    // Selects the encoding of all chunks, which are not dictionary encoded and whose encoding is not known yet, by
+    // serializing them in all candidate encodings. The compressed sizes follow as well, the chunks produced
+    // as a whole are cached for the first requests
+    void initEncodings() {
+        std::vector<uint64_t> chunks;
+        for (uint64_t k = 0; k != numRowgroups * numColumns; k++) {
+            const uint64_t j = k % numColumns;
+            ChunkInfo& info = chunkInfos[j][k / numColumns];
+            // the encoded sizes are lost if the chunk was split into other pages
+            const bool known = info.encoding && (*info.encoding == ValueEncoding::PLAIN
+                || std::ranges::all_of(info.pages, [](const PageInfo& page) { return page.encoded_size.has_value(); }));
+            if (info.dictionary_chunk_info || known) continue;
+            info.encoding = std::nullopt;
+            for (auto& page : info.pages) page.encoded_size = std::nullopt;
+            if (ValueEncoder::getCandidates(*schemaDescriptor->Column(j),
+                    codecs[j] != arrow::Compression::UNCOMPRESSED).empty()) {
+                info.encoding = ValueEncoding::PLAIN;
+            } else {
+                chunks.push_back(k);
+            }
+        }
+        PARQUET_THROW_NOT_OK(arrow::internal::OptionalParallelFor(options.executor != nullptr,
+            static_cast<int>(chunks.size()), [&](const int t) {
+                const uint64_t k = chunks[t];
+                const uint64_t i = k / numColumns;
+                const uint64_t j = k % numColumns;
+                ChunkInfo& info = chunkInfos[j][i];
+                const std::shared_ptr<arrow::Array> arr = reader->readChunk(i, j);
+                checkChunk(info, j, arr);
+                const bool compressed = codecs[j] != arrow::Compression::UNCOMPRESSED;
+                ValueEncoding encoding = ValueEncoding::PLAIN;
+                std::vector<uint64_t> bodySizes;
+                std::vector<uint64_t> encodedSizes;
+                std::shared_ptr<arrow::Buffer> chunk = writeEncodedChunk(j, info, arr, encoding, &bodySizes);
+                const double maxSize = (1.0 - options.minEncodingSavings) * chunk->size();
+                for (const ValueEncoding candidate : ValueEncoder::getCandidates(*schemaDescriptor->Column(j), compressed)) {
+                    std::vector<uint64_t> candidateBodySizes;
+                    std::vector<uint64_t> candidateEncodedSizes;
+                    auto candidateChunk = writeEncodedChunk(j, info, arr, candidate, &candidateBodySizes,
+                        &candidateEncodedSizes);
+                    if (candidateChunk->size() <= maxSize && candidateChunk->size() < chunk->size()) {
+                        encoding = candidate;
+                        chunk = std::move(candidateChunk);
+                        bodySizes = std::move(candidateBodySizes);
+                        encodedSizes = std::move(candidateEncodedSizes);
                     }
-                    // Prepare next chunk
-                    chunkBegin += chunkSize;
                 }
+                info.encoding = encoding;
+                if (compressed) {
+                    info.compressed_size = 0;
+                    info.compression = codecs[j];
+                }
+                for (size_t p = 0; p != info.pages.size(); p++) {
+                    if (encoding != ValueEncoding::PLAIN) info.pages[p].encoded_size = encodedSizes[p];
+                    if (compressed) {
+                        info.pages[p].compressed_size = bodySizes[p];
+                        *info.compressed_size += bodySizes[p];
+                    }
+                }
+                if (isEncodedWhole(k)) cache->put({fileId, i, j}, chunk);
+                return arrow::Status::OK();
+            }, options.executor ? options.executor.get() : arrow::internal::GetCpuThreadPool()));
+    }
+
+    // Compresses all chunks of compressed columns whose compressed size is not known yet,
+    // the compressed chunks are cached for the first requests
+    void initCompressedSizes() {
+        std::vector<uint64_t> chunks;
+        for (uint64_t k = 0; k != numRowgroups * numColumns; k++) {
+            const ChunkInfo& info = chunkInfos[k % numColumns][k / numColumns];
+            if (codecs[k % numColumns] != arrow::Compression::UNCOMPRESSED && !info.compressed_size) {
+                chunks.push_back(k);
+            }
+        }
+        PARQUET_THROW_NOT_OK(arrow::internal::OptionalParallelFor(options.executor != nullptr,
+            static_cast<int>(chunks.size()), [&](const int t) {
+                const uint64_t k = chunks[t];
+                const uint64_t i = k / numColumns;
+                const uint64_t j = k % numColumns;
+                ChunkInfo& info = chunkInfos[j][i];
+                const std::shared_ptr<arrow::Array> arr = reader->readChunk(i, j);
+                checkChunk(info, j, arr);
+                std::vector<uint64_t> bodySizes;
+                const std::shared_ptr<arrow::Buffer> chunk = writeEncodedChunk(j, info, arr,
+                    info.encoding.value_or(ValueEncoding::PLAIN), &bodySizes);
+                info.compressed_size = 0;
+                info.compression = codecs[j];
+                for (size_t p = 0; p != info.pages.size(); p++) {
+                    info.pages[p].compressed_size = bodySizes[p];
+                    *info.compressed_size += bodySizes[p];
+                }
+                cache->put({fileId, i, j}, chunk);
+                return arrow::Status::OK();
+            }, options.executor ? options.executor.get() : arrow::internal::GetCpuThreadPool()));
+    }
+
+    void writeChunk(const uint64_t k, const ByteRange range, char* out, StreamChunk* stream = nullptr) const {
+        metrics.record(Counter::ChunksTouched);
+        if (isCached(k)) {
+            const int64_t begin = std::max<int64_t>(chunkOffsets[k], range.begin);
+            const int64_t end = std::min<int64_t>(chunkOffsets[k + 1] - 1, range.end);
+            memcpy(out + (begin - range.begin), getCachedChunk(k, stream)->data() + (begin - chunkOffsets[k]), end - begin + 1);
+            return;
+        }
+        writeChunk(k, fetchChunk(k, stream), range, out);
+    }
+
+    void appendChunkSegments(const uint64_t k, const ByteRange range, std::vector<std::shared_ptr<arrow::Buffer>>& segments,
+                             StreamChunk* stream = nullptr) const {
+        const uint64_t i = k / numColumns;
+        const uint64_t j = k % numColumns;
+        const int64_t chunkBegin = chunkOffsets[k];
+        const int64_t chunkEnd = chunkOffsets[k + 1] - 1;
+        const int64_t begin = std::max<int64_t>(chunkBegin, range.begin);
+        const int64_t end = std::min<int64_t>(chunkEnd, range.end);
+        metrics.record(Counter::ChunksTouched);
+        if (isCached(k)) {
+            segments.push_back(arrow::SliceBuffer(getCachedChunk(k, stream), begin - chunkBegin, end - begin + 1));
+            return;
+        }
+        const std::shared_ptr<arrow::Array> arr = fetchChunk(k, stream);
+        checkChunk(chunkInfos[j][i], j, arr);
+        if (!chunkInfos[j][i].dictionary_chunk_info && arr->null_count() == 0
+            && appendPageSegments(k, arr, {begin, end}, segments)) {
+            return;
+        }
+        PARQUET_ASSIGN_OR_THROW(std::shared_ptr<arrow::Buffer> buffer, arrow::AllocateBuffer(end - begin + 1));
+        writeChunk(k, arr, {begin, end}, reinterpret_cast<char*>(buffer->mutable_data()));
+        segments.push_back(std::move(buffer));
+    }
+
+    // Appends the pages of the chunk k within the range as segments, which borrow the values of the array.
+    // Returns false without appending anything if the values cannot be borrowed
+    bool appendPageSegments(const uint64_t k, const std::shared_ptr<arrow::Array>& arr, const ByteRange range,
+                            std::vector<std::shared_ptr<arrow::Buffer>>& segments) const {
+        const arrow::ArraySpan values(*arr->data());
+        std::vector<std::shared_ptr<arrow::Buffer>> pageSegments;
+        for (const Page& page : findPages(k, range)) {
+            pageSegments.clear();
+            const auto header = arrow::SliceBuffer(headers, page.headerOffset, page.headerSize);
+            if (!ColumnChunkWriter::appendColumnChunkSegments(header, slicePage(values, page), pageSegments)) {
+                return false;
+            }
+            // keep only the parts of the segments within the range
+            int64_t segmentBegin = chunkOffsets[k] + page.offset;
+            for (auto& segment : pageSegments) {
+                const int64_t segmentEnd = segmentBegin + segment->size() - 1;
+                if (segmentEnd >= range.begin && segmentBegin <= range.end) {
+                    const int64_t from = std::max(segmentBegin, range.begin);
+                    const int64_t to = std::min(segmentEnd, range.end);
+                    segments.push_back(arrow::SliceBuffer(std::move(segment), from - segmentBegin, to - from + 1));
+                }
+                segmentBegin = segmentEnd + 1;
             }
         }
+        return true;
+    }
 
-        if (range.end >= metadataOffset && range.size() != 8) {
-            assert(offset + serializedMetadata.size() <= buffer.size());
-            memcpy(buffer.data() + offset, serializedMetadata.data(), serializedMetadata.size());
-            offset += serializedMetadata.size();
+    // Serves getRange and the windows of streams, which keep the chunk they end in
+    void writeRange(const ByteRange range, std::span<char> out, StreamChunk* stream) const {
+        assert(range.end < static_cast<int64_t>(size));
+        assert(out.size() >= range.size());
+        const auto request = startRequest(range, false);
+        const auto [first, last] = findChunks(chunkOffsets, range);
+        readAhead(first, last);
+
+        // Every chunk is written to its own part of the buffer, s.t. chunks can be serialized independently. Callers
+        // running on the executor serialize the chunks themselves, waiting for its other threads could deadlock.
+        // The first and the last chunk of the windows of streams are served from and kept in the stream
+        if (options.executor && last - first >= options.minParallelChunks + (stream ? 2 : 0)
+            && !options.executor->OwnsThisThread()) {
+            const uint64_t parallelFirst = stream ? first + 1 : first;
+            const uint64_t parallelLast = stream ? last - 1 : last;
+            if (stream) writeChunk(first, range, out.data(), stream);
+            // the first exception is rethrown as is, like by the serial path
+            std::mutex mutex;
+            std::exception_ptr error;
+            const arrow::Status status = arrow::internal::ParallelFor(static_cast<int>(parallelLast - parallelFirst),
+                                                                      [&](const int t) {
+                try {
+                    writeChunk(parallelFirst + t, range, out.data());
+                } catch (...) {
+                    std::lock_guard lock(mutex);
+                    if (!error) error = std::current_exception();
+                    return arrow::Status::Cancelled("chunk not serialized");
+                }
+                return arrow::Status::OK();
+            }, options.executor.get());
+            if (error) std::rethrow_exception(error);
+            PARQUET_THROW_NOT_OK(status);
+            if (stream) writeChunk(last - 1, range, out.data(), stream);
+        } else {
+            for (uint64_t k = first; k < last; k++) {
+                writeChunk(k, range, out.data(), stream);
+            }
         }
-        // TODO allow partial footer requests
-        if (range.end == size - 1) {
-            const int32_t s = serializedMetadata.size();
-            std::string footer = "xxxxPAR1";
-            memcpy(footer.data(), &s, 4);
-            memcpy(buffer.data() + offset, footer.data(), footer.size());
-            offset += footer.size();
+        writeMetadata(range, out.data());
+    }
+
+    std::vector<std::shared_ptr<arrow::Buffer>> getSegments(const ByteRange range, StreamChunk* stream) const {
+        assert(range.end < static_cast<int64_t>(size));
+        const auto request = startRequest(range, true);
+        std::vector<std::shared_ptr<arrow::Buffer>> segments;
+        if (range.begin < static_cast<int64_t>(MAGIC_NUMBER_SIZE)) {
+            const ByteRange magic{range.begin, std::min<int64_t>(range.end, MAGIC_NUMBER_SIZE - 1)};
+            std::string buffer(magic.size(), '\0');
+            writeMetadata(magic, buffer.data());
+            segments.push_back(arrow::Buffer::FromString(std::move(buffer)));
+        }
+        const auto [first, last] = findChunks(chunkOffsets, range);
+        readAhead(first, last);
+        for (uint64_t k = first; k < last; k++) {
+            appendChunkSegments(k, range, segments, stream);
         }
-        return buffer;
+        if (range.end >= static_cast<int64_t>(fileOffset)) {
+            metrics.record(Counter::FooterReads);
+            const int64_t begin = std::max<int64_t>(range.begin, fileOffset);
+            segments.push_back(arrow::SliceBuffer(footer, begin - fileOffset, range.end - begin + 1));
+        }
+        return segments;
+    }
+
+    // Returns the first chunk overlapping the range and the chunk after the last overlapping one,
+    // the chunks begin at the offsets followed by the offset of the footer
+    static std::pair<uint64_t, uint64_t> findChunks(const std::span<const uint64_t> chunkOffsets, const ByteRange range) {
+        // the first chunk is the last one beginning at or before range.begin
+        const uint64_t numChunks = chunkOffsets.size() - 1;
+        const auto firstChunk = std::upper_bound(chunkOffsets.begin(), chunkOffsets.end(),
+            static_cast<uint64_t>(range.begin));
+        const uint64_t first = firstChunk == chunkOffsets.begin() ? 0 : firstChunk - chunkOffsets.begin() - 1;
+        uint64_t last = first;
+        while (last < numChunks && chunkOffsets[last] <= static_cast<uint64_t>(range.end)) last++;
+        return {first, last};
+    }
+
+    // Writes the parts of the leading magic number and the footer within the range
+    void writeMetadata(const ByteRange range, char* out) const {
+        if (range.begin < static_cast<int64_t>(MAGIC_NUMBER_SIZE)) {
+            const char* magic = "PAR1";
+            memcpy(out, magic + range.begin, std::min<uint64_t>(MAGIC_NUMBER_SIZE - range.begin, range.size()));
+        }
+        if (range.end >= static_cast<int64_t>(fileOffset)) {
+            metrics.record(Counter::FooterReads);
+            const int64_t begin = std::max<int64_t>(range.begin, fileOffset);
+            memcpy(out + (begin - range.begin), footer->data() + (begin - fileOffset), range.end - begin + 1);
+        }
+    }
+
+    // Codecs, cache and readahead of the options, which are set up the same way for snapshots
+    void initOptions() {
+        // dictionary encoded chunks are served uncompressed
+        const auto hasDictionary = [&](const uint64_t j) {
+            return std::ranges::any_of(chunkInfos[j], [](const ChunkInfo& info) { return info.dictionary_chunk_info.has_value(); });
+        };
+        for (uint64_t j = 0; j != numColumns; j++) {
+            if (hasDictionary(j)) codecs[j] = arrow::Compression::UNCOMPRESSED;
+        }
+        for (const auto& [column, codec] : options.columnCompression) {
+            if (codec != arrow::Compression::UNCOMPRESSED && hasDictionary(column)) {
+                throw std::logic_error{"compression of dictionary encoded chunks is not supported"};
+            }
+            codecs[column] = codec;
+        }
+        const bool compressed = std::ranges::any_of(codecs, [](auto codec) { return codec != arrow::Compression::UNCOMPRESSED; });
+        if (!cache && (compressed || options.encodingPolicy != EncodingPolicy::PLAIN)) {
+            cache = std::make_shared<ChunkCache>(DEFAULT_COMPRESSED_CACHE_SIZE);
+        }
+        if (cache) {
+            fileId = cache->registerFile();
+        }
+        if (options.readaheadChunks) {
+            readahead.executor = options.ioExecutor;
+            if (!readahead.executor) {
+                PARQUET_ASSIGN_OR_THROW(readahead.executor,
+                    arrow::internal::ThreadPool::Make(static_cast<int>(options.readaheadChunks)));
+            }
+        }
+    }
+
+    static std::shared_ptr<parquet::SchemaDescriptor> makeSchemaDescriptor(const arrow::Schema& schema) {
+        std::shared_ptr<parquet::SchemaDescriptor> result;
+        PARQUET_THROW_NOT_OK(parquet::arrow::ToParquetSchema(&schema, *parquet::default_writer_properties(),
+            *parquet::default_arrow_writer_properties(), &result));
+        return result;
+    }
+
+    // Everything besides the chunk infos the layout depends on, a snapshot is only valid for the same description
+    static std::string describeLayout(const arrow::Schema& schema, const VirtualParquetFileOptions& options) {
+        std::ostringstream result;
+        result << schema.ToString(true) << "\ncompression " << options.compression;
+        for (const auto& [column, codec] : std::map(options.columnCompression.begin(), options.columnCompression.end())) {
+            result << " " << column << ":" << codec;
+        }
+        result << "\npage index " << options.writePageIndex;
+        result << "\npage rows " << options.pageRows << " size " << options.pageSize;
+        result << "\nencoding policy " << static_cast<int>(options.encodingPolicy) << " savings " << options.minEncodingSavings;
+        return result.str();
+    }
+
+    static std::vector<std::vector<ChunkInfo>> readChunkInfos(LayoutSnapshotReader& snapshot,
+                                                              const arrow::Schema& schema,
+                                                              const VirtualParquetFileOptions& options) {
+        if (snapshot.readString() != describeLayout(schema, options)) {
+            throw std::logic_error{"the layout snapshot was taken with another schema or other options"};
+        }
+        std::vector<std::vector<ChunkInfo>> result = snapshot.readChunkInfos();
+        if (result.size() != static_cast<size_t>(schema.num_fields())) {
+            throw std::runtime_error{"corrupt layout snapshot"};
+        }
+        return result;
+    }
+public:
+    explicit VirtualParquetFile(
+        const std::shared_ptr<ArrowReader>& reader,
+        const std::shared_ptr<arrow::Schema>& schema,
+        std::vector<std::vector<ChunkInfo>>&& chunkInfos,
+        VirtualParquetFileOptions options = {}) :
+            VirtualFile(reader, schema, std::move(chunkInfos)), options(std::move(options)),
+            codecs(numColumns, this->options.compression), cache(this->options.cache) {
+        initOptions();
+        schemaDescriptor = makeSchemaDescriptor(*schema);
+        for (size_t j=0; j!=numColumns; j++) {
+            for (auto& info : this->chunkInfos[j]) {
+                // the compressed sizes only hold for the codec they were computed with,
+                // and those of chunks in other encodings do not hold for their plain values
+                const bool plain = this->options.encodingPolicy == EncodingPolicy::PLAIN;
+                if (codecs[j] == arrow::Compression::UNCOMPRESSED || info.compression != static_cast<int>(codecs[j])
+                    || (plain && info.encoding.value_or(ValueEncoding::PLAIN) != ValueEncoding::PLAIN)) {
+                    info.compressed_size = std::nullopt;
+                    info.compression = std::nullopt;
+                    for (auto& page : info.pages) page.compressed_size = std::nullopt;
+                }
+                if (plain) {
+                    info.encoding = std::nullopt;
+                    for (auto& page : info.pages) page.encoded_size = std::nullopt;
+                }
+            }
+        }
+        initPages();
+        if (this->options.encodingPolicy != EncodingPolicy::PLAIN) initEncodings();
+        initCompressedSizes();
+        size = initSize(this->options.executor.get());
+        headers = arrow::Buffer::FromVector(std::move(headerArena));
+    }
+
+    // Opens the file from the layout snapshot of a file over the same data with the same schema and options,
+    // s.t. neither the chunk infos are predicted nor the footer is serialized again
+    VirtualParquetFile(
+        const std::shared_ptr<ArrowReader>& reader,
+        const std::shared_ptr<arrow::Schema>& schema,
+        LayoutSnapshotReader snapshot,
+        VirtualParquetFileOptions options = {}) :
+            VirtualFile(reader, schema, readChunkInfos(snapshot, *schema, options)), options(std::move(options)),
+            codecs(numColumns, this->options.compression), cache(this->options.cache) {
+        initOptions();
+        // the chunks served as a whole are encoded for the physical types
+        schemaDescriptor = makeSchemaDescriptor(*schema);
+        size = snapshot.read<uint64_t>();
+        fileOffset = snapshot.read<uint64_t>();
+        chunkOffsets = snapshot.readVector<uint64_t>();
+        chunkPages = snapshot.readVector<uint64_t>();
+        pages = snapshot.readVector<Page>();
+        headers = snapshot.readBuffer();
+        footer = snapshot.readBuffer();
+        const uint64_t numChunks = numRowgroups * numColumns;
+        const uint64_t headersSize = headers->size();
+        bool valid = chunkOffsets.size() == numChunks + 1 && chunkPages.size() == numChunks + 1
+            && std::ranges::is_sorted(chunkOffsets) && std::ranges::is_sorted(chunkPages)
+            && chunkOffsets.back() <= fileOffset && chunkPages.back() == pages.size()
+            && size == fileOffset + footer->size()
+            && std::ranges::all_of(pages, [&](const Page& page) {
+                return page.headerOffset <= headersSize && page.headerSize <= headersSize - page.headerOffset;
+            });
+        // every page lies within its chunk
+        for (uint64_t k = 0; valid && k != numChunks; k++) {
+            const uint64_t chunkSize = chunkOffsets[k + 1] - chunkOffsets[k];
+            for (uint64_t p = chunkPages[k]; valid && p != chunkPages[k + 1]; p++) {
+                valid = pages[p].offset <= chunkSize && pages[p].size <= chunkSize - pages[p].offset;
+            }
+        }
+        if (!valid) {
+            throw std::runtime_error{"corrupt layout snapshot"};
+        }
+    }
+
+    // Snapshot of the layout computed at construction, which may be written to a file and mapped with
+    // LayoutSnapshotReader::map to open the file again without computing its layout
+    std::shared_ptr<arrow::Buffer> getLayoutSnapshot() const {
+        LayoutSnapshotWriter snapshot;
+        snapshot.append(describeLayout(*schema, options));
+        snapshot.append(chunkInfos);
+        snapshot.append(size);
+        snapshot.append(fileOffset);
+        snapshot.append(chunkOffsets);
+        snapshot.append(chunkPages);
+        snapshot.append(pages);
+        snapshot.append(*headers);
+        snapshot.append(*footer);
+        return snapshot.finish();
+    }
+
+    ~VirtualParquetFile() override {
+        // the reads ahead may still use the reader
+        for (const auto& [k, chunk] : readahead.chunks) {
+            chunk.Wait();
+        }
+        for (const auto& chunk : readahead.dropped) {
+            chunk.Wait();
+        }
+    }
+
+    using VirtualFile::getRange;
+
+    // Thread-safe as long as the reader is, all scratch state lives in the call
+    void getRange(const ByteRange range, std::span<char> out) override { writeRange(range, out, nullptr); }
+    void getStreamRange(const ByteRange range, std::span<char> out, StreamChunk& chunk) override {
+        writeRange(range, out, &chunk);
+    }
+
+    std::vector<std::shared_ptr<arrow::Buffer>> getRangeSegments(const ByteRange range) override {
+        return getSegments(range, nullptr);
+    }
+    std::vector<std::shared_ptr<arrow::Buffer>> getStreamSegments(const ByteRange range, StreamChunk& chunk) override {
+        return getSegments(range, &chunk);
     }
 };
 // -------------------------------------------------------------------------------------
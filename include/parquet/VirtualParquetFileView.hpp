@@ -0,0 +1,179 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include <optional>
+#include <stdexcept>
+// -------------------------------------------------------------------------------------
+#include "VirtualParquetFile.hpp"
+// -------------------------------------------------------------------------------------
+namespace virtualfile {
+// -------------------------------------------------------------------------------------
+// Parquet file of a subset of the columns and rowgroups of a virtual parquet file. The chunks of the view are the
+// ones of the file and served by it, s.t. the view shares its reader, layout, cache and readahead, and only its
+// footer is serialized at construction. Cheap enough to be created per request
+class VirtualParquetFileView final : public VirtualFile {
+    static constexpr uint64_t MAGIC_NUMBER_SIZE = VirtualParquetFile::MAGIC_NUMBER_SIZE;
+
+    std::shared_ptr<VirtualParquetFile> file;
+    // columns and rowgroups of the file in the view
+    const std::vector<uint64_t> columns;
+    const std::vector<uint64_t> rowgroups;
+    // Begin offsets of all column chunks of the view in file order (rowgroup-major) followed by the offset of the
+    // footer, the chunk k of the view is the chunk fileChunks[k] of the file
+    std::vector<uint64_t> chunkOffsets;
+    std::vector<uint64_t> fileChunks;
+    // page index followed by the serialized metadata, its length and the magic number
+    std::shared_ptr<arrow::Buffer> footer;
+
+    // Selected indices or all of them, which have to be below count
+    static std::vector<uint64_t> select(const std::optional<std::vector<uint64_t>>& selection, const uint64_t count) {
+        if (!selection) {
+            std::vector<uint64_t> result(count);
+            for (uint64_t i = 0; i != count; i++) result[i] = i;
+            return result;
+        }
+        for (const uint64_t i : *selection) {
+            if (i >= count) throw std::out_of_range{"selected column or rowgroup does not exist"};
+        }
+        return *selection;
+    }
+
+    static std::shared_ptr<arrow::Schema> selectSchema(const arrow::Schema& schema, const std::vector<uint64_t>& columns) {
+        if (columns.empty()) throw std::logic_error{"views have to select at least one column"};
+        arrow::FieldVector fields;
+        for (const uint64_t j : columns) fields.push_back(schema.field(j));
+        return arrow::schema(std::move(fields), schema.metadata());
+    }
+
+    static std::vector<std::vector<ChunkInfo>> selectChunkInfos(const VirtualParquetFile& file,
+                                                                const std::vector<uint64_t>& columns,
+                                                                const std::vector<uint64_t>& rowgroups) {
+        std::vector<std::vector<ChunkInfo>> result(columns.size());
+        for (size_t c = 0; c != columns.size(); c++) {
+            result[c].reserve(rowgroups.size());
+            for (const uint64_t i : rowgroups) result[c].push_back(file.chunkInfos[columns[c]][i]);
+        }
+        return result;
+    }
+
+    // The chunks of the view are the ones of the file, which are neither predicted nor registered again
+    uint64_t predictMetadataOverhead() override {
+        footer = file->writeFooter(*VirtualParquetFile::makeSchemaDescriptor(*schema), columns, rowgroups, chunkOffsets);
+        return MAGIC_NUMBER_SIZE + footer->size();
+    }
+    ChunkInfo predictChunkInfo(size_t, const ChunkInfo& info) const override { return info; }
+    void registerPrecomputedSize(size_t, size_t, ChunkInfo) override {}
+
+    // Offset within the file of the offset of the view within chunk k
+    uint64_t getFileOffset(const uint64_t k, const uint64_t offset) const {
+        return file->chunkOffsets[fileChunks[k]] + (offset - chunkOffsets[k]);
+    }
+
+    // Calls f(viewRange, fileRange) for the parts of the chunks within the range. Chunks following each
+    // other in the file are passed at once, s.t. the file serializes them together
+    template <typename F>
+    void visitChunks(const ByteRange range, F&& f) const {
+        const auto [first, last] = VirtualParquetFile::findChunks(chunkOffsets, range);
+        for (uint64_t k = first, end; k < last; k = end) {
+            for (end = k + 1; end < last && fileChunks[end] == fileChunks[end - 1] + 1;) end++;
+            const int64_t begin = std::max<int64_t>(chunkOffsets[k], range.begin);
+            const int64_t to = std::min<int64_t>(chunkOffsets[end] - 1, range.end);
+            f(ByteRange{begin, to}, ByteRange{static_cast<int64_t>(getFileOffset(k, begin)),
+                static_cast<int64_t>(getFileOffset(k, begin)) + (to - begin)});
+        }
+    }
+
+    struct Selection {
+        std::vector<uint64_t> columns;
+        std::vector<uint64_t> rowgroups;
+    };
+
+    VirtualParquetFileView(const std::shared_ptr<VirtualParquetFile>& file, Selection selection) :
+            VirtualFile(file->reader, selectSchema(*file->schema, selection.columns),
+                selectChunkInfos(*file, selection.columns, selection.rowgroups)),
+            file(file), columns(std::move(selection.columns)), rowgroups(std::move(selection.rowgroups)) {
+        uint64_t offset = MAGIC_NUMBER_SIZE;
+        for (const uint64_t i : this->rowgroups) {
+            for (const uint64_t j : this->columns) {
+                const uint64_t k = i * file->numColumns + j;
+                chunkOffsets.push_back(offset);
+                fileChunks.push_back(k);
+                offset += file->chunkOffsets[k + 1] - file->chunkOffsets[k];
+            }
+        }
+        chunkOffsets.push_back(offset);
+        size = offset + predictMetadataOverhead() - MAGIC_NUMBER_SIZE;
+    }
+
+public:
+    // View of the selected columns and rowgroups in the given order, all of them if not selected
+    VirtualParquetFileView(const std::shared_ptr<VirtualParquetFile>& file,
+                           const std::optional<std::vector<uint64_t>>& columns,
+                           const std::optional<std::vector<uint64_t>>& rowgroups = std::nullopt) :
+            VirtualParquetFileView(file, Selection{select(columns, file->numColumns), select(rowgroups, file->numRowgroups)}) {}
+
+    using VirtualFile::getRange;
+
+    // Thread-safe as long as the file is
+    void getRange(const ByteRange range, std::span<char> out) override { writeRange(range, out, nullptr); }
+    // The windows of streams keep the chunk of the file they end in
+    void getStreamRange(const ByteRange range, std::span<char> out, StreamChunk& chunk) override {
+        writeRange(range, out, &chunk);
+    }
+
+    std::vector<std::shared_ptr<arrow::Buffer>> getRangeSegments(const ByteRange range) override {
+        return getSegments(range, nullptr);
+    }
+    std::vector<std::shared_ptr<arrow::Buffer>> getStreamSegments(const ByteRange range, StreamChunk& chunk) override {
+        return getSegments(range, &chunk);
+    }
+
+private:
+    void writeRange(const ByteRange range, std::span<char> out, StreamChunk* stream) {
+        assert(range.end < static_cast<int64_t>(size));
+        assert(out.size() >= range.size());
+        // the chunks are counted by the metrics of the file
+        const auto request = startRequest(range, false);
+        if (range.begin < static_cast<int64_t>(MAGIC_NUMBER_SIZE)) {
+            const char* magic = "PAR1";
+            memcpy(out.data(), magic + range.begin, std::min<uint64_t>(MAGIC_NUMBER_SIZE - range.begin, range.size()));
+        }
+        visitChunks(range, [&](const ByteRange viewRange, const ByteRange fileRange) {
+            const std::span<char> viewOut = out.subspan(viewRange.begin - range.begin, viewRange.size());
+            if (stream) {
+                file->getStreamRange(fileRange, viewOut, *stream);
+            } else {
+                file->getRange(fileRange, viewOut);
+            }
+        });
+        const int64_t footerOffset = chunkOffsets.back();
+        if (range.end >= footerOffset) {
+            metrics.record(Counter::FooterReads);
+            const int64_t begin = std::max(range.begin, footerOffset);
+            memcpy(out.data() + (begin - range.begin), footer->data() + (begin - footerOffset), range.end - begin + 1);
+        }
+    }
+
+    std::vector<std::shared_ptr<arrow::Buffer>> getSegments(const ByteRange range, StreamChunk* stream) {
+        assert(range.end < static_cast<int64_t>(size));
+        const auto request = startRequest(range, true);
+        std::vector<std::shared_ptr<arrow::Buffer>> segments;
+        if (range.begin < static_cast<int64_t>(MAGIC_NUMBER_SIZE)) {
+            segments.push_back(arrow::SliceBuffer(arrow::Buffer::FromString("PAR1"), range.begin,
+                std::min<int64_t>(range.end + 1, MAGIC_NUMBER_SIZE) - range.begin));
+        }
+        visitChunks(range, [&](const ByteRange, const ByteRange fileRange) {
+            auto fileSegments = stream ? file->getStreamSegments(fileRange, *stream) : file->getRangeSegments(fileRange);
+            for (auto& segment : fileSegments) segments.push_back(std::move(segment));
+        });
+        const int64_t footerOffset = chunkOffsets.back();
+        if (range.end >= footerOffset) {
+            metrics.record(Counter::FooterReads);
+            const int64_t begin = std::max(range.begin, footerOffset);
+            segments.push_back(arrow::SliceBuffer(footer, begin - footerOffset, range.end - begin + 1));
+        }
+        return segments;
+    }
+};
+// -------------------------------------------------------------------------------------
+}
+// -------------------------------------------------------------------------------------
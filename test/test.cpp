@@ -2,16 +2,56 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <mutex>
+#include <random>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <arrow/api.h>
 #include <arrow/io/api.h>
+#include <arrow/io/caching.h>
+#include <arrow/ipc/api.h>
 #include <arrow/json/api.h>
+#include <arrow/util/thread_pool.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/file_reader.h>
+#include <parquet/page_index.h>
+#include <parquet/statistics.h>
 // -------------------------------------------------------------------------------
+#include "../include/RangeStream.hpp"
 #include "../include/VirtualFile.hpp"
+#include "../include/http/HttpRangeServer.hpp"
+#include "../include/io/VirtualRandomAccessFile.hpp"
+#include "../include/ipc/MappedArrowIPCReader.hpp"
+#include "../include/ipc/VirtualArrowIPCFile.hpp"
+#include "../include/parquet/MappedParquetReader.hpp"
 #include "../include/parquet/VirtualParquetFile.hpp"
+#include "../include/parquet/VirtualParquetFileView.hpp"
 // -------------------------------------------------------------------------------
 
+uint64_t footerSize(virtualfile::VirtualFile& file) {
+    const int64_t size = file.predictSizeOfFile();
+    const std::string footer = file.getRange({size - 8, size - 1});
+    return *reinterpret_cast<const int32_t*>(footer.data()) + 8;
+}
+
+std::shared_ptr<arrow::Table> readVirtualFile(virtualfile::VirtualFile& file) {
+    const auto buffer = arrow::Buffer::FromString(file.getRange({0, static_cast<int64_t>(file.predictSizeOfFile()) - 1}));
+    auto reader_res = parquet::arrow::OpenFile(std::make_shared<arrow::io::BufferReader>(buffer), arrow::default_memory_pool());
+    if (!reader_res.ok()) {
+        std::cerr << "OpenFile failed: " << reader_res.status().ToString() << "\n";
+        return nullptr;
+    }
+    auto table_res = (*reader_res)->ReadTable();
+    if (!table_res.ok()) {
+        std::cerr << "ReadTable failed: " << table_res.status().ToString() << "\n";
+        return nullptr;
+    }
+    return *table_res;
+}
+
 std::shared_ptr<arrow::Table> readTableFromFile(const std::string& path, const std::shared_ptr<arrow::Schema>& schema) {
     auto input_res = arrow::io::ReadableFile::Open(path);
     if (!input_res.ok()) {
@@ -58,10 +98,1676 @@ TEST(InMemoryTest, TestBasic) {
     std::shared_ptr<virtualfile::ArrowReader> reader =
         std::make_shared<virtualfile::InMemoryArrowReader>(table);
     const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, table->schema(), std::move(infos));
-    ASSERT_EQ(parquetFile->predictSizeOfFile(), 78);
+    ASSERT_EQ(parquetFile->predictSizeOfFile(), 4 + 2 * 31 + footerSize(*parquetFile));
     ASSERT_EQ(parquetFile->getRange({0, 3}), "PAR1");
-    const std::string columnChunkA = parquetFile->getRange({4, 36});
+    const std::string columnChunkA = parquetFile->getRange({4, 34});
     ASSERT_EQ(columnChunkA[0], 0x15);
-    ASSERT_EQ(*reinterpret_cast<const int32_t*>(columnChunkA.data() + 25), 1);
-    ASSERT_EQ(*reinterpret_cast<const int32_t*>(columnChunkA.data() + 29), 2);
-}
\ No newline at end of file
+    ASSERT_EQ(*reinterpret_cast<const int32_t*>(columnChunkA.data() + 23), 1);
+    ASSERT_EQ(*reinterpret_cast<const int32_t*>(columnChunkA.data() + 27), 2);
+}
+
+std::shared_ptr<arrow::Table> makeInt32Table(int32_t numRowgroups, int32_t rowsPerRowgroup,
+                                             std::vector<std::vector<virtualfile::ChunkInfo>>& infos) {
+    arrow::Int32Builder builder;
+    arrow::ArrayVector chunks;
+    infos.emplace_back();
+    for (int32_t i=0; i!=numRowgroups; i++) {
+        std::shared_ptr<arrow::Array> chunk;
+        for (int32_t j=0; j!=rowsPerRowgroup; j++) {
+            EXPECT_TRUE(builder.Append(i * rowsPerRowgroup + j).ok());
+        }
+        EXPECT_TRUE(builder.Finish(&chunk).ok());
+        chunks.push_back(chunk);
+        infos.back().push_back({.uncompressed_size = 4ull * rowsPerRowgroup, .tuple_count = uint64_t(rowsPerRowgroup)});
+    }
+    return arrow::Table::Make(arrow::schema({arrow::field("a", arrow::int32())}),
+        {std::make_shared<arrow::ChunkedArray>(chunks)});
+}
+
+
+TEST(InMemoryTest, TestChunkLookup) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    const auto table = makeInt32Table(100, 3, infos);
+    std::shared_ptr<virtualfile::ArrowReader> reader =
+        std::make_shared<virtualfile::InMemoryArrowReader>(table);
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, table->schema(), std::move(infos));
+    // every chunk consists of a 23 byte header followed by 3 values
+    ASSERT_EQ(parquetFile->predictSizeOfFile(), 4 + 100 * 35 + footerSize(*parquetFile));
+    for (int32_t i : {0, 42, 99}) {
+        const std::string chunk = parquetFile->getRange({4 + i * 35, 4 + i * 35 + 34});
+        ASSERT_EQ(chunk[0], 0x15);
+        ASSERT_EQ(*reinterpret_cast<const int32_t*>(chunk.data() + 23), 3 * i);
+        ASSERT_EQ(*reinterpret_cast<const int32_t*>(chunk.data() + 31), 3 * i + 2);
+    }
+}
+
+
+TEST(InMemoryTest, TestConcurrentRanges) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    const auto table = makeInt32Table(64, 3, infos);
+    std::vector<std::vector<virtualfile::ChunkInfo>> parallelInfos = infos;
+    std::shared_ptr<virtualfile::ArrowReader> reader =
+        std::make_shared<virtualfile::InMemoryArrowReader>(table);
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, table->schema(), std::move(infos));
+    const auto parallelFile = std::make_shared<virtualfile::VirtualParquetFile>(
+        reader, table->schema(), std::move(parallelInfos),
+        virtualfile::VirtualParquetFileOptions{.executor = *arrow::internal::ThreadPool::Make(4)});
+    const int64_t size = parquetFile->predictSizeOfFile();
+    const std::string expected = parquetFile->getRange({0, size - 1});
+    ASSERT_EQ(parallelFile->getRange({0, size - 1}), expected);
+
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> mismatches = 0;
+    for (int t=0; t!=4; t++) {
+        threads.emplace_back([&, t] {
+            for (int64_t chunk = t; chunk < 64; chunk += 4) {
+                const int64_t begin = 4 + chunk * 35;
+                if (parquetFile->getRange({begin, begin + 34}) != expected.substr(begin, 35)) mismatches++;
+                if (parallelFile->getRange({0, size - 1}) != expected) mismatches++;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    ASSERT_EQ(mismatches, 0);
+
+    // requests on a thread of the executor serialize the chunks themselves instead of waiting for the busy pool
+    const auto pool = *arrow::internal::ThreadPool::Make(1);
+    std::vector<std::vector<virtualfile::ChunkInfo>> pooledInfos = parquetFile->getChunkInfos();
+    const auto pooledFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, table->schema(),
+        std::move(pooledInfos), virtualfile::VirtualParquetFileOptions{.executor = pool});
+    const auto pooled = pool->Submit([&] { return pooledFile->getRange({0, size - 1}); });
+    ASSERT_TRUE(pooled.ok());
+    ASSERT_EQ(pooled->result().ValueOrDie(), expected);
+
+    // errors of chunks serialized in parallel are thrown like the ones of serial requests
+    std::vector<std::vector<virtualfile::ChunkInfo>> mismatchingInfos = parquetFile->getChunkInfos();
+    mismatchingInfos[0][5].null_count = 1;
+    const auto mismatchingFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, table->schema(),
+        std::move(mismatchingInfos), virtualfile::VirtualParquetFileOptions{.executor = pool});
+    ASSERT_THROW(mismatchingFile->getRange({0, static_cast<int64_t>(mismatchingFile->predictSizeOfFile()) - 1}), std::logic_error);
+}
+
+
+TEST(InMemoryTest, TestRangeSegments) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    const auto table = makeInt32Table(8, 100, infos);
+    std::shared_ptr<virtualfile::ArrowReader> reader =
+        std::make_shared<virtualfile::InMemoryArrowReader>(table);
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, table->schema(), std::move(infos));
+    const int64_t size = parquetFile->predictSizeOfFile();
+    const std::string expected = parquetFile->getRange({0, size - 1});
+
+    std::vector<char> out(size);
+    parquetFile->getRange({0, size - 1}, out);
+    ASSERT_EQ(std::string(out.data(), out.size()), expected);
+
+    for (const virtualfile::ByteRange range : {virtualfile::ByteRange{0, size - 1}, {0, 1}, {2, 500}, {100, 101}, {300, size - 1}}) {
+        std::string result;
+        for (const auto& segment : parquetFile->getRangeSegments(range)) {
+            result += segment->ToString();
+        }
+        ASSERT_EQ(result, expected.substr(range.begin, range.size()));
+    }
+    // the values of the numeric chunks are borrowed from the table
+    const auto segments = parquetFile->getRangeSegments({4, 4 + 27 + 400 - 1});
+    ASSERT_EQ(segments.size(), 2);
+    ASSERT_EQ(segments[1]->data(), table->column(0)->chunk(0)->data()->buffers[1]->data());
+}
+
+
+class CountingArrowReader final : public virtualfile::ArrowReader {
+    std::shared_ptr<virtualfile::ArrowReader> reader;
+public:
+    std::atomic<uint64_t> reads = 0;
+
+    explicit CountingArrowReader(const std::shared_ptr<arrow::Table>& table) :
+        ArrowReader(table->schema()), reader(std::make_shared<virtualfile::InMemoryArrowReader>(table)) {}
+
+    std::shared_ptr<arrow::Array> readChunk(const uint64_t rowgroup, const uint64_t column) override {
+        reads++;
+        return reader->readChunk(rowgroup, column);
+    }
+};
+
+
+TEST(InMemoryTest, TestChunkCache) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    const auto table = makeInt32Table(8, 100, infos);
+    std::vector<std::vector<virtualfile::ChunkInfo>> cachedInfos = infos;
+    const auto reader = std::make_shared<CountingArrowReader>(table);
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, table->schema(), std::move(infos));
+    // the cache fits 4 of the 427 byte chunks
+    const auto cache = std::make_shared<virtualfile::ChunkCache>(4 * 427);
+    const auto cachedFile = std::make_shared<virtualfile::VirtualParquetFile>(
+        reader, table->schema(), std::move(cachedInfos), virtualfile::VirtualParquetFileOptions{.cache = cache});
+    const int64_t size = parquetFile->predictSizeOfFile();
+    const std::string expected = parquetFile->getRange({0, size - 1});
+    reader->reads = 0;
+
+    // a chunk read in several parts is serialized once
+    ASSERT_EQ(cachedFile->getRange({4, 100}), expected.substr(4, 97));
+    ASSERT_EQ(cachedFile->getRange({101, 430}), expected.substr(101, 330));
+    ASSERT_EQ(reader->reads, 1);
+    ASSERT_EQ(cache->getHits(), 1);
+    ASSERT_EQ(cache->getMisses(), 1);
+
+    ASSERT_EQ(cachedFile->getRange({0, size - 1}), expected);
+    ASSERT_EQ(reader->reads, 8);
+    ASSERT_EQ(cache->getSize(), 4 * 427);
+    std::string segments;
+    for (const auto& segment : cachedFile->getRangeSegments({4 + 4 * 427, 4 + 8 * 427 - 1})) {
+        segments += segment->ToString();
+    }
+    ASSERT_EQ(segments, expected.substr(4 + 4 * 427, 4 * 427));
+    ASSERT_EQ(reader->reads, 8);
+}
+
+
+TEST(InMemoryTest, TestBatchedRanges) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    const auto table = makeInt32Table(8, 100, infos);
+    const auto reader = std::make_shared<CountingArrowReader>(table);
+    virtualfile::VirtualParquetFile parquetFile(reader, table->schema(), std::move(infos));
+    const int64_t size = parquetFile.predictSizeOfFile();
+    const std::string file = parquetFile.getRange({0, size - 1});
+    reader->reads = 0;
+
+    // the reads of a reader opening the file and reading every chunk in three parts in random order
+    std::vector<virtualfile::ByteRange> ranges{{size - 8, size - 1}, {size - static_cast<int64_t>(footerSize(parquetFile)), size - 9}};
+    for (int64_t chunk = 4; chunk < 4 + 8 * 427; chunk += 427) {
+        ranges.insert(ranges.end(), {{chunk + 300, chunk + 426}, {chunk, chunk + 99}, {chunk + 100, chunk + 299}});
+    }
+    ranges.push_back({4, 500});
+    ranges.push_back({10, 9});
+    std::mt19937 random(42);
+    std::shuffle(ranges.begin(), ranges.end(), random);
+    reader->reads = 0;
+    const auto result = parquetFile.getRanges(ranges);
+    ASSERT_EQ(result.size(), ranges.size());
+    for (size_t r = 0; r != ranges.size(); r++) {
+        ASSERT_EQ(result[r]->ToString(), file.substr(ranges[r].begin, std::max<int64_t>(ranges[r].end - ranges[r].begin + 1, 0)));
+    }
+    // every chunk is serialized once
+    ASSERT_EQ(reader->reads, 8);
+
+    // ranges further apart than the gap are served separately
+    const auto separate = parquetFile.getRanges(std::vector<virtualfile::ByteRange>{{0, 3}, {1000, 1003}}, 100);
+    ASSERT_EQ(separate[1]->ToString(), file.substr(1000, 4));
+    ASSERT_NE(separate[0]->data() + 1000, separate[1]->data());
+
+    // chunks touched by ranges further apart than the gap are serialized once, by the serial and the parallel path
+    for (const auto& executor : {std::shared_ptr<arrow::internal::ThreadPool>{}, *arrow::internal::ThreadPool::Make(4)}) {
+        std::vector<std::vector<virtualfile::ChunkInfo>> largeInfos;
+        const auto largeTable = makeInt32Table(6, 10000, largeInfos);
+        const auto largeReader = std::make_shared<CountingArrowReader>(largeTable);
+        virtualfile::VirtualParquetFile largeFile(largeReader, largeTable->schema(), std::move(largeInfos),
+            virtualfile::VirtualParquetFileOptions{.executor = executor});
+        const std::string largeContent = largeFile.getRange({0, static_cast<int64_t>(largeFile.predictSizeOfFile()) - 1});
+        largeReader->reads = 0;
+        const int64_t lastChunk = 4 + 5 * 40027;
+        const std::vector<virtualfile::ByteRange> apart{{10, 20}, {20000, 20010}, {30000, lastChunk + 100},
+                                                        {lastChunk + 30000, lastChunk + 30010}};
+        const auto served = largeFile.getRanges(apart);
+        for (size_t r = 0; r != apart.size(); r++) {
+            ASSERT_EQ(served[r]->ToString(), largeContent.substr(apart[r].begin, apart[r].size()));
+        }
+        ASSERT_EQ(largeReader->reads, 6);
+    }
+}
+
+
+TEST(InMemoryTest, TestUnalignedRanges) {
+    arrow::StringBuilder builder;
+    arrow::ArrayVector chunks;
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos{{}};
+    for (int32_t i=0; i!=4; i++) {
+        std::shared_ptr<arrow::Array> chunk;
+        uint64_t length = 0;
+        for (int32_t j=0; j!=50; j++) {
+            const std::string value(j % 7, 'a' + j % 26);
+            ASSERT_TRUE(builder.Append(value).ok());
+            length += 4 + value.size();
+        }
+        ASSERT_TRUE(builder.Finish(&chunk).ok());
+        // start the chunks at a non-zero offset
+        chunks.push_back(chunk->Slice(1));
+        infos[0].push_back({.uncompressed_size = length - 4, .tuple_count = 49});
+    }
+    const auto table = arrow::Table::Make(arrow::schema({arrow::field("s", arrow::utf8())}),
+        {std::make_shared<arrow::ChunkedArray>(chunks)});
+    std::vector<std::vector<virtualfile::ChunkInfo>> intInfos;
+    const auto intTable = makeInt32Table(4, 50, intInfos);
+
+    for (const auto& [t, chunkInfos] : {std::pair{table, infos}, std::pair{intTable, intInfos}}) {
+        std::shared_ptr<virtualfile::ArrowReader> reader = std::make_shared<virtualfile::InMemoryArrowReader>(t);
+        auto fileInfos = chunkInfos;
+        const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, t->schema(), std::move(fileInfos));
+        const int64_t size = parquetFile->predictSizeOfFile();
+        const std::string expected = parquetFile->getRange({0, size - 1});
+        for (int64_t begin = 0; begin < size; begin += 13) {
+            for (const int64_t length : {1, 2, 5, 17, 100, 301}) {
+                const int64_t end = std::min(begin + length - 1, size - 1);
+                if (end < begin) continue;
+                ASSERT_EQ(parquetFile->getRange({begin, end}), expected.substr(begin, end - begin + 1));
+            }
+        }
+    }
+}
+
+
+class AsyncCountingArrowReader final : public virtualfile::ArrowReader {
+    std::shared_ptr<virtualfile::ArrowReader> reader;
+public:
+    std::atomic<uint64_t> reads = 0;
+    std::atomic<uint64_t> asyncReads = 0;
+    std::atomic<uint64_t> finishedAsyncReads = 0;
+
+    explicit AsyncCountingArrowReader(const std::shared_ptr<arrow::Table>& table) :
+        ArrowReader(table->schema()), reader(std::make_shared<virtualfile::InMemoryArrowReader>(table)) {}
+
+    std::shared_ptr<arrow::Array> readChunk(const uint64_t rowgroup, const uint64_t column) override {
+        reads++;
+        return reader->readChunk(rowgroup, column);
+    }
+
+    arrow::Future<std::shared_ptr<arrow::Array>> readChunkAsync(
+            const uint64_t rowgroup, const uint64_t column, arrow::internal::Executor* executor) override {
+        asyncReads++;
+        return arrow::DeferNotOk(executor->Submit([this, rowgroup, column] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            auto result = reader->readChunk(rowgroup, column);
+            finishedAsyncReads++;
+            return result;
+        }));
+    }
+};
+
+
+TEST(InMemoryTest, TestReadahead) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    const auto table = makeInt32Table(16, 100, infos);
+    std::vector<std::vector<virtualfile::ChunkInfo>> readaheadInfos = infos;
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(
+        std::make_shared<virtualfile::InMemoryArrowReader>(table), table->schema(), std::move(infos));
+    const auto reader = std::make_shared<AsyncCountingArrowReader>(table);
+    const auto readaheadFile = std::make_shared<virtualfile::VirtualParquetFile>(
+        reader, table->schema(), std::move(readaheadInfos), virtualfile::VirtualParquetFileOptions{.readaheadChunks = 3});
+    const int64_t size = parquetFile->predictSizeOfFile();
+    const std::string expected = parquetFile->getRange({0, size - 1});
+
+    // footer, then all chunks in order, some of them in two requests
+    ASSERT_EQ(readaheadFile->getRange({size - 8, size - 1}), expected.substr(size - 8));
+    for (int64_t chunk = 0; chunk != 16; chunk++) {
+        const int64_t begin = 4 + chunk * 427;
+        if (chunk % 3 == 0) {
+            ASSERT_EQ(readaheadFile->getRange({begin, begin + 99}), expected.substr(begin, 100));
+            ASSERT_EQ(readaheadFile->getRange({begin + 100, begin + 426}), expected.substr(begin + 100, 327));
+        } else {
+            ASSERT_EQ(readaheadFile->getRange({begin, begin + 426}), expected.substr(begin, 427));
+        }
+    }
+    // every chunk after the first one is read ahead once, only the first chunk and the second parts
+    // of the chunks requested in two parts are read synchronously
+    ASSERT_EQ(reader->asyncReads, 15);
+    ASSERT_EQ(reader->reads, 7);
+
+    // reads of skipped chunks still running on an executor of the caller finish before the file is destroyed
+    const auto ioExecutor = *arrow::internal::ThreadPool::Make(2);
+    const auto skippingReader = std::make_shared<AsyncCountingArrowReader>(table);
+    {
+        auto skippingInfos = parquetFile->getChunkInfos();
+        virtualfile::VirtualParquetFile skippingFile(skippingReader, table->schema(), std::move(skippingInfos),
+            virtualfile::VirtualParquetFileOptions{.readaheadChunks = 3, .ioExecutor = ioExecutor});
+        ASSERT_EQ(skippingFile.getRange({4, 4 + 426}), expected.substr(4, 427));
+        ASSERT_EQ(skippingFile.getRange({4 + 10 * 427, 4 + 11 * 427 - 1}), expected.substr(4 + 10 * 427, 427));
+    }
+    ASSERT_EQ(skippingReader->finishedAsyncReads, skippingReader->asyncReads);
+
+    // chunks in the cache are not read ahead
+    const auto cachedReader = std::make_shared<AsyncCountingArrowReader>(table);
+    auto cachedInfos = parquetFile->getChunkInfos();
+    virtualfile::VirtualParquetFile cachedFile(cachedReader, table->schema(), std::move(cachedInfos),
+        virtualfile::VirtualParquetFileOptions{.cache = std::make_shared<virtualfile::ChunkCache>(1 << 20),
+            .readaheadChunks = 3});
+    for (int scan = 0; scan != 2; scan++) {
+        for (int64_t chunk = 0; chunk != 16; chunk++) {
+            const int64_t begin = 4 + chunk * 427;
+            ASSERT_EQ(cachedFile.getRange({begin, begin + 426}), expected.substr(begin, 427));
+        }
+    }
+    ASSERT_EQ(cachedReader->asyncReads, 15);
+}
+
+
+TEST(InMemoryTest, TestCompression) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    const auto table = makeInt32Table(8, 1000, infos);
+    uint64_t uncompressedSize = 0;
+    std::vector<std::vector<virtualfile::ChunkInfo>> previousInfos;
+    for (const auto codec : {arrow::Compression::UNCOMPRESSED, arrow::Compression::SNAPPY,
+                             arrow::Compression::ZSTD, arrow::Compression::LZ4}) {
+        const auto reader = std::make_shared<CountingArrowReader>(table);
+        auto fileInfos = infos;
+        const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(
+            reader, table->schema(), std::move(fileInfos), virtualfile::VirtualParquetFileOptions{.compression = codec});
+        const auto result = readVirtualFile(*parquetFile);
+        ASSERT_NE(result, nullptr);
+        ASSERT_TRUE(result->Equals(*table));
+        const int64_t size = parquetFile->predictSizeOfFile();
+        if (codec == arrow::Compression::UNCOMPRESSED) {
+            uncompressedSize = size;
+            continue;
+        }
+        if (codec == arrow::Compression::ZSTD) {
+            ASSERT_LT(size, uncompressedSize);
+        }
+
+        // the compressed sizes are computed once and reused by the next file
+        auto persistedInfos = parquetFile->getChunkInfos();
+        ASSERT_TRUE(persistedInfos[0][0].compressed_size);
+        reader->reads = 0;
+        const auto persistedFile = std::make_shared<virtualfile::VirtualParquetFile>(
+            reader, table->schema(), std::move(persistedInfos), virtualfile::VirtualParquetFileOptions{.compression = codec});
+        ASSERT_EQ(reader->reads, 0);
+        ASSERT_EQ(persistedFile->getRange({0, size - 1}), parquetFile->getRange({0, size - 1}));
+
+        // the compressed sizes of another codec are computed again
+        if (!previousInfos.empty()) {
+            const auto otherCodecFile = std::make_shared<virtualfile::VirtualParquetFile>(
+                reader, table->schema(), std::move(previousInfos), virtualfile::VirtualParquetFileOptions{.compression = codec});
+            ASSERT_EQ(otherCodecFile->predictSizeOfFile(), size);
+            ASSERT_EQ(otherCodecFile->getRange({0, size - 1}), parquetFile->getRange({0, size - 1}));
+        }
+        previousInfos = parquetFile->getChunkInfos();
+    }
+}
+
+template <typename T>
+void checkBitPacking() {
+    for (uint8_t bitWidth = 1; bitWidth <= std::min<uint8_t>(32, 8 * sizeof(T)); bitWidth++) {
+        for (uint64_t seed = 0; seed != 16; seed++) {
+            T values[8];
+            for (uint64_t i = 0; i != 8; i++) {
+                values[i] = static_cast<T>((seed * 0x9E3779B97F4A7C15ull + i * 0xBF58476D1CE4E5B9ull) >> 17)
+                    & static_cast<T>((1ull << bitWidth) - 1);
+            }
+            uint8_t packed[32] = {};
+            uint8_t expected[32] = {};
+            virtualfile::BitPacking::packGroup(values, bitWidth, packed);
+            virtualfile::BitPacking::packGroupReference(values, bitWidth, expected);
+            ASSERT_EQ(memcmp(packed, expected, sizeof(packed)), 0) << "bit width " << int(bitWidth);
+        }
+    }
+}
+
+TEST(InMemoryTest, TestBitPacking) {
+    checkBitPacking<uint8_t>();
+    checkBitPacking<uint16_t>();
+    checkBitPacking<uint32_t>();
+    checkBitPacking<uint64_t>();
+    // 0, 1, ..., 7 with 3 bits
+    const uint8_t values[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    uint8_t packed[3];
+    virtualfile::BitPacking::packGroup(values, 3, packed);
+    ASSERT_EQ(packed[0], 0b10001000);
+    ASSERT_EQ(packed[1], 0b11000110);
+    ASSERT_EQ(packed[2], 0b11111010);
+}
+
+// Table of a dictionary encoded column, expected is the same table without dictionary encoding
+template <typename IndexType>
+std::shared_ptr<arrow::Table> makeDictionaryTable(const std::shared_ptr<arrow::Array>& dictionary,
+                                                  const int32_t numRowgroups, const int32_t rowsPerRowgroup,
+                                                  std::vector<std::vector<virtualfile::ChunkInfo>>& infos,
+                                                  std::shared_ptr<arrow::Table>& expected,
+                                                  const int32_t nullEvery = 0) {
+    using CType = typename IndexType::c_type;
+    const auto type = arrow::dictionary(std::make_shared<IndexType>(), dictionary->type());
+    const uint64_t uniqueValues = dictionary->length();
+    uint64_t length = 0;
+    if (dictionary->type_id() == arrow::Type::STRING) {
+        length = static_cast<const arrow::StringArray&>(*dictionary).total_values_length();
+    }
+    std::unique_ptr<arrow::ArrayBuilder> expectedBuilder;
+    PARQUET_THROW_NOT_OK(arrow::MakeBuilder(arrow::default_memory_pool(), dictionary->type(), &expectedBuilder));
+    arrow::ArrayVector chunks;
+    infos = {{}};
+    for (int32_t i = 0; i != numRowgroups; i++) {
+        arrow::NumericBuilder<IndexType> builder;
+        uint64_t nullCount = 0;
+        for (int32_t j = 0; j != rowsPerRowgroup; j++) {
+            if (nullEvery && j % nullEvery == 0) {
+                PARQUET_THROW_NOT_OK(builder.AppendNull());
+                PARQUET_THROW_NOT_OK(expectedBuilder->AppendNull());
+                nullCount++;
+                continue;
+            }
+            const uint64_t index = (static_cast<uint64_t>(i) * rowsPerRowgroup + j) * 7919 % uniqueValues;
+            PARQUET_THROW_NOT_OK(builder.Append(static_cast<CType>(index)));
+            PARQUET_THROW_NOT_OK(expectedBuilder->AppendArraySlice(*dictionary->data(), index, 1));
+        }
+        std::shared_ptr<arrow::Array> indices;
+        PARQUET_THROW_NOT_OK(builder.Finish(&indices));
+        PARQUET_ASSIGN_OR_THROW(auto chunk, arrow::DictionaryArray::FromArrays(type, indices, dictionary));
+        chunks.push_back(chunk);
+        infos[0].push_back({.uncompressed_size = 0, .tuple_count = static_cast<uint64_t>(rowsPerRowgroup),
+            .null_count = nullCount, .dictionary_chunk_info = virtualfile::DictionaryChunkInfo{uniqueValues, length}});
+    }
+    std::shared_ptr<arrow::Array> values;
+    PARQUET_THROW_NOT_OK(expectedBuilder->Finish(&values));
+    expected = arrow::Table::Make(arrow::schema({arrow::field("d", dictionary->type())}), {values});
+    return arrow::Table::Make(arrow::schema({arrow::field("d", type)}), {std::make_shared<arrow::ChunkedArray>(chunks)});
+}
+
+std::shared_ptr<arrow::Array> makeStringDictionary(const int32_t uniqueValues) {
+    arrow::StringBuilder builder;
+    for (int32_t i = 0; i != uniqueValues; i++) {
+        PARQUET_THROW_NOT_OK(builder.Append("value" + std::to_string(i)));
+    }
+    std::shared_ptr<arrow::Array> result;
+    PARQUET_THROW_NOT_OK(builder.Finish(&result));
+    return result;
+}
+
+template <typename IndexType>
+void checkDictionaryFile(const std::shared_ptr<arrow::Array>& dictionary, const int32_t rowsPerRowgroup,
+                         const int32_t nullEvery = 0) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    std::shared_ptr<arrow::Table> expected;
+    const auto table = makeDictionaryTable<IndexType>(dictionary, 3, rowsPerRowgroup, infos, expected, nullEvery);
+    const auto reader = std::make_shared<virtualfile::InMemoryArrowReader>(table);
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, table->schema(), std::move(infos));
+    // the parquet reader decodes the dictionary
+    const auto result = readVirtualFile(*parquetFile);
+    ASSERT_NE(result, nullptr);
+    ASSERT_TRUE(result->Equals(*expected));
+
+    const int64_t size = parquetFile->predictSizeOfFile();
+    const std::string file = parquetFile->getRange({0, size - 1});
+    for (int64_t begin = 0; begin < size; begin += size / 97 + 1) {
+        for (const int64_t length : {1, 3, 29, 1000}) {
+            const int64_t end = std::min(begin + length - 1, size - 1);
+            ASSERT_EQ(parquetFile->getRange({begin, end}), file.substr(begin, end - begin + 1));
+        }
+    }
+}
+
+TEST(InMemoryTest, TestDictionaryEncoding) {
+    checkDictionaryFile<arrow::Int8Type>(makeStringDictionary(1), 101);
+    checkDictionaryFile<arrow::Int8Type>(makeStringDictionary(5), 1001);
+    checkDictionaryFile<arrow::UInt8Type>(makeStringDictionary(200), 1003);
+    checkDictionaryFile<arrow::Int16Type>(makeStringDictionary(1000), 5001);
+    checkDictionaryFile<arrow::Int32Type>(makeStringDictionary(3), 1000);
+    checkDictionaryFile<arrow::Int32Type>(makeStringDictionary(70000), 100003);
+    // nulls have no index
+    checkDictionaryFile<arrow::Int8Type>(makeStringDictionary(1), 101, 3);
+    checkDictionaryFile<arrow::Int16Type>(makeStringDictionary(1000), 5001, 4);
+    checkDictionaryFile<arrow::Int32Type>(makeStringDictionary(20), 999, 1);
+
+    std::shared_ptr<arrow::Array> numbers;
+    arrow::Int32Builder builder;
+    for (int32_t i = 0; i != 300; i++) {
+        PARQUET_THROW_NOT_OK(builder.Append(i * i - 1000));
+    }
+    PARQUET_THROW_NOT_OK(builder.Finish(&numbers));
+    checkDictionaryFile<arrow::Int16Type>(numbers, 2001);
+
+    // low cardinality strings are served several times smaller than plain encoded
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    std::shared_ptr<arrow::Table> expected;
+    const auto table = makeDictionaryTable<arrow::Int8Type>(makeStringDictionary(16), 1, 10000, infos, expected);
+    virtualfile::VirtualParquetFile dictionaryFile(
+        std::make_shared<virtualfile::InMemoryArrowReader>(table), table->schema(), std::move(infos));
+    const auto& values = static_cast<const arrow::StringArray&>(*expected->column(0)->chunk(0));
+    std::vector<std::vector<virtualfile::ChunkInfo>> plainInfos{{{.uncompressed_size =
+        static_cast<uint64_t>(4 * values.length() + values.total_values_length()), .tuple_count = 10000}}};
+    virtualfile::VirtualParquetFile plainFile(
+        std::make_shared<virtualfile::InMemoryArrowReader>(expected), expected->schema(), std::move(plainInfos));
+    ASSERT_LT(4 * dictionaryFile.predictSizeOfFile(), plainFile.predictSizeOfFile());
+
+    // file-wide compression leaves the dictionary encoded chunks uncompressed
+    std::vector<std::vector<virtualfile::ChunkInfo>> mixedInfos;
+    const auto numbersTable = makeInt32Table(1, 10000, mixedInfos);
+    const auto mixed = numbersTable->AddColumn(1, table->field(0), table->column(0)).ValueOrDie();
+    mixedInfos.push_back(dictionaryFile.getChunkInfos()[0]);
+    auto compressedInfos = mixedInfos;
+    virtualfile::VirtualParquetFile compressedFile(std::make_shared<virtualfile::InMemoryArrowReader>(mixed),
+        mixed->schema(), std::move(compressedInfos), virtualfile::VirtualParquetFileOptions{.compression = arrow::Compression::ZSTD});
+    const auto compressedResult = readVirtualFile(compressedFile);
+    ASSERT_NE(compressedResult, nullptr);
+    ASSERT_TRUE(compressedResult->column(0)->Equals(numbersTable->column(0)));
+    ASSERT_TRUE(compressedResult->column(1)->Equals(expected->column(0)));
+    const auto compressedReader = parquet::ParquetFileReader::Open(std::make_shared<arrow::io::BufferReader>(
+        arrow::Buffer::FromString(compressedFile.getRange({0, static_cast<int64_t>(compressedFile.predictSizeOfFile()) - 1}))));
+    ASSERT_EQ(compressedReader->metadata()->RowGroup(0)->ColumnChunk(0)->compression(), arrow::Compression::ZSTD);
+    ASSERT_EQ(compressedReader->metadata()->RowGroup(0)->ColumnChunk(1)->compression(), arrow::Compression::UNCOMPRESSED);
+    // naming a dictionary encoded column is an error
+    auto namedInfos = mixedInfos;
+    ASSERT_THROW(virtualfile::VirtualParquetFile(std::make_shared<virtualfile::InMemoryArrowReader>(mixed), mixed->schema(),
+        std::move(namedInfos), virtualfile::VirtualParquetFileOptions{.columnCompression = {{1, arrow::Compression::ZSTD}}}),
+        std::logic_error);
+}
+
+template <typename Builder>
+std::shared_ptr<arrow::Table> makeStringTable(const std::shared_ptr<arrow::DataType>& type, const int32_t numRowgroups,
+                                              const int32_t rowsPerRowgroup,
+                                              std::vector<std::vector<virtualfile::ChunkInfo>>& infos) {
+    arrow::ArrayVector chunks;
+    infos = {{}};
+    for (int32_t i = 0; i != numRowgroups; i++) {
+        Builder builder(type, arrow::default_memory_pool());
+        uint64_t length = 0;
+        // short values mixed with empty ones and some longer than the copies of short values
+        for (int32_t j = 0; j != rowsPerRowgroup + 1; j++) {
+            const std::string value(j % 11 == 0 ? 20 + j % 37 : j % 5, 'a' + (i + j) % 26);
+            PARQUET_THROW_NOT_OK(builder.Append(value));
+            if (j != 0) length += 4 + value.size();
+        }
+        std::shared_ptr<arrow::Array> chunk;
+        PARQUET_THROW_NOT_OK(builder.Finish(&chunk));
+        // start the chunks at a non-zero offset
+        chunks.push_back(chunk->Slice(1));
+        infos[0].push_back({.uncompressed_size = length, .tuple_count = static_cast<uint64_t>(rowsPerRowgroup)});
+    }
+    return arrow::Table::Make(arrow::schema({arrow::field("s", type)}), {std::make_shared<arrow::ChunkedArray>(chunks)});
+}
+
+TEST(InMemoryTest, TestStringTypes) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    const auto stringTable = makeStringTable<arrow::StringBuilder>(arrow::utf8(), 3, 1000, infos);
+    const auto binaryTable = makeStringTable<arrow::BinaryBuilder>(arrow::binary(), 3, 1000, infos);
+    const std::vector<std::pair<std::shared_ptr<arrow::Table>, std::shared_ptr<arrow::Table>>> tables{
+        {stringTable, makeStringTable<arrow::StringBuilder>(arrow::utf8(), 3, 1000, infos)},
+        {stringTable, makeStringTable<arrow::LargeStringBuilder>(arrow::large_utf8(), 3, 1000, infos)},
+        {stringTable, makeStringTable<arrow::StringViewBuilder>(arrow::utf8_view(), 3, 1000, infos)},
+        {binaryTable, makeStringTable<arrow::LargeBinaryBuilder>(arrow::large_binary(), 3, 1000, infos)},
+        {binaryTable, makeStringTable<arrow::BinaryViewBuilder>(arrow::binary_view(), 3, 1000, infos)},
+    };
+    std::string stringFile;
+    for (const auto& [expected, table] : tables) {
+        auto fileInfos = infos;
+        const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(
+            std::make_shared<virtualfile::InMemoryArrowReader>(table), table->schema(), std::move(fileInfos));
+        const auto result = readVirtualFile(*parquetFile);
+        ASSERT_NE(result, nullptr);
+        ASSERT_TRUE(result->column(0)->Equals(*expected->column(0)));
+
+        const int64_t size = parquetFile->predictSizeOfFile();
+        const std::string file = parquetFile->getRange({0, size - 1});
+        // the layout of the values does not depend on the arrow type
+        if (table->schema()->field(0)->type()->id() == arrow::Type::STRING) stringFile = file;
+        if (expected == stringTable) {
+            ASSERT_TRUE(file == stringFile);
+        }
+        for (int64_t begin = 0; begin < size; begin += 7) {
+            for (const int64_t length : {1, 6, 23, 300}) {
+                const int64_t end = std::min(begin + length - 1, size - 1);
+                ASSERT_TRUE(parquetFile->getRange({begin, end}) == file.substr(begin, end - begin + 1));
+            }
+        }
+    }
+}
+
+// Chunk infos of a table without dictionary encoded columns
+std::vector<std::vector<virtualfile::ChunkInfo>> getChunkInfos(const std::shared_ptr<arrow::Table>& table) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos(table->num_columns());
+    for (int j = 0; j != table->num_columns(); j++) {
+        for (const auto& chunk : table->column(j)->chunks()) {
+            infos[j].push_back({.uncompressed_size = virtualfile::ColumnChunkWriter::getValuesSize(chunk),
+                .tuple_count = static_cast<uint64_t>(chunk->length()),
+                .null_count = static_cast<uint64_t>(chunk->null_count())});
+        }
+    }
+    return infos;
+}
+
+// Column of the given type, whose value i is null if isNull(i)
+template <typename Builder, typename Value, typename IsNull>
+std::shared_ptr<arrow::ChunkedArray> makeColumn(const std::shared_ptr<arrow::DataType>& type, const int32_t numRowgroups,
+                                                const int32_t rowsPerRowgroup, Value value, IsNull isNull) {
+    arrow::ArrayVector chunks;
+    for (int32_t i = 0; i != numRowgroups; i++) {
+        Builder builder(type, arrow::default_memory_pool());
+        // start the chunks at an offset, which is not a multiple of 8
+        for (int32_t j = -3; j != rowsPerRowgroup; j++) {
+            const int32_t row = i * rowsPerRowgroup + j + 3;
+            if (isNull(row)) {
+                PARQUET_THROW_NOT_OK(builder.AppendNull());
+            } else {
+                PARQUET_THROW_NOT_OK(builder.Append(value(row)));
+            }
+        }
+        std::shared_ptr<arrow::Array> chunk;
+        PARQUET_THROW_NOT_OK(builder.Finish(&chunk));
+        chunks.push_back(chunk->Slice(3));
+    }
+    return std::make_shared<arrow::ChunkedArray>(chunks);
+}
+
+TEST(InMemoryTest, TestNullableColumns) {
+    constexpr int32_t numRowgroups = 3;
+    constexpr int32_t rows = 1001;
+    const auto sometimes = [](const int32_t row) { return row % 3 == 0 || row % 7 == 0; };
+    const auto never = [](int32_t) { return false; };
+    const auto always = [](int32_t) { return true; };
+    // nulls in some rowgroups only
+    const auto rowgroupZero = [](const int32_t row) { return row < rows; };
+    const auto decimal = [](const int32_t row) { return arrow::Decimal128(static_cast<int64_t>(row) * 997 - 500000); };
+    const auto decimal256 = [](const int32_t row) { return arrow::Decimal256(static_cast<int64_t>(row) * -1234567); };
+
+    const auto table = arrow::Table::Make(arrow::schema({
+        arrow::field("int32", arrow::int32()),
+        arrow::field("int64", arrow::int64()),
+        arrow::field("required", arrow::int64(), false),
+        arrow::field("float", arrow::float32()),
+        arrow::field("double", arrow::float64()),
+        arrow::field("bool", arrow::boolean()),
+        arrow::field("requiredBool", arrow::boolean(), false),
+        arrow::field("date", arrow::date32()),
+        arrow::field("timestamp", arrow::timestamp(arrow::TimeUnit::MICRO)),
+        arrow::field("timestampNanos", arrow::timestamp(arrow::TimeUnit::NANO)),
+        arrow::field("decimal", arrow::decimal128(12, 2)),
+        arrow::field("decimal256", arrow::decimal256(45, 3)),
+        arrow::field("string", arrow::utf8()),
+        arrow::field("binary", arrow::binary()),
+    }), {
+        makeColumn<arrow::Int32Builder>(arrow::int32(), numRowgroups, rows, [](int32_t row) { return row * 3; }, sometimes),
+        makeColumn<arrow::Int64Builder>(arrow::int64(), numRowgroups, rows, [](int32_t row) { return row * 1000000007ll; }, rowgroupZero),
+        makeColumn<arrow::Int64Builder>(arrow::int64(), numRowgroups, rows, [](int32_t row) { return -row; }, never),
+        makeColumn<arrow::FloatBuilder>(arrow::float32(), numRowgroups, rows, [](int32_t row) { return row / 4.0f; }, always),
+        makeColumn<arrow::DoubleBuilder>(arrow::float64(), numRowgroups, rows, [](int32_t row) { return row / 3.0; }, sometimes),
+        makeColumn<arrow::BooleanBuilder>(arrow::boolean(), numRowgroups, rows, [](int32_t row) { return row % 5 < 2; }, sometimes),
+        makeColumn<arrow::BooleanBuilder>(arrow::boolean(), numRowgroups, rows, [](int32_t row) { return row % 3 == 1; }, never),
+        makeColumn<arrow::Date32Builder>(arrow::date32(), numRowgroups, rows, [](int32_t row) { return 18000 + row; }, sometimes),
+        makeColumn<arrow::TimestampBuilder>(arrow::timestamp(arrow::TimeUnit::MICRO), numRowgroups, rows,
+            [](int32_t row) { return row * 1000003ll; }, sometimes),
+        makeColumn<arrow::TimestampBuilder>(arrow::timestamp(arrow::TimeUnit::NANO), numRowgroups, rows,
+            [](int32_t row) { return row * 1000000007ll; }, never),
+        makeColumn<arrow::Decimal128Builder>(arrow::decimal128(12, 2), numRowgroups, rows, decimal, sometimes),
+        makeColumn<arrow::Decimal256Builder>(arrow::decimal256(45, 3), numRowgroups, rows, decimal256, sometimes),
+        makeColumn<arrow::StringBuilder>(arrow::utf8(), numRowgroups, rows,
+            [](int32_t row) { return std::string(row % 23, 'a' + row % 26); }, sometimes),
+        makeColumn<arrow::BinaryBuilder>(arrow::binary(), numRowgroups, rows,
+            [](int32_t row) { return std::string(row % 5, static_cast<char>(row)); }, rowgroupZero),
+    });
+
+    for (const auto codec : {arrow::Compression::UNCOMPRESSED, arrow::Compression::ZSTD}) {
+        const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(
+            std::make_shared<virtualfile::InMemoryArrowReader>(table), table->schema(), getChunkInfos(table),
+            virtualfile::VirtualParquetFileOptions{.compression = codec});
+        const auto result = readVirtualFile(*parquetFile);
+        ASSERT_NE(result, nullptr);
+        for (int j = 0; j != table->num_columns(); j++) {
+            ASSERT_TRUE(result->field(j)->Equals(table->field(j))) << result->field(j)->ToString();
+            ASSERT_TRUE(result->column(j)->Equals(table->column(j))) << table->field(j)->ToString();
+        }
+
+        const int64_t size = parquetFile->predictSizeOfFile();
+        const std::string file = parquetFile->getRange({0, size - 1});
+        for (int64_t begin = 0; begin < size; begin += 17) {
+            for (const int64_t length : {1, 9, 250}) {
+                const int64_t end = std::min(begin + length - 1, size - 1);
+                ASSERT_TRUE(parquetFile->getRange({begin, end}) == file.substr(begin, end - begin + 1));
+            }
+        }
+    }
+
+    // parquet has no timestamps in seconds, they are served in milliseconds
+    const auto seconds = arrow::Table::Make(arrow::schema({arrow::field("s", arrow::timestamp(arrow::TimeUnit::SECOND))}),
+        {makeColumn<arrow::TimestampBuilder>(arrow::timestamp(arrow::TimeUnit::SECOND), 2, 100,
+            [](int32_t row) { return row * 60ll; }, sometimes)});
+    const auto millis = makeColumn<arrow::TimestampBuilder>(arrow::timestamp(arrow::TimeUnit::MILLI), 2, 100,
+        [](int32_t row) { return row * 60000ll; }, sometimes);
+    virtualfile::VirtualParquetFile secondsFile(std::make_shared<virtualfile::InMemoryArrowReader>(seconds),
+        seconds->schema(), getChunkInfos(seconds));
+    const auto result = readVirtualFile(secondsFile);
+    ASSERT_NE(result, nullptr);
+    ASSERT_TRUE(result->column(0)->Equals(millis));
+
+    // the chunk info has to match the chunks
+    auto infos = getChunkInfos(table);
+    infos[0][1].null_count++;
+    virtualfile::VirtualParquetFile mismatchingFile(std::make_shared<virtualfile::InMemoryArrowReader>(table),
+        table->schema(), std::move(infos));
+    ASSERT_THROW(mismatchingFile.getRange({0, static_cast<int64_t>(mismatchingFile.predictSizeOfFile()) - 1}), std::logic_error);
+}
+
+// Adds the zone maps of the chunks of a numeric column to its chunk infos
+template <typename ArrowType>
+void addZoneMaps(const std::shared_ptr<arrow::ChunkedArray>& column, std::vector<virtualfile::ChunkInfo>& infos) {
+    using CType = typename ArrowType::c_type;
+    for (int i = 0; i != column->num_chunks(); i++) {
+        const auto& chunk = static_cast<const arrow::NumericArray<ArrowType>&>(*column->chunk(i));
+        CType min = std::numeric_limits<CType>::max();
+        CType max = std::numeric_limits<CType>::lowest();
+        for (int64_t k = 0; k != chunk.length(); k++) {
+            if (chunk.IsValid(k)) {
+                min = std::min(min, chunk.Value(k));
+                max = std::max(max, chunk.Value(k));
+            }
+        }
+        virtualfile::ZoneMap zoneMap{};
+        memcpy(zoneMap.min_value.data(), &min, sizeof(CType));
+        memcpy(zoneMap.max_value.data(), &max, sizeof(CType));
+        infos[i].zone_map = zoneMap;
+    }
+}
+
+TEST(InMemoryTest, TestStatistics) {
+    constexpr int32_t numRowgroups = 3;
+    constexpr int32_t rows = 500;
+    const auto sometimes = [](const int32_t row) { return row % 3 == 0 || row % 7 == 0; };
+    const auto never = [](int32_t) { return false; };
+    // the chunks of the first rowgroup contain the rows [3, rows + 3)
+    const auto rowgroupZero = [](const int32_t row) { return row < rows + 3; };
+    const auto table = arrow::Table::Make(arrow::schema({
+        arrow::field("int32", arrow::int32()),
+        arrow::field("double", arrow::float64()),
+        arrow::field("seconds", arrow::timestamp(arrow::TimeUnit::SECOND)),
+        arrow::field("string", arrow::utf8()),
+    }), {
+        makeColumn<arrow::Int32Builder>(arrow::int32(), numRowgroups, rows, [](int32_t row) { return 7 - row; }, sometimes),
+        makeColumn<arrow::DoubleBuilder>(arrow::float64(), numRowgroups, rows, [](int32_t row) { return row / 3.0; }, rowgroupZero),
+        makeColumn<arrow::TimestampBuilder>(arrow::timestamp(arrow::TimeUnit::SECOND), numRowgroups, rows,
+            [](int32_t row) { return row * 60ll; }, never),
+        makeColumn<arrow::StringBuilder>(arrow::utf8(), numRowgroups, rows,
+            [](int32_t row) { return std::string(row % 7, 'x'); }, sometimes),
+    });
+    auto infos = getChunkInfos(table);
+    addZoneMaps<arrow::Int32Type>(table->column(0), infos[0]);
+    addZoneMaps<arrow::DoubleType>(table->column(1), infos[1]);
+    addZoneMaps<arrow::TimestampType>(table->column(2), infos[2]);
+
+    for (const bool writePageIndex : {false, true}) {
+        auto fileInfos = infos;
+        virtualfile::VirtualParquetFile parquetFile(std::make_shared<virtualfile::InMemoryArrowReader>(table),
+            table->schema(), std::move(fileInfos), virtualfile::VirtualParquetFileOptions{.writePageIndex = writePageIndex});
+        const auto result = readVirtualFile(parquetFile);
+        ASSERT_NE(result, nullptr);
+        ASSERT_TRUE(result->column(0)->Equals(table->column(0)));
+        ASSERT_TRUE(result->column(3)->Equals(table->column(3)));
+
+        const auto buffer = arrow::Buffer::FromString(
+            parquetFile.getRange({0, static_cast<int64_t>(parquetFile.predictSizeOfFile()) - 1}));
+        const auto reader = parquet::ParquetFileReader::Open(std::make_shared<arrow::io::BufferReader>(buffer));
+        const auto metadata = reader->metadata();
+        for (int i = 0; i != numRowgroups; i++) {
+            const auto int32Chunk = metadata->RowGroup(i)->ColumnChunk(0);
+            const auto int32Statistics = std::static_pointer_cast<parquet::Int32Statistics>(int32Chunk->statistics());
+            ASSERT_TRUE(int32Statistics->HasMinMax());
+            const int32_t first = i * rows + 3;
+            int32_t firstValid = first;
+            int32_t lastValid = first + rows - 1;
+            while (sometimes(firstValid)) firstValid++;
+            while (sometimes(lastValid)) lastValid--;
+            ASSERT_EQ(int32Statistics->min(), 7 - lastValid);
+            ASSERT_EQ(int32Statistics->max(), 7 - firstValid);
+            ASSERT_EQ(int32Statistics->null_count(), table->column(0)->chunk(i)->null_count());
+
+            const auto doubleStatistics = metadata->RowGroup(i)->ColumnChunk(1)->statistics();
+            ASSERT_EQ(doubleStatistics->HasMinMax(), i != 0);
+            ASSERT_EQ(doubleStatistics->null_count(), i == 0 ? rows : 0);
+
+            // seconds are served as milliseconds
+            const auto secondsStatistics = std::static_pointer_cast<parquet::Int64Statistics>(
+                metadata->RowGroup(i)->ColumnChunk(2)->statistics());
+            ASSERT_EQ(secondsStatistics->min(), first * 60000ll);
+            ASSERT_EQ(secondsStatistics->max(), (first + rows - 1) * 60000ll);
+
+            // strings do not fit into the zone map
+            const auto stringStatistics = metadata->RowGroup(i)->ColumnChunk(3)->statistics();
+            ASSERT_FALSE(stringStatistics->HasMinMax());
+            ASSERT_EQ(stringStatistics->null_count(), table->column(3)->chunk(i)->null_count());
+        }
+
+        const auto pageIndexReader = reader->GetPageIndexReader();
+        for (int i = 0; i != numRowgroups; i++) {
+            const auto rowgroupIndex = pageIndexReader ? pageIndexReader->RowGroup(i) : nullptr;
+            if (!writePageIndex) {
+                ASSERT_TRUE(!rowgroupIndex || !rowgroupIndex->GetOffsetIndex(0));
+                continue;
+            }
+            ASSERT_NE(rowgroupIndex, nullptr);
+            const auto int32Index = std::static_pointer_cast<parquet::Int32ColumnIndex>(rowgroupIndex->GetColumnIndex(0));
+            ASSERT_NE(int32Index, nullptr);
+            const auto int32Statistics = std::static_pointer_cast<parquet::Int32Statistics>(
+                metadata->RowGroup(i)->ColumnChunk(0)->statistics());
+            ASSERT_EQ(int32Index->min_values(), std::vector<int32_t>{int32Statistics->min()});
+            ASSERT_EQ(int32Index->max_values(), std::vector<int32_t>{int32Statistics->max()});
+            ASSERT_EQ(int32Index->null_pages(), std::vector<bool>{false});
+            const auto doubleIndex = rowgroupIndex->GetColumnIndex(1);
+            ASSERT_NE(doubleIndex, nullptr);
+            ASSERT_EQ(doubleIndex->null_pages(), std::vector<bool>{i == 0});
+            ASSERT_EQ(rowgroupIndex->GetColumnIndex(3), nullptr);
+            for (int j = 0; j != table->num_columns(); j++) {
+                const auto offsetIndex = rowgroupIndex->GetOffsetIndex(j);
+                ASSERT_NE(offsetIndex, nullptr);
+                ASSERT_EQ(offsetIndex->page_locations().size(), 1);
+                const auto chunk = metadata->RowGroup(i)->ColumnChunk(j);
+                ASSERT_EQ(offsetIndex->page_locations()[0].offset, chunk->data_page_offset());
+                ASSERT_EQ(offsetIndex->page_locations()[0].compressed_page_size, chunk->total_compressed_size());
+            }
+        }
+    }
+}
+
+TEST(InMemoryTest, TestPages) {
+    constexpr int32_t numRowgroups = 3;
+    constexpr int32_t rows = 1000;
+    constexpr uint64_t pageRows = 128;
+    const auto sometimes = [](const int32_t row) { return row % 3 == 0 || row % 7 == 0; };
+    const auto never = [](int32_t) { return false; };
+    const auto plain = arrow::Table::Make(arrow::schema({
+        arrow::field("int32", arrow::int32()),
+        arrow::field("int64", arrow::int64()),
+        arrow::field("string", arrow::utf8()),
+        arrow::field("bool", arrow::boolean()),
+    }), {
+        makeColumn<arrow::Int32Builder>(arrow::int32(), numRowgroups, rows, [](int32_t row) { return row; }, never),
+        makeColumn<arrow::Int64Builder>(arrow::int64(), numRowgroups, rows, [](int32_t row) { return row * 3ll; }, sometimes),
+        makeColumn<arrow::StringBuilder>(arrow::utf8(), numRowgroups, rows,
+            [](int32_t row) { return std::string(row % 11, 'a' + row % 26); }, sometimes),
+        makeColumn<arrow::BooleanBuilder>(arrow::boolean(), numRowgroups, rows, [](int32_t row) { return row % 3 == 1; }, never),
+    });
+    std::vector<std::vector<virtualfile::ChunkInfo>> dictionaryInfos;
+    std::shared_ptr<arrow::Table> expectedDictionary;
+    const auto dictionary = makeDictionaryTable<arrow::Int16Type>(makeStringDictionary(300), numRowgroups, rows,
+        dictionaryInfos, expectedDictionary, 5);
+    const auto table = plain->AddColumn(4, dictionary->field(0), dictionary->column(0)).ValueOrDie();
+    auto infos = getChunkInfos(plain);
+    infos.push_back(dictionaryInfos[0]);
+
+    const virtualfile::VirtualParquetFileOptions options{
+        .columnCompression = {{1, arrow::Compression::ZSTD}, {2, arrow::Compression::ZSTD}},
+        .writePageIndex = true, .pageRows = pageRows};
+    const auto reader = std::make_shared<CountingArrowReader>(table);
+    auto fileInfos = infos;
+    virtualfile::VirtualParquetFile parquetFile(reader, table->schema(), std::move(fileInfos), options);
+    const auto result = readVirtualFile(parquetFile);
+    ASSERT_NE(result, nullptr);
+    for (int j = 0; j != plain->num_columns(); j++) {
+        ASSERT_TRUE(result->column(j)->Equals(plain->column(j))) << plain->field(j)->ToString();
+    }
+    ASSERT_TRUE(result->column(4)->Equals(expectedDictionary->column(0)));
+
+    // every data page holds at most pageRows rows
+    const int64_t size = parquetFile.predictSizeOfFile();
+    const std::string file = parquetFile.getRange({0, size - 1});
+    const auto parquetReader = parquet::ParquetFileReader::Open(
+        std::make_shared<arrow::io::BufferReader>(arrow::Buffer::FromString(file)));
+    for (int i = 0; i != numRowgroups; i++) {
+        const auto rowgroupIndex = parquetReader->GetPageIndexReader()->RowGroup(i);
+        int64_t uncompressedSize = 0;
+        for (int j = 0; j != table->num_columns(); j++) {
+            const auto offsetIndex = rowgroupIndex->GetOffsetIndex(j);
+            const auto& locations = offsetIndex->page_locations();
+            ASSERT_EQ(locations.size(), (rows + pageRows - 1) / pageRows);
+            for (size_t p = 0; p != locations.size(); p++) {
+                ASSERT_EQ(locations[p].first_row_index, p * pageRows);
+            }
+            const auto chunk = parquetReader->metadata()->RowGroup(i)->ColumnChunk(j);
+            ASSERT_EQ(locations[0].offset, chunk->data_page_offset());
+            ASSERT_EQ(locations.back().offset + locations.back().compressed_page_size,
+                (chunk->has_dictionary_page() ? chunk->dictionary_page_offset() : chunk->data_page_offset())
+                    + chunk->total_compressed_size());
+            uncompressedSize += chunk->total_uncompressed_size();
+        }
+        ASSERT_EQ(parquetReader->metadata()->RowGroup(i)->total_byte_size(), uncompressedSize);
+    }
+
+    for (int64_t begin = 0; begin < size; begin += size / 201 + 1) {
+        for (const int64_t length : {1, 9, 250, 3000}) {
+            const virtualfile::ByteRange range{begin, std::min(begin + length - 1, size - 1)};
+            ASSERT_TRUE(parquetFile.getRange(range) == file.substr(range.begin, range.size()));
+            std::string segments;
+            for (const auto& segment : parquetFile.getRangeSegments(range)) {
+                segments += segment->ToString();
+            }
+            ASSERT_TRUE(segments == file.substr(range.begin, range.size()));
+        }
+    }
+
+    // the pages are computed once and reused by the next file
+    auto persistedInfos = parquetFile.getChunkInfos();
+    ASSERT_EQ(persistedInfos[2][0].pages.size(), (rows + pageRows - 1) / pageRows);
+    reader->reads = 0;
+    virtualfile::VirtualParquetFile persistedFile(reader, table->schema(), std::move(persistedInfos), options);
+    ASSERT_EQ(reader->reads, 0);
+    ASSERT_EQ(persistedFile.getRange({0, size - 1}), file);
+
+    // the page size limits the size of the values of a page
+    auto sizedInfos = infos;
+    virtualfile::VirtualParquetFile sizedFile(std::make_shared<virtualfile::InMemoryArrowReader>(table),
+        table->schema(), std::move(sizedInfos), virtualfile::VirtualParquetFileOptions{.pageSize = 1000});
+    ASSERT_EQ(sizedFile.getChunkInfos()[0][0].pages.size(), 4);
+    ASSERT_EQ(sizedFile.getChunkInfos()[0][0].pages[0].uncompressed_size, 1000);
+    const auto sizedResult = readVirtualFile(sizedFile);
+    ASSERT_NE(sizedResult, nullptr);
+    ASSERT_TRUE(sizedResult->column(2)->Equals(plain->column(2)));
+
+    // the null counts of the pages have to match the chunks
+    auto mismatchingInfos = parquetFile.getChunkInfos();
+    mismatchingInfos[1][0].pages[0].null_count--;
+    mismatchingInfos[1][0].pages[1].null_count++;
+    virtualfile::VirtualParquetFile mismatchingFile(std::make_shared<virtualfile::InMemoryArrowReader>(table),
+        table->schema(), std::move(mismatchingInfos), options);
+    ASSERT_THROW(mismatchingFile.getRange({0, size - 1}), std::logic_error);
+}
+
+
+TEST(InMemoryTest, TestPageHeaderSize) {
+    using DefinitionLevels = virtualfile::ParquetUtils::DefinitionLevels;
+    for (const uint64_t size : {0ull, 1ull, 63ull, 64ull, 8191ull, 8192ull, 1ull << 31, 1ull << 40}) {
+        for (const bool isDictionaryPage : {false, true}) {
+            ASSERT_EQ(virtualfile::ParquetUtils::getPageHeaderSize(size, size / 3, size + 1, isDictionaryPage),
+                virtualfile::ParquetUtils::writePageHeader(size, size / 3, size + 1, isDictionaryPage).size());
+        }
+        for (const auto levels : {DefinitionLevels::REQUIRED, DefinitionLevels::ALL_VALID, DefinitionLevels::ALL_NULL,
+                                  DefinitionLevels::BITMAP}) {
+            ASSERT_EQ(virtualfile::ParquetUtils::getDefinitionLevelsPrefixSize(size, levels),
+                virtualfile::ParquetUtils::writeDefinitionLevels(size, levels).size());
+        }
+        for (const uint8_t bitWidth : {0, 1, 7, 32}) {
+            ASSERT_EQ(virtualfile::ParquetUtils::getDictionaryIndicesPrefixSize(size, bitWidth),
+                virtualfile::ParquetUtils::writeDictionaryIndicesPrefix(size, bitWidth).size());
+        }
+    }
+}
+
+
+TEST(InMemoryTest, TestLayoutSnapshot) {
+    constexpr int32_t numRowgroups = 4;
+    constexpr int32_t rows = 500;
+    const auto plain = arrow::Table::Make(arrow::schema({
+        arrow::field("int32", arrow::int32()),
+        arrow::field("string", arrow::utf8()),
+    }), {
+        makeColumn<arrow::Int32Builder>(arrow::int32(), numRowgroups, rows, [](int32_t row) { return row; },
+            [](int32_t) { return false; }),
+        makeColumn<arrow::StringBuilder>(arrow::utf8(), numRowgroups, rows,
+            [](int32_t row) { return std::string(row % 13, 'a' + row % 26); }, [](int32_t row) { return row % 4 == 0; }),
+    });
+    std::vector<std::vector<virtualfile::ChunkInfo>> dictionaryInfos;
+    std::shared_ptr<arrow::Table> expectedDictionary;
+    const auto dictionary = makeDictionaryTable<arrow::Int16Type>(makeStringDictionary(100), numRowgroups, rows,
+        dictionaryInfos, expectedDictionary, 3);
+    const auto table = plain->AddColumn(2, dictionary->field(0), dictionary->column(0)).ValueOrDie();
+    auto infos = getChunkInfos(plain);
+    infos.push_back(dictionaryInfos[0]);
+
+    const virtualfile::VirtualParquetFileOptions options{
+        .columnCompression = {{1, arrow::Compression::ZSTD}}, .writePageIndex = true, .pageRows = 100};
+    const auto reader = std::make_shared<CountingArrowReader>(table);
+    virtualfile::VirtualParquetFile parquetFile(reader, table->schema(), std::move(infos), options);
+    const int64_t size = parquetFile.predictSizeOfFile();
+    const std::string file = parquetFile.getRange({0, size - 1});
+
+    const std::string path = testing::TempDir() + "layout.snapshot";
+    {
+        const auto snapshot = parquetFile.getLayoutSnapshot();
+        auto output = arrow::io::FileOutputStream::Open(path).ValueOrDie();
+        ASSERT_TRUE(output->Write(snapshot).ok());
+        ASSERT_TRUE(output->Close().ok());
+    }
+
+    // the snapshot opens the file without reading any chunk and serves the same bytes
+    reader->reads = 0;
+    virtualfile::VirtualParquetFile snapshotFile(reader, table->schema(),
+        virtualfile::LayoutSnapshotReader::map(path), options);
+    ASSERT_EQ(reader->reads, 0);
+    ASSERT_EQ(snapshotFile.predictSizeOfFile(), size);
+    ASSERT_TRUE(snapshotFile.getRange({0, size - 1}) == file);
+    for (int64_t begin = 0; begin < size; begin += size / 101 + 1) {
+        const virtualfile::ByteRange range{begin, std::min<int64_t>(begin + 700, size - 1)};
+        std::string segments;
+        for (const auto& segment : snapshotFile.getRangeSegments(range)) {
+            segments += segment->ToString();
+        }
+        ASSERT_TRUE(segments == file.substr(range.begin, range.size()));
+    }
+    ASSERT_EQ(snapshotFile.getLayoutSnapshot()->ToString(), parquetFile.getLayoutSnapshot()->ToString());
+
+    // the chunk infos of the snapshot are the ones of the file
+    const auto& snapshotInfos = snapshotFile.getChunkInfos();
+    ASSERT_EQ(snapshotInfos[1][2].compressed_size, parquetFile.getChunkInfos()[1][2].compressed_size);
+    ASSERT_EQ(snapshotInfos[1][2].pages.size(), 5);
+    ASSERT_EQ(snapshotInfos[1][2].pages[3].null_count, parquetFile.getChunkInfos()[1][2].pages[3].null_count);
+
+    // snapshots are only valid for the options they were taken with
+    ASSERT_THROW(virtualfile::VirtualParquetFile(reader, table->schema(), virtualfile::LayoutSnapshotReader::map(path),
+        virtualfile::VirtualParquetFileOptions{.pageRows = 100}), std::logic_error);
+    ASSERT_THROW(virtualfile::LayoutSnapshotReader(arrow::Buffer::FromString("PAR1")), std::runtime_error);
+
+    // snapshots with chunk offsets out of order are rejected instead of serving pages outside their chunks
+    std::string corrupt = parquetFile.getLayoutSnapshot()->ToString();
+    const uint64_t chunkOffsetsPrefix[] = {13, 4};
+    const size_t position = corrupt.find(std::string_view(reinterpret_cast<const char*>(chunkOffsetsPrefix),
+        sizeof(chunkOffsetsPrefix)));
+    ASSERT_NE(position, std::string::npos);
+    std::swap_ranges(corrupt.begin() + position + 16, corrupt.begin() + position + 24, corrupt.begin() + position + 24);
+    ASSERT_THROW(virtualfile::VirtualParquetFile(reader, table->schema(),
+        virtualfile::LayoutSnapshotReader(arrow::Buffer::FromString(corrupt)), options), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+
+TEST(InMemoryTest, TestEncodingSelection) {
+    constexpr int32_t numRowgroups = 3;
+    constexpr int32_t rows = 1001;
+    const auto sometimes = [](const int32_t row) { return row % 3 == 0 || row % 7 == 0; };
+    const auto never = [](int32_t) { return false; };
+    const auto table = arrow::Table::Make(arrow::schema({
+        arrow::field("key", arrow::int64(), false),
+        arrow::field("int32", arrow::int32()),
+        arrow::field("timestamp", arrow::timestamp(arrow::TimeUnit::SECOND)),
+        arrow::field("double", arrow::float64()),
+        arrow::field("decimal", arrow::decimal128(12, 2)),
+        arrow::field("string", arrow::utf8()),
+        arrow::field("bool", arrow::boolean()),
+    }), {
+        makeColumn<arrow::Int64Builder>(arrow::int64(), numRowgroups, rows, [](int32_t row) { return row * 2ll; }, never),
+        makeColumn<arrow::Int32Builder>(arrow::int32(), numRowgroups, rows,
+            [](int32_t row) { return static_cast<int32_t>(row * 2654435761u); }, sometimes),
+        makeColumn<arrow::TimestampBuilder>(arrow::timestamp(arrow::TimeUnit::SECOND), numRowgroups, rows,
+            [](int32_t row) { return 1700000000ll + row * 60 + row % 7; }, sometimes),
+        makeColumn<arrow::DoubleBuilder>(arrow::float64(), numRowgroups, rows, [](int32_t row) { return 100.0 + row / 7.0; }, never),
+        makeColumn<arrow::Decimal128Builder>(arrow::decimal128(12, 2), numRowgroups, rows,
+            [](int32_t row) { return arrow::Decimal128(static_cast<int64_t>(row) * 997 - 500000); }, sometimes),
+        makeColumn<arrow::StringBuilder>(arrow::utf8(), numRowgroups, rows,
+            [](int32_t row) { return std::to_string(row * 37); }, sometimes),
+        makeColumn<arrow::BooleanBuilder>(arrow::boolean(), numRowgroups, rows, [](int32_t row) { return row % 3 == 1; }, never),
+    });
+    const auto infos = getChunkInfos(table);
+
+    for (const auto codec : {arrow::Compression::UNCOMPRESSED, arrow::Compression::ZSTD}) {
+        auto plainInfos = infos;
+        virtualfile::VirtualParquetFile plainFile(std::make_shared<virtualfile::InMemoryArrowReader>(table),
+            table->schema(), std::move(plainInfos), virtualfile::VirtualParquetFileOptions{.compression = codec});
+        const virtualfile::VirtualParquetFileOptions options{.compression = codec, .pageRows = 300,
+            .encodingPolicy = virtualfile::EncodingPolicy::SMALLEST};
+        const auto reader = std::make_shared<CountingArrowReader>(table);
+        auto fileInfos = infos;
+        virtualfile::VirtualParquetFile parquetFile(reader, table->schema(), std::move(fileInfos), options);
+        const int64_t size = parquetFile.predictSizeOfFile();
+        ASSERT_LT(size, plainFile.predictSizeOfFile());
+        const auto result = readVirtualFile(parquetFile);
+        ASSERT_NE(result, nullptr);
+        ASSERT_TRUE(result->Equals(*readVirtualFile(plainFile)));
+
+        // the sorted keys are delta encoded, the booleans have no other encoding
+        const std::string file = parquetFile.getRange({0, size - 1});
+        const auto metadata = parquet::ParquetFileReader::Open(
+            std::make_shared<arrow::io::BufferReader>(arrow::Buffer::FromString(file)))->metadata();
+        const auto dataEncoding = [&](const int column) {
+            return metadata->RowGroup(0)->ColumnChunk(column)->encoding_stats()[0].encoding;
+        };
+        ASSERT_EQ(dataEncoding(0), parquet::Encoding::DELTA_BINARY_PACKED);
+        ASSERT_EQ(dataEncoding(6), parquet::Encoding::PLAIN);
+        const auto& chunkInfos = parquetFile.getChunkInfos();
+        ASSERT_EQ(chunkInfos[0][0].encoding, virtualfile::ValueEncoding::DELTA_BINARY_PACKED);
+        ASSERT_EQ(chunkInfos[0][0].pages.size(), 4);
+        ASSERT_TRUE(chunkInfos[0][0].pages[3].encoded_size);
+        if (codec == arrow::Compression::ZSTD) {
+            // splitting the bytes of the doubles compresses them better
+            ASSERT_EQ(dataEncoding(3), parquet::Encoding::BYTE_STREAM_SPLIT);
+        } else {
+            // the lengths of the strings are delta encoded, with compression they only save a few bytes
+            ASSERT_EQ(dataEncoding(5), parquet::Encoding::DELTA_LENGTH_BYTE_ARRAY);
+        }
+
+        for (int64_t begin = 0; begin < size; begin += size / 101 + 1) {
+            const virtualfile::ByteRange range{begin, std::min<int64_t>(begin + 700, size - 1)};
+            ASSERT_TRUE(parquetFile.getRange(range) == file.substr(range.begin, range.size()));
+            std::string segments;
+            for (const auto& segment : parquetFile.getRangeSegments(range)) {
+                segments += segment->ToString();
+            }
+            ASSERT_TRUE(segments == file.substr(range.begin, range.size()));
+        }
+
+        // the encodings are selected once and reused by the next file
+        auto persistedInfos = parquetFile.getChunkInfos();
+        reader->reads = 0;
+        virtualfile::VirtualParquetFile persistedFile(reader, table->schema(), std::move(persistedInfos), options);
+        ASSERT_EQ(reader->reads, 0);
+        ASSERT_TRUE(persistedFile.getRange({0, size - 1}) == file);
+
+        // the plain policy serves the chunk infos with encodings plain again
+        auto resetInfos = parquetFile.getChunkInfos();
+        virtualfile::VirtualParquetFile resetFile(reader, table->schema(), std::move(resetInfos),
+            virtualfile::VirtualParquetFileOptions{.compression = codec});
+        ASSERT_TRUE(resetFile.getRange({0, size - 1}) == plainFile.getRange({0, size - 1}));
+    }
+}
+
+
+TEST(InMemoryTest, TestArrowIPCFile) {
+    constexpr int32_t numRowgroups = 3;
+    constexpr int32_t rows = 1001;
+    const auto sometimes = [](const int32_t row) { return row % 3 == 0 || row % 7 == 0; };
+    const auto never = [](int32_t) { return false; };
+    const auto table = arrow::Table::Make(arrow::schema({
+        arrow::field("int32", arrow::int32()),
+        arrow::field("required", arrow::int64(), false),
+        arrow::field("double", arrow::float64()),
+        arrow::field("bool", arrow::boolean()),
+        arrow::field("decimal", arrow::decimal128(12, 2)),
+        arrow::field("string", arrow::utf8()),
+        arrow::field("largeBinary", arrow::large_binary()),
+    }), {
+        makeColumn<arrow::Int32Builder>(arrow::int32(), numRowgroups, rows, [](int32_t row) { return row * 3; }, sometimes),
+        makeColumn<arrow::Int64Builder>(arrow::int64(), numRowgroups, rows, [](int32_t row) { return -row; }, never),
+        makeColumn<arrow::DoubleBuilder>(arrow::float64(), numRowgroups, rows, [](int32_t row) { return row / 3.0; }, sometimes),
+        makeColumn<arrow::BooleanBuilder>(arrow::boolean(), numRowgroups, rows, [](int32_t row) { return row % 5 < 2; }, sometimes),
+        makeColumn<arrow::Decimal128Builder>(arrow::decimal128(12, 2), numRowgroups, rows,
+            [](int32_t row) { return arrow::Decimal128(row * 997); }, sometimes),
+        makeColumn<arrow::StringBuilder>(arrow::utf8(), numRowgroups, rows,
+            [](int32_t row) { return std::string(row % 23, 'a' + row % 26); }, sometimes),
+        makeColumn<arrow::LargeBinaryBuilder>(arrow::large_binary(), numRowgroups, rows,
+            [](int32_t row) { return std::string(row % 5, static_cast<char>(row)); }, never),
+    });
+    virtualfile::VirtualArrowIPCFile ipcFile(std::make_shared<virtualfile::InMemoryArrowReader>(table), table->schema(),
+        getChunkInfos(table));
+
+    // the predicted size is the size of the file, which arrow reads with one record batch per rowgroup
+    const int64_t size = ipcFile.predictSizeOfFile();
+    const std::string file = ipcFile.getRange({0, size - 1});
+    ASSERT_EQ(file.substr(0, 6), "ARROW1");
+    ASSERT_EQ(file.substr(size - 6), "ARROW1");
+    const auto reader = arrow::ipc::RecordBatchFileReader::Open(
+        std::make_shared<arrow::io::BufferReader>(arrow::Buffer::FromString(file))).ValueOrDie();
+    ASSERT_EQ(reader->num_record_batches(), numRowgroups);
+    const auto result = reader->ToTable().ValueOrDie();
+    ASSERT_TRUE(result->schema()->Equals(*table->schema()));
+    for (int j = 0; j != table->num_columns(); j++) {
+        ASSERT_TRUE(result->column(j)->Equals(table->column(j))) << table->field(j)->ToString();
+    }
+
+    for (int64_t begin = 0; begin < size; begin += size / 101 + 1) {
+        const virtualfile::ByteRange range{begin, std::min<int64_t>(begin + 700, size - 1)};
+        ASSERT_TRUE(ipcFile.getRange(range) == file.substr(range.begin, range.size()));
+        std::string segments;
+        for (const auto& segment : ipcFile.getRangeSegments(range)) {
+            segments += segment->ToString();
+        }
+        ASSERT_TRUE(segments == file.substr(range.begin, range.size()));
+    }
+    // the values of the chunks are borrowed from the table
+    const auto& values = table->column(2)->chunk(1)->data();
+    bool borrowed = false;
+    for (const auto& segment : ipcFile.getRangeSegments({0, size - 1})) {
+        borrowed |= segment->data() == values->GetValues<uint8_t>(1, values->offset * sizeof(double));
+    }
+    ASSERT_TRUE(borrowed);
+
+    // the chunk info has to match the chunks
+    auto infos = getChunkInfos(table);
+    infos[0][1].null_count++;
+    virtualfile::VirtualArrowIPCFile mismatchingFile(std::make_shared<virtualfile::InMemoryArrowReader>(table),
+        table->schema(), std::move(infos));
+    ASSERT_THROW(mismatchingFile.getRange({0, static_cast<int64_t>(mismatchingFile.predictSizeOfFile()) - 1}), std::logic_error);
+    const auto dictionary = arrow::schema({arrow::field("d", arrow::dictionary(arrow::int32(), arrow::utf8()))});
+    ASSERT_THROW(virtualfile::VirtualArrowIPCFile(nullptr, dictionary, {{}}), std::logic_error);
+}
+
+
+TEST(InMemoryTest, TestParquetFileView) {
+    constexpr int32_t numRowgroups = 4;
+    constexpr int32_t rows = 500;
+    const auto never = [](int32_t) { return false; };
+    const auto table = arrow::Table::Make(arrow::schema({
+        arrow::field("int32", arrow::int32()),
+        arrow::field("string", arrow::utf8()),
+        arrow::field("int64", arrow::int64()),
+    }), {
+        makeColumn<arrow::Int32Builder>(arrow::int32(), numRowgroups, rows, [](int32_t row) { return row; }, never),
+        makeColumn<arrow::StringBuilder>(arrow::utf8(), numRowgroups, rows,
+            [](int32_t row) { return std::string(row % 13, 'a' + row % 26); }, [](int32_t row) { return row % 4 == 0; }),
+        makeColumn<arrow::Int64Builder>(arrow::int64(), numRowgroups, rows, [](int32_t row) { return -row; }, never),
+    });
+    const auto reader = std::make_shared<CountingArrowReader>(table);
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, table->schema(), getChunkInfos(table),
+        virtualfile::VirtualParquetFileOptions{.columnCompression = {{1, arrow::Compression::ZSTD}},
+            .writePageIndex = true, .pageRows = 150});
+    const int64_t size = parquetFile->predictSizeOfFile();
+
+    // the view of the whole file is the file
+    virtualfile::VirtualParquetFileView wholeFile(parquetFile, std::nullopt);
+    ASSERT_EQ(wholeFile.predictSizeOfFile(), size);
+    ASSERT_TRUE(wholeFile.getRange({0, size - 1}) == parquetFile->getRange({0, size - 1}));
+
+    // views are files of the selected columns and rowgroups, which are served from the cache of the file
+    reader->reads = 0;
+    virtualfile::VirtualParquetFileView view(parquetFile, std::vector<uint64_t>{2, 1}, std::vector<uint64_t>{3, 1});
+    ASSERT_EQ(reader->reads, 0);
+    const auto result = readVirtualFile(view);
+    ASSERT_NE(result, nullptr);
+    ASSERT_TRUE(result->schema()->Equals(*arrow::schema({table->field(2), table->field(1)})));
+    arrow::ChunkedArrayVector columns;
+    for (const int j : {2, 1}) {
+        columns.push_back(arrow::ChunkedArray::Make({table->column(j)->chunk(3), table->column(j)->chunk(1)}).ValueOrDie());
+        ASSERT_TRUE(result->column(columns.size() - 1)->Equals(columns.back()));
+    }
+    ASSERT_EQ(reader->reads, 2);
+
+    // the view has the layout of a file of the selected chunks
+    const auto selected = arrow::Table::Make(result->schema(), columns);
+    auto infos = view.getChunkInfos();
+    virtualfile::VirtualParquetFile selectedFile(std::make_shared<virtualfile::InMemoryArrowReader>(selected),
+        selected->schema(), std::move(infos), virtualfile::VirtualParquetFileOptions{
+            .columnCompression = {{1, arrow::Compression::ZSTD}}, .writePageIndex = true, .pageRows = 150});
+    const int64_t viewSize = view.predictSizeOfFile();
+    ASSERT_EQ(selectedFile.predictSizeOfFile(), viewSize);
+    const std::string file = selectedFile.getRange({0, viewSize - 1});
+    ASSERT_TRUE(view.getRange({0, viewSize - 1}) == file);
+    for (int64_t begin = 0; begin < viewSize; begin += viewSize / 37 + 1) {
+        const virtualfile::ByteRange range{begin, std::min<int64_t>(begin + 900, viewSize - 1)};
+        ASSERT_TRUE(view.getRange(range) == file.substr(range.begin, range.size()));
+        std::string segments;
+        for (const auto& segment : view.getRangeSegments(range)) {
+            segments += segment->ToString();
+        }
+        ASSERT_TRUE(segments == file.substr(range.begin, range.size()));
+    }
+
+    ASSERT_THROW(virtualfile::VirtualParquetFileView(parquetFile, std::vector<uint64_t>{3}), std::out_of_range);
+    ASSERT_THROW(virtualfile::VirtualParquetFileView(parquetFile, std::vector<uint64_t>{}), std::logic_error);
+}
+
+
+TEST(InMemoryTest, TestRandomAccessFile) {
+    constexpr int32_t numRowgroups = 4;
+    constexpr int32_t rows = 700;
+    const auto table = arrow::Table::Make(arrow::schema({
+        arrow::field("int64", arrow::int64()),
+        arrow::field("string", arrow::utf8()),
+    }), {
+        makeColumn<arrow::Int64Builder>(arrow::int64(), numRowgroups, rows, [](int32_t row) { return row * 7; },
+            [](int32_t) { return false; }),
+        makeColumn<arrow::StringBuilder>(arrow::utf8(), numRowgroups, rows,
+            [](int32_t row) { return std::string(row % 17, 'a' + row % 26); }, [](int32_t row) { return row % 5 == 0; }),
+    });
+    const auto reader = std::make_shared<virtualfile::InMemoryArrowReader>(table);
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, table->schema(), getChunkInfos(table),
+        virtualfile::VirtualParquetFileOptions{.pageRows = 200});
+    const auto input = std::make_shared<virtualfile::VirtualRandomAccessFile>(parquetFile);
+    const int64_t size = parquetFile->predictSizeOfFile();
+    ASSERT_EQ(input->GetSize().ValueOrDie(), size);
+
+    // parquet reads the virtual file directly, with and without pre-buffering
+    for (const bool preBuffer : {false, true}) {
+        auto properties = parquet::ArrowReaderProperties();
+        properties.set_pre_buffer(preBuffer);
+        parquet::arrow::FileReaderBuilder builder;
+        ASSERT_TRUE(builder.Open(input).ok());
+        std::unique_ptr<parquet::arrow::FileReader> fileReader;
+        ASSERT_TRUE(builder.properties(properties)->Build(&fileReader).ok());
+        const auto result = fileReader->ReadTable().ValueOrDie();
+        ASSERT_TRUE(result->Equals(*table));
+    }
+
+    // reads match the serialized file, reads within a segment borrow its memory
+    const std::string file = parquetFile->getRange({0, size - 1});
+    for (int64_t begin = 0; begin < size; begin += size / 53 + 1) {
+        const int64_t length = std::min<int64_t>(997, size - begin);
+        ASSERT_EQ(input->ReadAt(begin, length).ValueOrDie()->ToString(), file.substr(begin, length));
+        ASSERT_EQ(input->ReadAsync(begin, length).result().ValueOrDie()->ToString(), file.substr(begin, length));
+    }
+    const auto& data = table->column(0)->chunk(2)->data();
+    const auto values = data->GetValues<uint8_t>(1, data->offset * sizeof(int64_t));
+    const int64_t offset = file.find(std::string_view(reinterpret_cast<const char*>(values), 64));
+    ASSERT_EQ(input->ReadAt(offset + 8, 64).ValueOrDie()->data(), values + 8);
+
+    // prefetched ranges are served until their end is read
+    ASSERT_TRUE(input->WillNeed({{0, size / 2}, {size / 2, size - size / 2}}).ok());
+    ASSERT_EQ(input->ReadAt(10, 100).ValueOrDie()->ToString(), file.substr(10, 100));
+    ASSERT_EQ(input->ReadAsync(size / 2, size - size / 2).result().ValueOrDie()->ToString(), file.substr(size / 2));
+
+    // an eager read range cache reads and prefetches its ranges, which are serialized once
+    const uint64_t requests = parquetFile->getMetrics().get(virtualfile::Counter::Requests);
+    arrow::io::internal::ReadRangeCache rangeCache(input, arrow::io::default_io_context(),
+        arrow::io::CacheOptions::Defaults());
+    ASSERT_TRUE(rangeCache.Cache({{0, size}}).ok());
+    ASSERT_TRUE(rangeCache.Wait().status().ok());
+    ASSERT_EQ(rangeCache.Read({0, size}).ValueOrDie()->ToString(), file);
+    ASSERT_EQ(parquetFile->getMetrics().get(virtualfile::Counter::Requests), requests + 1);
+
+    // the stream interface and short reads at the end of the file
+    ASSERT_TRUE(input->Seek(size - 10).ok());
+    ASSERT_EQ(input->Read(100).ValueOrDie()->ToString(), file.substr(size - 10));
+    ASSERT_EQ(input->Tell().ValueOrDie(), size);
+    ASSERT_FALSE(input->ReadAt(size - 10, 100, false).ok());
+    ASSERT_TRUE(input->Close().ok());
+    ASSERT_FALSE(input->ReadAt(0, 4).ok());
+}
+
+TEST(InMemoryTest, TestMetrics) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    const auto table = makeInt32Table(8, 100, infos);
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(
+        std::make_shared<virtualfile::InMemoryArrowReader>(table), table->schema(), std::move(infos));
+    std::mutex spansMutex;
+    std::vector<virtualfile::TraceSpan> spans;
+    parquetFile->setTraceHook([&](const virtualfile::TraceSpan& span) {
+        std::lock_guard lock(spansMutex);
+        spans.push_back(span);
+    });
+    const int64_t size = parquetFile->predictSizeOfFile();
+    const auto global = virtualfile::VirtualFile::getGlobalMetrics();
+
+    // a whole file request touches and serializes every chunk once
+    parquetFile->getRange({0, size - 1});
+    auto metrics = parquetFile->getMetrics();
+    ASSERT_EQ(metrics.get(virtualfile::Counter::Requests), 1);
+    ASSERT_EQ(metrics.get(virtualfile::Counter::BytesServed), size);
+    ASSERT_EQ(metrics.get(virtualfile::Counter::ChunksTouched), 8);
+    ASSERT_EQ(metrics.get(virtualfile::Counter::ChunksSerialized), 8);
+    ASSERT_EQ(metrics.get(virtualfile::Counter::PartialPages), 0);
+    ASSERT_EQ(metrics.get(virtualfile::Counter::FooterReads), 1);
+    ASSERT_EQ(metrics.get(virtualfile::Latency::Read).count, 8);
+    ASSERT_EQ(metrics.get(virtualfile::Latency::Request).count, 1);
+    ASSERT_GE(metrics.get(virtualfile::Latency::Request).quantile(1), metrics.get(virtualfile::Latency::Serialize).quantile(0));
+    ASSERT_EQ(spans.size(), 1);
+    ASSERT_EQ(spans[0].begin, 0);
+    ASSERT_EQ(spans[0].end, size - 1);
+    ASSERT_FALSE(spans[0].segments);
+
+    // requests of several threads within a chunk, whose pages are only partially written
+    std::vector<std::thread> threads;
+    for (int t = 0; t != 4; t++) {
+        threads.emplace_back([&] {
+            for (int r = 0; r != 100; r++) parquetFile->getRangeSegments({30, 40});
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    metrics = parquetFile->getMetrics();
+    ASSERT_EQ(metrics.get(virtualfile::Counter::Requests), 401);
+    ASSERT_EQ(metrics.get(virtualfile::Counter::BytesServed), size + 400 * 11);
+    ASSERT_EQ(metrics.get(virtualfile::Counter::ChunksTouched), 408);
+    ASSERT_EQ(metrics.get(virtualfile::Latency::Request).count, 401);
+
+    // without timing only the requests are timed
+    virtualfile::Metrics::setTimingEnabled(false);
+    parquetFile->getRange({0, size - 1});
+    virtualfile::Metrics::setTimingEnabled(true);
+    ASSERT_EQ(parquetFile->getMetrics().get(virtualfile::Latency::Request).count, 402);
+    ASSERT_EQ(parquetFile->getMetrics().get(virtualfile::Latency::Read).count, metrics.get(virtualfile::Latency::Read).count);
+    ASSERT_EQ(parquetFile->getMetrics().get(virtualfile::Counter::ChunksSerialized), metrics.get(virtualfile::Counter::ChunksSerialized) + 8);
+
+    // the global metrics count the requests of views only once
+    virtualfile::VirtualParquetFileView view(parquetFile, std::nullopt);
+    view.getRange({0, size - 1});
+    ASSERT_EQ(view.getMetrics().get(virtualfile::Counter::Requests), 1);
+    ASSERT_EQ(parquetFile->getMetrics().get(virtualfile::Counter::Requests), 403);
+    const auto globalDelta = [&](const virtualfile::Counter counter) {
+        return virtualfile::VirtualFile::getGlobalMetrics().get(counter) - global.get(counter);
+    };
+    ASSERT_EQ(globalDelta(virtualfile::Counter::Requests), 403);
+    ASSERT_EQ(globalDelta(virtualfile::Counter::BytesServed), 3 * size + 400 * 11);
+    ASSERT_EQ(globalDelta(virtualfile::Counter::ChunksTouched), 424);
+
+    // threads beyond the number of shards share shards without losing records
+    virtualfile::Metrics sharedMetrics;
+    std::vector<std::thread> manyThreads;
+    const int numThreads = 4 * std::max(1u, std::thread::hardware_concurrency()) + 3;
+    for (int t = 0; t != numThreads; t++) {
+        manyThreads.emplace_back([&] {
+            for (int r = 0; r != 1000; r++) sharedMetrics.record(virtualfile::Counter::Requests);
+        });
+    }
+    for (auto& thread : manyThreads) thread.join();
+    ASSERT_EQ(sharedMetrics.getSnapshot().get(virtualfile::Counter::Requests), numThreads * 1000);
+}
+
+TEST(InMemoryTest, TestRangeStream) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    const auto table = makeInt32Table(50, 100, infos);
+    const auto reader = std::make_shared<CountingArrowReader>(table);
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(reader, table->schema(), std::move(infos));
+    const int64_t size = parquetFile->predictSizeOfFile();
+    const std::string file = parquetFile->getRange({0, size - 1});
+
+    // the windows of segments and of buffers concatenate to the range, the windows need not align with chunks.
+    // Every chunk is read once however many windows it spans
+    for (const uint64_t window : {1ul, 7ul, 401ul, 1ul << 20}) {
+        const virtualfile::ByteRange range{3, size - 2};
+        reader->reads = 0;
+        virtualfile::RangeStream stream(parquetFile, range, window);
+        std::string segments;
+        while (!stream.done()) {
+            const uint64_t remaining = stream.getRemainingSize();
+            uint64_t produced = 0;
+            for (const auto& segment : stream.nextSegments()) {
+                segments += segment->ToString();
+                produced += segment->size();
+            }
+            ASSERT_EQ(produced, std::min(window, remaining));
+        }
+        ASSERT_TRUE(stream.nextSegments().empty());
+        ASSERT_TRUE(segments == file.substr(3, range.size()));
+        ASSERT_EQ(reader->reads, 50);
+
+        reader->reads = 0;
+        virtualfile::RangeStream bufferStream(parquetFile, range, window);
+        std::string buffers;
+        std::vector<char> buffer(300);
+        while (const uint64_t produced = bufferStream.next(buffer)) {
+            ASSERT_LE(produced, std::min<uint64_t>(window, buffer.size()));
+            buffers.append(buffer.data(), produced);
+        }
+        ASSERT_TRUE(buffers == file.substr(3, range.size()));
+        ASSERT_EQ(reader->reads, 50);
+    }
+    ASSERT_THROW(virtualfile::RangeStream(parquetFile, {0, size}), std::out_of_range);
+    ASSERT_THROW(virtualfile::RangeStream(parquetFile, {0, size - 1}, 0), std::logic_error);
+}
+
+TEST(InMemoryTest, TestFileReaders) {
+    constexpr int32_t numRowgroups = 3;
+    constexpr int32_t rows = 1000;
+    const auto sometimes = [](const int32_t row) { return row % 5 == 0; };
+    const auto never = [](int32_t) { return false; };
+    const auto table = arrow::Table::Make(arrow::schema({
+        arrow::field("int32", arrow::int32()),
+        arrow::field("double", arrow::float64()),
+        arrow::field("string", arrow::utf8()),
+        arrow::field("bool", arrow::boolean()),
+    }), {
+        makeColumn<arrow::Int32Builder>(arrow::int32(), numRowgroups, rows, [](int32_t row) { return row - 500; }, sometimes),
+        makeColumn<arrow::DoubleBuilder>(arrow::float64(), numRowgroups, rows, [](int32_t row) { return row / 4.0; }, never),
+        makeColumn<arrow::StringBuilder>(arrow::utf8(), numRowgroups, rows,
+            [](int32_t row) { return "value" + std::to_string(row % 13); }, sometimes),
+        makeColumn<arrow::BooleanBuilder>(arrow::boolean(), numRowgroups, rows, [](int32_t) { return true; }, never),
+    });
+    const auto expectedInfos = getChunkInfos(table);
+
+    // an Arrow IPC file with a record batch per rowgroup
+    const std::string ipcPath = testing::TempDir() + "readers.arrow";
+    {
+        auto output = arrow::io::FileOutputStream::Open(ipcPath).ValueOrDie();
+        auto writer = arrow::ipc::MakeFileWriter(output, table->schema()).ValueOrDie();
+        arrow::TableBatchReader batches(*table);
+        std::shared_ptr<arrow::RecordBatch> batch;
+        while (batches.ReadNext(&batch).ok() && batch) {
+            ASSERT_TRUE(writer->WriteRecordBatch(*batch).ok());
+        }
+        ASSERT_TRUE(writer->Close().ok());
+        ASSERT_TRUE(output->Close().ok());
+    }
+    const auto ipcReader = std::make_shared<virtualfile::MappedArrowIPCReader>(ipcPath);
+    ASSERT_EQ(ipcReader->getNumRowgroups(), numRowgroups);
+    auto ipcInfos = ipcReader->computeChunkInfos(arrow::internal::GetCpuThreadPool());
+    for (int j = 0; j != table->num_columns(); j++) {
+        for (int i = 0; i != numRowgroups; i++) {
+            ASSERT_EQ(ipcInfos[j][i].uncompressed_size, expectedInfos[j][i].uncompressed_size);
+            ASSERT_EQ(ipcInfos[j][i].tuple_count, expectedInfos[j][i].tuple_count);
+            ASSERT_EQ(ipcInfos[j][i].null_count, expectedInfos[j][i].null_count);
+        }
+    }
+    // zone maps of the types with statistics, nulls and NaNs are no values
+    int32_t min;
+    int32_t max;
+    memcpy(&min, ipcInfos[0][1].zone_map->min_value.data(), sizeof(int32_t));
+    memcpy(&max, ipcInfos[0][1].zone_map->max_value.data(), sizeof(int32_t));
+    ASSERT_EQ(min, 503);
+    ASSERT_EQ(max, 1502);
+    ASSERT_EQ(ipcInfos[3][0].zone_map->min_value[0], std::byte{1});
+    ASSERT_FALSE(ipcInfos[2][0].zone_map);
+    virtualfile::VirtualParquetFile ipcFile(ipcReader, ipcReader->getSchema(), std::move(ipcInfos));
+    const auto ipcResult = readVirtualFile(ipcFile);
+    ASSERT_NE(ipcResult, nullptr);
+    ASSERT_TRUE(ipcResult->Equals(*table));
+
+    // a compressed parquet file, whose dictionary encoded strings are read as dictionary arrays
+    const std::string parquetPath = testing::TempDir() + "readers.parquet";
+    {
+        auto output = arrow::io::FileOutputStream::Open(parquetPath).ValueOrDie();
+        const auto properties = parquet::WriterProperties::Builder().compression(arrow::Compression::ZSTD)->build();
+        ASSERT_TRUE(parquet::arrow::WriteTable(*table, arrow::default_memory_pool(), output, rows, properties).ok());
+        ASSERT_TRUE(output->Close().ok());
+    }
+    const auto parquetReader = std::make_shared<virtualfile::MappedParquetReader>(parquetPath);
+    ASSERT_EQ(parquetReader->getNumRowgroups(), numRowgroups);
+    ASSERT_TRUE(arrow::is_dictionary(parquetReader->getSchema()->field(2)->type()->id()));
+    auto parquetInfos = parquetReader->computeChunkInfos();
+    ASSERT_EQ(parquetInfos[1][2].uncompressed_size, expectedInfos[1][2].uncompressed_size);
+    ASSERT_EQ(parquetInfos[2][2].dictionary_chunk_info->unique_values_count, 13);
+    ASSERT_EQ(parquetInfos[2][2].null_count, expectedInfos[2][2].null_count);
+    virtualfile::VirtualParquetFile parquetFile(parquetReader, parquetReader->getSchema(), std::move(parquetInfos));
+    const auto parquetResult = readVirtualFile(parquetFile);
+    ASSERT_NE(parquetResult, nullptr);
+    ASSERT_TRUE(parquetResult->Equals(*table));
+    ASSERT_THROW(virtualfile::MappedParquetReader{ipcPath}, parquet::ParquetException);
+    std::remove(ipcPath.c_str());
+    std::remove(parquetPath.c_str());
+}
+
+// Response of a minimal HTTP client, the body is read by its Content-Length
+struct HttpResponse {
+    std::string header;
+    std::string body;
+};
+
+HttpResponse readHttpResponse(const int fd, std::string& input, const bool hasBody = true) {
+    char buffer[1 << 16];
+    size_t headerEnd;
+    while ((headerEnd = input.find("\r\n\r\n")) == std::string::npos) {
+        const ssize_t received = read(fd, buffer, sizeof(buffer));
+        if (received <= 0) return {};
+        input.append(buffer, received);
+    }
+    HttpResponse result{input.substr(0, headerEnd + 2), ""};
+    input.erase(0, headerEnd + 4);
+    const size_t length = result.header.find("Content-Length: ");
+    const size_t bodySize = hasBody ? std::stoull(result.header.substr(length + 16)) : 0;
+    while (input.size() < bodySize) {
+        const ssize_t received = read(fd, buffer, sizeof(buffer));
+        if (received <= 0) return {};
+        input.append(buffer, received);
+    }
+    result.body = input.substr(0, bodySize);
+    input.erase(0, bodySize);
+    return result;
+}
+
+int connectHttp(const uint16_t port) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) return -1;
+    return fd;
+}
+
+void sendHttp(const int fd, const std::string& request) {
+    ASSERT_EQ(write(fd, request.data(), request.size()), static_cast<ssize_t>(request.size()));
+}
+
+TEST(InMemoryTest, TestHttpRangeServer) {
+    std::vector<std::vector<virtualfile::ChunkInfo>> infos;
+    const auto table = makeInt32Table(16, 20000, infos);
+    const auto parquetFile = std::make_shared<virtualfile::VirtualParquetFile>(
+        std::make_shared<virtualfile::InMemoryArrowReader>(table), table->schema(), std::move(infos));
+    const int64_t size = parquetFile->predictSizeOfFile();
+    const std::string file = parquetFile->getRange({0, size - 1});
+    // a small window streams the file in several parts
+    virtualfile::HttpRangeServer server({.window = 10000});
+    server.addFile("/table.parquet", parquetFile);
+    server.start();
+
+    // all requests are served on one connection, the last one closes it
+    const int fd = connectHttp(server.getPort());
+    ASSERT_GE(fd, 0);
+    std::string input;
+    sendHttp(fd, "HEAD /table.parquet HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    HttpResponse response = readHttpResponse(fd, input, false);
+    ASSERT_EQ(response.header.substr(0, 15), "HTTP/1.1 200 OK");
+    ASSERT_NE(response.header.find("Content-Length: " + std::to_string(size) + "\r\n"), std::string::npos);
+    ASSERT_NE(response.header.find("Accept-Ranges: bytes\r\n"), std::string::npos);
+
+    sendHttp(fd, "GET /table.parquet HTTP/1.1\r\n\r\n");
+    response = readHttpResponse(fd, input);
+    ASSERT_TRUE(response.body == file);
+
+    sendHttp(fd, "GET /table.parquet?version=1 HTTP/1.1\r\nrange: bytes=100-50099\r\n\r\n");
+    response = readHttpResponse(fd, input);
+    ASSERT_EQ(response.header.substr(0, 28), "HTTP/1.1 206 Partial Content");
+    ASSERT_NE(response.header.find("Content-Range: bytes 100-50099/" + std::to_string(size)), std::string::npos);
+    ASSERT_TRUE(response.body == file.substr(100, 50000));
+
+    // pipelined requests of a suffix, of ranges beyond the end of the file and of an unknown file
+    sendHttp(fd, "GET /table.parquet HTTP/1.1\r\nRange: bytes=-8\r\n\r\n"
+        "GET /table.parquet HTTP/1.1\r\nRange: bytes=" + std::to_string(size) + "-\r\n\r\n"
+        "GET /other.parquet HTTP/1.1\r\n\r\n");
+    ASSERT_TRUE(readHttpResponse(fd, input).body == file.substr(size - 8));
+    ASSERT_EQ(readHttpResponse(fd, input).header.substr(0, 12), "HTTP/1.1 416");
+    ASSERT_EQ(readHttpResponse(fd, input).header.substr(0, 12), "HTTP/1.1 404");
+
+    // several ranges are served as multipart/byteranges
+    sendHttp(fd, "GET /table.parquet HTTP/1.1\r\nRange: bytes=0-3, 20000-39999,-100\r\nConnection: close\r\n\r\n");
+    response = readHttpResponse(fd, input);
+    ASSERT_NE(response.header.find("Content-Type: multipart/byteranges; boundary="), std::string::npos);
+    const std::string boundary = response.header.substr(response.header.find("boundary=") + 9,
+        response.header.find("\r\n", response.header.find("boundary=")) - response.header.find("boundary=") - 9);
+    size_t position = 0;
+    for (const virtualfile::ByteRange range : {virtualfile::ByteRange{0, 3}, {20000, 39999}, {size - 100, size - 1}}) {
+        position = response.body.find("--" + boundary + "\r\n", position);
+        ASSERT_NE(position, std::string::npos);
+        const size_t partHeaderEnd = response.body.find("\r\n\r\n", position);
+        const std::string partHeader = response.body.substr(position, partHeaderEnd - position);
+        ASSERT_NE(partHeader.find("Content-Range: bytes " + std::to_string(range.begin) + "-" + std::to_string(range.end)),
+            std::string::npos);
+        ASSERT_TRUE(response.body.substr(partHeaderEnd + 4, range.size()) == file.substr(range.begin, range.size()));
+        position = partHeaderEnd + 4 + range.size();
+    }
+    ASSERT_EQ(response.body.substr(position), "\r\n--" + boundary + "--\r\n");
+    char end;
+    ASSERT_EQ(read(fd, &end, 1), 0);
+    close(fd);
+
+    // requests of too many ranges are served the whole file, headers beyond the limit are rejected
+    const int limitsFd = connectHttp(server.getPort());
+    ASSERT_GE(limitsFd, 0);
+    std::string ranges = "bytes=0-0";
+    for (int r = 1; r != 100; r++) ranges += "," + std::to_string(2 * r) + "-" + std::to_string(2 * r);
+    sendHttp(limitsFd, "GET /table.parquet HTTP/1.1\r\nRange: " + ranges + "\r\n\r\n");
+    input.clear();
+    response = readHttpResponse(limitsFd, input);
+    ASSERT_EQ(response.header.substr(0, 15), "HTTP/1.1 200 OK");
+    ASSERT_TRUE(response.body == file);
+    sendHttp(limitsFd, "GET /table.parquet HTTP/1.1\r\nX-Padding: " + std::string((64 << 10) + 1000, 'a'));
+    ASSERT_EQ(readHttpResponse(limitsFd, input, false).header.substr(0, 12), "HTTP/1.1 431");
+    close(limitsFd);
+
+    // a stopped server serves again once started
+    server.stop();
+    server.start();
+    const int restartedFd = connectHttp(server.getPort());
+    ASSERT_GE(restartedFd, 0);
+    sendHttp(restartedFd, "GET /table.parquet HTTP/1.1\r\nRange: bytes=0-3\r\n\r\n");
+    input.clear();
+    ASSERT_EQ(readHttpResponse(restartedFd, input).body, "PAR1");
+    close(restartedFd);
+    server.stop();
+}